@@ -20,18 +20,24 @@ typedef struct {
     bool timecount_flag;
     bool repl_flag;
     bool safety_flag;
+    bool cache_flag;
+    bool jit_flag;
+    bool profile_flag;
+    bool watch_flag;
 
     char *root_srcpath;
     char *include_srcpath;
+    char *spectrogram_path;  // --spectrogramで書き出す画像 (NULLなら音を鳴らす)
     Map *srcfile_table;
     language_t language;
-    int64_t sampling_rate;
+    int64_t sampling_rate;  // 合成するサンプリング周波数
+    int64_t output_rate;    // 音を出すサンプリング周波数 (0ならsampling_rateと同じ)
     double fade_range;
 } Status;
 
 typedef struct {
     tokencode_t tc;
-    char *str; 
+    char *str;      // '\0'で終わるとは限らない (ソースの中を指すことがある)
     size_t len;
     tokentype_t type;
 } Token;
@@ -55,6 +61,7 @@ struct init_define_filters {
     size_t sl;
     filtercode_t filter_num;
     uint64_t param;
+    uint64_t oversample;  // 非線形フィルタが要求するオーバーサンプリングの倍率 (0ならしない)
 };
 extern const struct init_define_filters def_filters[];
 
@@ -83,6 +90,7 @@ void oto_exit();
 void oto_error(errorcode_t err);
 void oto_error_throw(errorcode_t err);
 void oto_run();
+void oto_run_midi(char *path);
 
 void repl();
 
@@ -92,8 +100,13 @@ void print_error(errorcode_t err, Status *status);
 /* token, variable */
 void init_var_list(VectorPTR *var_list);
 void free_var_list(VectorPTR *var_list);
+tokencode_t get_rsvword_tc(char *str, size_t len);
 tokencode_t allocate_tc(char *str, size_t len, tokentype_t type, VectorPTR *var_list);
 void add_new_variable(VectorPTR *var_list, Token *new_token);
+void reset_var_values(VectorPTR *var_list, int64_t begin);
+char *open_src_view(const char *path, Status *status);
+void close_src_view(char *src);
+void free_src_views();
 
 /* lexer */
 void tokenize(char *src, VectorI64 *src_tokens, VectorPTR *var_list, Status *status);
@@ -102,15 +115,70 @@ void preprocess(char *src, int64_t idx, VectorI64 *src_tokens, VectorPTR *var_li
 
 char *new_string_literal(char *src, int64_t idx);
 void preprocess(char *src, int64_t idx, VectorI64 *src_tokens, VectorPTR *var_list, Status *status);
+void free_include_cache();
+void reset_include_state(Status *status);
+bool is_include_cache_changed();
+uint64_t include_cache_signature();
+
+/* トークンの位置 (srcpos.c) */
+typedef struct {
+    uint32_t file;      // add_src_file()の番号
+    uint32_t line;      // 1から. 0なら記録なし
+    uint64_t offset;    // ファイルの先頭からのバイト位置
+} SrcPos;
+
+uint32_t add_src_file(const char *path, char *src);
+void replace_src_file(char *old_src, char *new_src);
+void set_src_pos(int64_t tcidx, SrcPos pos);
+const SrcPos *get_src_pos(int64_t tcidx);
+void print_src_line(const SrcPos *pos);
+void print_src_pos(const SrcPos *pos);
+void free_src_pos();
 
 /* compiler */
 VectorPTR *compile(VectorI64 *src_tokens, VectorPTR *var_list, char *src_str, Status *status);
+const SrcPos *get_ic_pos(int64_t pc);
+
+/* bytecode cache (.otoc) */
+uint64_t otoc_key(char *src, Status *status);
+VectorPTR *load_otoc(char *srcpath, uint64_t key, VectorPTR *var_list);
+void save_otoc(char *srcpath, uint64_t key, int64_t base_vars,
+               VectorPTR *ic_list, VectorPTR *var_list);
+void close_otoc();
+
+/* --watch */
+void update_watch(char *path);
+bool is_watch_changed();
+void wait_watch_changed();
+
+/* 実行時のオブジェクトを置く領域 (region.c) */
+typedef enum {
+    REGION_SOUND = 0,
+    REGION_OSCIL,
+    REGION_FILTER,
+    REGION_ARRAY,
+    REGION_FUNC,
+    REGION_NUM
+} region_t;
+
+void *region_alloc(region_t region, size_t size);
+void reset_region();
+void free_region();
+
+#define REGION_ALLOC(region, n, type)  ((type *)region_alloc(region, (n) * sizeof(type)))
 
 /* exec */
-void exec(VectorPTR *ic_list, VectorPTR *var_list, Status *status);
+typedef struct Frame Frame;
+
+Frame *new_frame();
+void release_frame(Frame *frame);
+void free_frame(Frame *frame);
+void exec(const VectorPTR *ic_list, VectorPTR *var_list, Status *status, Frame *frame);
+void print_profile(const VectorPTR *ic_list, Status *status);
 
 /* debug print */
 void print_src_tokens(VectorI64 *src_tokens);
 void print_rpn_tc(VectorI64 *rpntcs);
 void print_var(VectorPTR *var_list);
-void print_ic_list(VectorPTR *ic_list);
\ No newline at end of file
+void print_ic_list(VectorPTR *ic_list);
+const char *opcode_name(opcode_t op);
\ No newline at end of file
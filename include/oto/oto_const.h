@@ -94,11 +94,15 @@ enum {
     TC_FILTER,    // filter FILTER
     TC_OSCIL,     // oscil OSCIL
     TC_SOUND,     // sound SOUND
+    TC_SAMPLE,    // sample SAMPLE
 
     TC_PRINT,     // print PRINT
     TC_BEEP,      // beep BEEP
     TC_PLAY,      // play PLAY
+    TC_PLAYMIDI,  // playmidi PLAYMIDI
+    TC_MML,       // mml MML
     TC_PRINTWAV,  // printwav PRINTWAV
+    TC_PRINTSPEC, // printspec PRINTSPEC
     TC_PRINTVAR,  // printvar PRINTVAR
     TC_SLEEP,     // sleep SLEEP
     TC_SETSYNTH,  // setsynth SETSYNTH
@@ -214,9 +218,10 @@ enum {
      * 指定した回数ループを行う
      * 
      * example:
-     *   LOOP Addr Loop_Cnt Loop_Var
+     *   LOOP Addr Loop_Cnt Loop_Slot
      *   Addrをループ場所として, Loop_Cnt回分ループする.
-     *   Loop_Varは制御変数である.
+     *   Loop_Slotは実行フレーム中のループカウンタの番号である.
+     *   (内部コード自体は実行中に書き換えない)
      */
     OP_LOOP,
 
@@ -231,6 +236,7 @@ enum {
 
     OP_OSCILDEF,
     OP_SOUNDDEF,
+    OP_SAMPLEDEF,
     OP_ARRAYDEF,
 
     OP_CPYS,
@@ -245,18 +251,52 @@ enum {
     OP_PRINT,
     OP_BEEP,
     OP_PLAY,
+    OP_PLAYMIDI,
+
+    /**
+     * MMLの再生
+     *
+     * example:
+     *   PLAYMML Sound Count Total
+     *   MMLNOTE Start Length Freq Volume
+     *   ...
+     *   PLAYMMLの後ろに続くCount個のMMLNOTEをまとめて鳴らす.
+     *   Total, Start, Length(秒), Freqはdoubleのビット列をそのまま入れる.
+     *   MMLNOTEは単独では何もしない.
+     */
+    OP_PLAYMML,
+    OP_MMLNOTE,
     OP_PRINTWAV,
+    OP_PRINTSPEC,
     OP_PRINTVAR,
     OP_SLEEP,
     OP_SETSYNTH,
     OP_SETLOOP,
     OP_STOP,
 
+    /**
+     * 関数呼び出し命令
+     *
+     * example:
+     *   CALL Addr Argc
+     *   スタックから引数をArgc個取り出して, Addrへジャンプする.
+     *   PARAM Var N
+     *   Varの値を退避して, N番目の引数を代入する.
+     *   RET Argc
+     *   退避したArgc個の変数を元に戻して, 呼び出し元へ戻る.
+     */
+    OP_CALL,
+    OP_PARAM,
+    OP_RET,
+
     OP_EXIT
 };
 typedef int64_t opcode_t;
 
-#define FILTER_NUM 13
+#define FUNC_MAX_PARAMS 16  // 関数の引数の最大数
+#define PLAYMIDI_MAX_SOUNDS 8  // PLAYMIDIでトラックに割り当てるSoundの最大数
+
+#define FILTER_NUM 19
 enum {
     CLIP = 0,
     FADE_IN,
@@ -270,6 +310,12 @@ enum {
     HPF,
     WAH,
     RADIO,
-    VIBRATO
+    VIBRATO,
+    SOFTCLIP,
+    WAVESHAPE,
+    REVERB,
+    DELAY,
+    CHORUS,
+    FLANGER
 };
 typedef int64_t filtercode_t;
\ No newline at end of file
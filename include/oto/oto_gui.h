@@ -9,6 +9,9 @@
 #define PRINTWAV_OVERALL_WAVE_COLOR 0x00c3ff
 #define PRINTWAV_ZOOM_WAVE_COLOR    0x00c3ff
 
+#define PRINTSPEC_WIN_WIDTH  1000
+#define PRINTSPEC_WIN_HEIGHT 256
+
 #define SYNTH_WIN_WIDTH  600
 #define SYNTH_WIN_HEIGHT 350
 #define SYNTH_WIN_BACKGROUND_COLOR 0xededed
@@ -23,11 +23,28 @@ typedef enum {
     SQUARE_WAVE,    // PSG
     TRIANGLE_WAVE,  // PSG
     WHITE_NOISE,    // PSG
+    SAMPLE_WAVE,    // WAVファイル
 } basicwave_t;
 
+#define SAMPLE_BASE_FREQ 440.0  // 指定がなければこの周波数で元の高さになる
+
+/* 取り込んだWAVファイル. 波形はマップしたファイルの中を直接読む */
+typedef struct sample {
+    void *map;            // マップしたファイル全体
+    const uint8_t *data;  // dataチャンクの先頭
+    int64_t frames;
+    int64_t channels;
+    int64_t bytes;        // 1チャンネル1サンプルのバイト数
+    bool is_float;
+    int64_t rate;
+    double base_freq;
+    struct sample *next;  // マップを外すために読み込んだものを繋いでおく
+} Sample;
+
 /* 発振器 */
 typedef struct oscillator {
     basicwave_t wave;
+    Sample *sample;  // SAMPLE_WAVEのときの波形
     // struct oscillator *fm;
     // struct oscillator *am;
 
@@ -36,12 +53,152 @@ typedef struct oscillator {
     float fm_freq;
 } Oscillator;
 
+#define FILTER_ARG_SIZE 10
+
+/* フィルタ */
+typedef struct filter {
+    filtercode_t num;
+    Var *args[FILTER_ARG_SIZE];
+    void *state;          // フィルタごとの内部状態 (接続時に確保する)
+    struct filter *next;  // 次にかけるフィルタ
+} Filter;
+
+#define HALFBAND_HALF_TAPS 8                         // ハーフバンドフィルタの片側の係数の数
+#define HALFBAND_TAPS      (2 * HALFBAND_HALF_TAPS)  // 0でない係数を持つ位相の係数の数
+#define OVERSAMPLE_MAX_STAGES 2                      // 2倍を2段で4倍まで
+
+/* 2倍のアップ/ダウンサンプリング1段分の状態. 履歴は同じものを2回並べて窓を連続させる */
+typedef struct {
+    float up[2 * HALFBAND_TAPS];
+    float down_even[2 * HALFBAND_TAPS];
+    float down_odd[2 * HALFBAND_TAPS];
+    int64_t up_pos;
+    int64_t down_pos;
+} HalfbandStage;
+
+/* 非線形フィルタ用のオーバーサンプリング */
+typedef struct {
+    int64_t stages;
+    HalfbandStage stage[OVERSAMPLE_MAX_STAGES];
+} Oversampler;
+
+typedef float (*shaper_t)(float d, Filter *filter);
+
+/* 実数FFTの表 */
+typedef struct {
+    int64_t n;       // 実数の点数 (2の冪)
+    int64_t half;    // 内部で使う複素FFTの点数
+    int64_t *rev;    // ビット反転表
+    float *cos_tab;  // exp(-2πik/n)の実部と虚部 (k < n/2)
+    float *sin_tab;
+} FFTPlan;
+
+#define SPEC_FFT_SIZE    1024                 // STFTの窓の長さ
+#define SPEC_HOP         256                  // フレームの間隔
+#define SPEC_BINS        (SPEC_FFT_SIZE / 2)  // 1フレームで出す周波数の数
+#define SPEC_BATCH       64                   // まとめてスレッドに配るフレーム数
+#define SPEC_THREADS     4
+#define SPEC_MIN_DB      (-100.0)             // これより小さい値は黒にする
+
+/* 1フレーム分のdB値 (低い周波数から順) を受け取る */
+typedef void (*spec_row_t)(const float *db, void *arg);
+
+/* 少しずつ渡された信号のSTFTを求める */
+typedef struct {
+    FFTPlan *plan;
+    float *window;
+    float window_gain;
+    float *buf;       // 1バッチ分の入力
+    int64_t buf_len;
+    float *db;        // 1バッチ分の結果
+    float *work;      // スレッドごとの作業領域
+    spec_row_t row;
+    void *arg;
+    int64_t frames;   // 出力したフレーム数
+} Spectrogram;
+
+#define RESAMPLE_TAPS   32   // 1出力に使う入力の数
+#define RESAMPLE_PHASES 256  // 入力の間を何分割して係数を持つか
+
+/* 窓付きsincの多相フィルタによるサンプリング周波数の変換 */
+typedef struct {
+    const float *coef;  // (RESAMPLE_PHASES + 1)組の係数
+    double step;        // 出力1サンプルで進む入力の量
+    double frac;        // 次の出力の位置 (1以上なら入力が足りない)
+    int64_t pos;
+    float hist[2 * RESAMPLE_TAPS];  // 同じ履歴を2回並べて窓を連続させる
+} Resampler;
+
+#define REVERB_BLOCK_SIZE FRAMES_PER_BUFFER  // 畳み込みの1ブロック (遅延もこの長さ)
+
+/* 一様分割したoverlap-save畳み込み */
+typedef struct {
+    int64_t parts;   // インパルス応答の分割数
+    float *ir_spec;  // 分割ごとのスペクトル
+    float *fdl;      // 入力スペクトルの遅延線 (parts個のリング)
+    int64_t fdl_pos;
+    float *in_buf;   // 直近2ブロックの入力
+    float *out_buf;  // 次のブロックで出す出力
+    float *spec;     // 作業用
+    float *time;
+    int64_t pos;     // ブロック内の位置
+} Convolver;
+
+#define DELAY_BLOCK_SIZE   32     // 遅延時間とLFOはこのサンプル数ごとに計算し直す
+#define DELAY_MAX_TIME     2.0    // DELAYの遅延時間の上限[s]
+#define DELAY_MAX_FEEDBACK 0.95
+#define CHORUS_BASE_TIME   0.025  // 遅延の中心[s]
+#define CHORUS_SWEEP_TIME  0.010  // depth = 1のときの揺れ幅[s]
+#define FLANGER_BASE_TIME  0.003
+#define FLANGER_SWEEP_TIME 0.002
+
+/* 長さが2の冪の循環バッファによる遅延線 */
+typedef struct {
+    float *buf;
+    int64_t mask;  // 長さ - 1
+    int64_t pos;   // 次に書き込む位置
+} DelayLine;
+
+/* DELAY, CHORUS, FLANGERの内部状態 */
+typedef struct {
+    DelayLine line;
+    double delay;       // 今の遅延[サンプル] (負ならまだ決まっていない)
+    double delay_step;  // ブロックの間は1サンプルごとにこれだけ動かす
+    double lfo_phase;   // 0 ~ 1
+    int64_t block_pos;
+    int64_t sampling_rate;
+} DelayEffect;
+
+#define LIMITER_MAX_LOOKAHEAD  512    // 先読みできるサンプル数の上限 (2の冪)
+#define LIMITER_LOOKAHEAD_TIME 0.005  // 先読みする時間[s] (この分だけ音が遅れる)
+#define LIMITER_RELEASE_TIME   0.05   // 下げたゲインを戻す時定数[s]
+#define LIMITER_THRESHOLD      0.9    // 出力の最大値 (約-1dBFS)
+
+/* 先読みで最大値を見てゲインを下げるマスターリミッター */
+typedef struct {
+    float delay[LIMITER_MAX_LOOKAHEAD];     // 先読みの分だけ遅らせる入力
+    float peak[LIMITER_MAX_LOOKAHEAD];      // 窓の中の値の単調減少キュー
+    int64_t peak_t[LIMITER_MAX_LOOKAHEAD];  // キューの値が入った時刻
+    int64_t head;                           // キューの範囲 (& で折り返す)
+    int64_t tail;
+    float gain[LIMITER_MAX_LOOKAHEAD];      // 平均する前のゲイン
+    double gain_sum;
+    float held;                             // 直前の平均する前のゲイン
+    double release;                         // 1サンプルで戻す割合
+    int64_t lookahead;
+    int64_t t;
+} Limiter;
+
 /* 音色情報 */
 typedef struct {
     Oscillator *oscillator;
-    VectorPTR *filters;
+    Filter *filters;      // かける順に繋いだフィルタ
+    Filter *last_filter;
 } Sound;
 
+// ビブラートのLFOを更新する間隔(サンプル数)
+#define VIBRATO_CONTROL_PERIOD 32
+
 /* 演奏情報 */
 typedef struct {
     Sound *sound;
@@ -50,22 +207,63 @@ typedef struct {
     float freq[MAX_POLYPHONIC];
     int8_t volume;
     int64_t sampling_rate;
+
+    // ビブラート用. 各声部の位相(周期単位)と1サンプルあたりの増分
+    Filter *vibrato;
+    double phase[MAX_POLYPHONIC];
+    double phase_inc[MAX_POLYPHONIC];
+    double vibrato_mod;  // LFOで揺らす位相増分の倍率
 } Playdata;
 
-#define FILTER_ARG_SIZE 10
+#define SONG_MAX_VOICES 32  // 同時に鳴らす音の最大数. 超えた分は鳴らさない
+#define SONG_MAX_BUSES  16  // 音色を分ける数 (MIDIのトラックやチャンネル)
+#define SONG_MIX_GAIN   0.25  // 4声くらいまでは1つの音と同じ大きさにする
 
-/* フィルタ */
+/* 時刻の決まった1つの音 */
 typedef struct {
-    filtercode_t num;
-    Var *args[FILTER_ARG_SIZE];
-} Filter;
+    uint64_t start;   // 鳴り始める位置(サンプル)
+    uint64_t length;
+    float freq;
+    int8_t volume;
+    int64_t bus;      // どの音色で鳴らすか
+} SongNote;
+
+/* 音の並び. インタプリタを通さずにこのまま鳴らす */
+typedef struct {
+    SongNote *notes;  // 鳴り始める順
+    int64_t len;
+    int64_t capacity;
+    int64_t buses;    // 使っている音色の数
+    uint64_t length;  // 最後の音が鳴り終わる位置
+} Song;
+
+/* 鳴っている1つの音 */
+typedef struct {
+    const SongNote *note;
+    Playdata info;
+} SongVoice;
+
+/* Songを1サンプルずつ作る. 音色が同じ音は足してからまとめてフィルタをかける */
+typedef struct {
+    Song *song;
+    int64_t bus_of[SONG_MAX_BUSES];   // SongNote.busから音色のまとまりへ
+    Playdata bus[SONG_MAX_BUSES];
+    int64_t buses;
+    SongVoice voices[SONG_MAX_VOICES];
+    int64_t active;
+    int64_t next;                     // 次に鳴らし始める音
+    double fade_range;
+} SongPlayer;
 
 void init_sound_stream(Status *status);
 void terminate_sound_stream();
 void init_filter(VectorPTR *var_list);
 
 Filter *new_filter(filtercode_t fc);
+void init_filter_state(Filter *filter, int64_t sampling_rate);
+void reset_filters(Sound *sound);
 Oscillator *new_oscil(basicwave_t wave, basicwave_t fm_wave, float fm_freq);
+Oscillator *new_sample_oscil(Sample *sample);
 Sound *new_sound(Oscillator *osc);
 
 bool is_stream_active();
@@ -74,6 +272,68 @@ void set_stream_active_flag(bool b);
 // printwav, export命令用に音データを保存するバッファ
 extern float *databuf;
 void write_out_data(Playdata data, bool print_flag, bool fade_flag);
+void render_spectrogram(Playdata data, Spectrogram *spec);
+void render_offline(Playdata data);
+uint64_t output_length(uint64_t length);
 
+void init_vibrato(Playdata *info);
+void update_vibrato(Playdata *info, uint64_t t);
 float sound_generate(Playdata *info, uint64_t t, int64_t ch);
 float filtering(float data, Playdata *info, uint64_t t);
+float filtering_bus(float data, Playdata *info, uint64_t t);
+float detune_voice(float data, Playdata *info, uint64_t t);
+
+Oversampler *new_oversampler(int64_t factor);
+void reset_oversampler(Oversampler *os);
+float oversample(Oversampler *os, float d, shaper_t shape, Filter *filter);
+
+FFTPlan *new_fft_plan(int64_t n);
+void free_fft_plan(FFTPlan *plan);
+void rfft(const FFTPlan *plan, const float *in, float *out);
+void irfft(const FFTPlan *plan, float *in, float *out);
+
+Spectrogram *new_spectrogram(spec_row_t row, void *arg);
+void spectrogram_push(Spectrogram *spec, const float *data, int64_t n);
+void finish_spectrogram(Spectrogram *spec);
+void spec_color(float db, uint8_t rgb[3]);
+Spectrogram *open_spectrogram_file(const char *path);
+void close_spectrogram_file(Spectrogram *spec);
+
+void init_resampler(Resampler *rs, int64_t in_rate, int64_t out_rate);
+void free_resampler(Resampler *rs);
+void resampler_push(Resampler *rs, float d);
+float resampler_output(const Resampler *rs);
+
+Convolver *new_convolver(const double *ir, int64_t len);
+void reset_convolver(Convolver *cv);
+float convolve(Convolver *cv, float d);
+void free_reverb_plan();
+
+void init_delay_line(DelayLine *line, int64_t max_delay);
+void reset_delay_line(DelayLine *line);
+float delay_line_read(const DelayLine *line, double delay);
+void delay_line_write(DelayLine *line, float d);
+DelayEffect *new_delay_effect(double max_time, int64_t sampling_rate);
+void reset_delay_effect(DelayEffect *de);
+float delay_effect(DelayEffect *de, float d, double base_time, double sweep_time,
+                   double speed, double feedback, double mix);
+
+void init_limiter(Limiter *lm, int64_t sampling_rate);
+float limit(Limiter *lm, float d);
+
+Song *new_song();
+void free_song(Song *song);
+void song_add_note(Song *song, uint64_t start, uint64_t length, float freq, int8_t volume, int64_t bus);
+void finish_song(Song *song);
+void init_song_player(SongPlayer *sp, Song *song, Sound **sounds, int64_t sounds_num,
+                      int64_t sampling_rate, double fade_range);
+float song_render(SongPlayer *sp, uint64_t t);
+Song *load_midi(const char *path, int64_t sampling_rate);
+void write_out_song(SongPlayer *sp);
+void clear_out_song();
+void play_midi_file(Status *status, const char *path, Sound **sounds, int64_t sounds_num);
+void render_song_offline(SongPlayer *sp);
+
+Sample *load_sample(const char *path, double base_freq);
+void free_samples();
+float sample_read(const Sample *s, double pos);
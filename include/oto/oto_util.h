@@ -8,9 +8,35 @@
 #include <mymacro.h>
 
 char *src_open(const char *path);
+
+/**
+ * ソースファイルを読み込み専用でマップする. 終端には'\0'がある (失敗したらNULL)
+ * 書き換えてはいけない. 解放するときはsrc_unmap()にサイズと一緒に渡す
+ */
+char *src_map(const char *path, size_t *size);
+void src_unmap(char *src, size_t size);
+char *src_read(const char *path, size_t *size);
 size_t count_file_size(const char *path);
 bool is_otofile(const char *path);
 
+/* ファイルを読み込み専用でメモリにマップする(失敗したらNULL) */
+void *mmap_file(const char *path, size_t *size);
+void munmap_file(void *addr);
+
+/* ファイルの更新時刻とサイズ. 内容が変わったかどうかの判定に使う */
+typedef struct {
+    int64_t mtime;
+    int64_t size;
+} FileStamp;
+
+/* 取得できなかったらfalse */
+bool get_file_stamp(const char *path, FileStamp *stamp);
+
+/* FNV-1a (64bit). 続きから計算するときはhashに前回の値を渡す */
+#define FNV1A_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV1A_PRIME        0x100000001b3ULL
+uint64_t hash_fnv1a(const void *data, size_t len, uint64_t hash);
+
 char to_lower(char ch);
 char to_upper(char ch);
 
@@ -75,15 +101,63 @@ SliceI64 *new_slice_i64_from_slice(SliceI64 *org_slice, int64_t start, int64_t e
 void free_slice_i64(SliceI64 *slice);
 int64_t slice_i64_get(SliceI64 *slice, int64_t idx);
 
-/* Map */
+/* Arena (まとめて確保してまとめて捨てる領域) */
 typedef struct {
-    VectorPTR *keys;
-    VectorPTR *vals;
+    struct ArenaBlock *head;
+    struct ArenaBlock *cur;
+    size_t block_size;
+} Arena;
+
+Arena *new_arena(size_t block_size);
+void free_arena(Arena *arena);
+
+/* 0で埋めた領域を返す. arena_reset()かfree_arena()まで使える */
+void *arena_alloc(Arena *arena, size_t size);
+
+/* 確保した領域を全部捨てる(塊は次の確保で使い回す) */
+void arena_reset(Arena *arena);
+
+#define ARENA_ALLOC(arena, n, type)  ((type *)arena_alloc(arena, (n) * sizeof(type)))
+
+/* Arenaの中に作るSlice. free_slice_i64()で解放しない */
+SliceI64 *arena_slice_i64(Arena *arena, VectorI64 *vec, int64_t start, int64_t end);
+SliceI64 *arena_slice_i64_from_slice(Arena *arena, SliceI64 *org_slice, int64_t start, int64_t end);
+
+/* Map (開番地法のハッシュ表. キーの文字列はMapの中にコピーして持つ) */
+typedef struct {
+    char *key;      // NULLなら空き
+    size_t keylen;
+    uint64_t hash;
+    void *val;
+} MapEntry;
+
+typedef struct {
+    MapEntry *entries;
+    int64_t capacity;  // 2の冪
+    int64_t length;
+    struct MapPool *pool;
 } Map;
 
 Map *new_map();
-void free_map();
+void free_map(Map *map);
+
+/**
+ * keyの値の場所を返す. なければ値をNULLとして追加する
+ * (foundには既にあったかどうかが入る. 不要ならNULL)
+ */
+void **map_get_or_insert(Map *map, const char *key, size_t keylen, bool *found);
+
+/* keyの値の場所を返す. なければNULL */
+void **map_lookup(Map *map, const char *key, size_t keylen);
+
+/* keyと同じ内容のMapの中の文字列を返す */
+const char *map_intern(Map *map, const char *key, size_t keylen);
+
+/* iterを0から始めて, 次の要素を返す. 最後まで進んだらNULL */
+MapEntry *map_next(Map *map, int64_t *iter);
+
 void map_put(Map *map, char *key, void *val);
+
 void map_puti(Map *map, char *key, int64_t val);
 void *map_get(Map *map, char *key);
 int64_t map_geti(Map *map, char *key);
@@ -4,8 +4,20 @@ char *src = NULL;
 VectorPTR *vars = NULL;
 VectorPTR *ops  = NULL;
 Status *oto_status = NULL;
+int64_t loop_num = 0;  // ループカウンタの個数
+int64_t compile_unit = 0;  // compile()を呼んだ回数
+Arena *compile_arena = NULL;  // compile()の間だけ使う一時的なデータ
+
+/* 命令ごとの元になった文の先頭トークンの位置(プロファイラ用) */
+static VectorI64 *ic_tcidx = NULL;
+static int64_t stmt_tcidx = 0;
 
 void put_opcode(int64_t *icp, opcode_t op, Var *v1, Var *v2, Var *v3, Var *v4) {
+    // 後から書き換える命令は最初に書いたときの文のまま
+    if (*icp / 5 == ic_tcidx->length) {
+        vector_i64_append(ic_tcidx, stmt_tcidx);
+    }
+
     vector_ptr_set(ops, (*icp)++, (Var *)op);
     vector_ptr_set(ops, (*icp)++, v1);
     vector_ptr_set(ops, (*icp)++, v2);
@@ -35,6 +47,8 @@ const int64_t PTNS_DEFINE[] = {TC_DEFINE, PTN_LABEL, TC_COLON, PTN_LABEL, TC_LF,
 const int64_t PTNS_OSCILDEF[] = {PTN_LABEL, TC_EQU, TC_OSCIL, TC_SQBROPN, PTN_LABEL, TC_SQBRCLS, TC_LF, PTN_END};
 const int64_t PTNS_OSCILFMDEF[] = {PTN_LABEL, TC_EQU, TC_OSCIL, TC_SQBROPN, PTN_LABEL, TC_COMMA, PTN_LABEL, TC_COMMA, PTN_LABEL, TC_SQBRCLS, TC_LF, PTN_END};
 const int64_t PTNS_SOUNDDEF[] = {PTN_LABEL, TC_EQU, TC_SOUND, TC_SQBROPN, PTN_LABEL, TC_SQBRCLS, TC_LF, PTN_END};
+const int64_t PTNS_SAMPLEDEF[] = {PTN_LABEL, TC_EQU, TC_SAMPLE, TC_SQBROPN, PTN_LABEL, TC_SQBRCLS, TC_LF, PTN_END};
+const int64_t PTNS_SAMPLEBASEDEF[] = {PTN_LABEL, TC_EQU, TC_SAMPLE, TC_SQBROPN, PTN_LABEL, TC_COMMA, PTN_LABEL, TC_SQBRCLS, TC_LF, PTN_END};
 const int64_t PTNS_ARRAYDEF[] = {PTN_LABEL, TC_EQU, TC_SQBROPN, PTN_END};
 const int64_t PTNS_CONNECT_FILTER[] = {PTN_LABEL, TC_RARROW, PTN_END};
 const int64_t PTNS_CPYD[] = {PTN_LABEL, TC_EQU, PTN_LABEL, TC_LF, PTN_END};
@@ -56,11 +70,20 @@ const int64_t PTNS_DIVCPY_EXPR[] = {PTN_LABEL, TC_SLASEQ, PTN_EXPR, TC_LF, PTN_E
 const int64_t PTNS_MODCPY_EXPR[] = {PTN_LABEL, TC_PERCEQ, PTN_EXPR, TC_LF, PTN_END};
 const int64_t PTNS_LOOP[] = {TC_LOOP, PTN_END};
 const int64_t PTNS_IF[] = {TC_IF, PTN_END};
+const int64_t PTNS_FUNC[] = {TC_FUNC, PTN_END};
+const int64_t PTNS_FUNC_CALL[] = {PTN_LABEL, TC_SQBROPN, PTN_END};
 const int64_t PTNS_LABEL_ONLY[] = {PTN_LABEL, TC_LF, PTN_END};
 const int64_t PTNS_PRINT[] = {TC_PRINT, PTN_LABEL, TC_LF, PTN_END};
 const int64_t PTNS_EXIT[] = {TC_EXIT, TC_LF, PTN_END};
 const int64_t PTNS_INST[] = {PTN_INST, PTN_END};
 
+/* パターンの1要素がトークンと一致すればtrue */
+static bool ptn_elem_match(int64_t ptn, tokencode_t tc) {
+    return tc == ptn
+           || (ptn == PTN_LABEL && IS_NOT_SYMBOL(tc))   // 変数かラベル
+           || (ptn == PTN_INST && IS_INSTRUCTION(tc));  // 命令
+}
+
 /* src[i]から続くトークン列が指定したパターンと一致していればtrue */
 static bool ptn_cmp(SliceI64 *srctcs, int64_t i, const int64_t *pattarn) {
     reset_tmpvars();
@@ -69,20 +92,14 @@ static bool ptn_cmp(SliceI64 *srctcs, int64_t i, const int64_t *pattarn) {
     while (pattarn[ptn] != PTN_END) {
         tokencode_t tc = slice_i64_get(srctcs, i);
         
-        if (tc == pattarn[ptn]) {
-            // パターン一致
-
-        } else if (pattarn[ptn] == PTN_LABEL && IS_NOT_SYMBOL(tc)) {
-            tmpvars[vp++] = tc;
-
-        }  else if (pattarn[ptn] == PTN_INST && IS_INSTRUCTION(tc)) {
-            // 命令
-
-        } else if (pattarn[ptn] == PTN_EXPR) {
+        if (pattarn[ptn] == PTN_EXPR) {
             break;
 
-        } else {
+        } else if (!ptn_elem_match(pattarn[ptn], tc)) {
             return false;
+
+        } else if (pattarn[ptn] == PTN_LABEL) {
+            tmpvars[vp++] = tc;
         }
         ptn++;
         i++;
@@ -91,6 +108,147 @@ static bool ptn_cmp(SliceI64 *srctcs, int64_t i, const int64_t *pattarn) {
     return true;
 }
 
+/* 文の種類. 上にあるものほど優先して照合する */
+typedef enum {
+    STMT_DEFINE = 0,
+    STMT_SOUNDDEF,
+    STMT_OSCILFMDEF,
+    STMT_OSCILDEF,
+    STMT_SAMPLEDEF,
+    STMT_SAMPLEBASEDEF,
+    STMT_ARRAYDEF,
+    STMT_CONNECT_FILTER,
+    STMT_CPYD,
+    STMT_ADDCPY,
+    STMT_SUBCPY,
+    STMT_MULCPY,
+    STMT_DIVCPY,
+    STMT_MODCPY,
+    STMT_ADD2,
+    STMT_SUB2,
+    STMT_MUL2,
+    STMT_DIV2,
+    STMT_MOD2,
+    STMT_CPY_EXPR,
+    STMT_ADDCPY_EXPR,
+    STMT_SUBCPY_EXPR,
+    STMT_MULCPY_EXPR,
+    STMT_DIVCPY_EXPR,
+    STMT_MODCPY_EXPR,
+    STMT_FUNC_CALL,
+    STMT_FUNC,
+    STMT_LOOP,
+    STMT_IF,
+    STMT_INST,
+    STMT_LABEL_ONLY,
+    STMT_PRINT,
+    STMT_EXIT,
+    STMT_NUM,
+    STMT_NONE = -1
+} stmt_t;
+
+static const int64_t *stmt_ptns[STMT_NUM] = {
+    [STMT_DEFINE]         = PTNS_DEFINE,
+    [STMT_SOUNDDEF]       = PTNS_SOUNDDEF,
+    [STMT_OSCILFMDEF]     = PTNS_OSCILFMDEF,
+    [STMT_OSCILDEF]       = PTNS_OSCILDEF,
+    [STMT_SAMPLEDEF]      = PTNS_SAMPLEDEF,
+    [STMT_SAMPLEBASEDEF]  = PTNS_SAMPLEBASEDEF,
+    [STMT_ARRAYDEF]       = PTNS_ARRAYDEF,
+    [STMT_CONNECT_FILTER] = PTNS_CONNECT_FILTER,
+    [STMT_CPYD]           = PTNS_CPYD,
+    [STMT_ADDCPY]         = PTNS_ADDCPY,
+    [STMT_SUBCPY]         = PTNS_SUBCPY,
+    [STMT_MULCPY]         = PTNS_MULCPY,
+    [STMT_DIVCPY]         = PTNS_DIVCPY,
+    [STMT_MODCPY]         = PTNS_MODCPY,
+    [STMT_ADD2]           = PTNS_ADD2,
+    [STMT_SUB2]           = PTNS_SUB2,
+    [STMT_MUL2]           = PTNS_MUL2,
+    [STMT_DIV2]           = PTNS_DIV2,
+    [STMT_MOD2]           = PTNS_MOD2,
+    [STMT_CPY_EXPR]       = PTNS_CPY_EXPR,
+    [STMT_ADDCPY_EXPR]    = PTNS_ADDCPY_EXPR,
+    [STMT_SUBCPY_EXPR]    = PTNS_SUBCPY_EXPR,
+    [STMT_MULCPY_EXPR]    = PTNS_MULCPY_EXPR,
+    [STMT_DIVCPY_EXPR]    = PTNS_DIVCPY_EXPR,
+    [STMT_MODCPY_EXPR]    = PTNS_MODCPY_EXPR,
+    [STMT_FUNC_CALL]      = PTNS_FUNC_CALL,
+    [STMT_FUNC]           = PTNS_FUNC,
+    [STMT_LOOP]           = PTNS_LOOP,
+    [STMT_IF]             = PTNS_IF,
+    [STMT_INST]           = PTNS_INST,
+    [STMT_LABEL_ONLY]     = PTNS_LABEL_ONLY,
+    [STMT_PRINT]          = PTNS_PRINT,
+    [STMT_EXIT]           = PTNS_EXIT,
+};
+
+/**
+ * 文の先頭2トークンから, 一致する可能性のあるパターンの集合(ビット列)を引く表
+ *
+ * 変数やリテラル(TC_EXITより後ろ)はパターンの中でどれも同じ扱いなので
+ * TOKEN_CLASS_VARの1つにまとめる.
+ */
+#define TOKEN_CLASS_VAR   (TC_EXIT + 1)
+#define TOKEN_CLASS_NUM   (TC_EXIT + 2)
+#define TOKEN_CLASS(tc)   ((tc) > TC_EXIT ? TOKEN_CLASS_VAR : (tc))
+
+static uint64_t stmt_table[TOKEN_CLASS_NUM][TOKEN_CLASS_NUM];
+static bool stmt_table_ready = false;
+
+/* パターンの先頭2要素がトークンの種類c0, c1と一致しうるならtrue */
+static bool ptn_can_match(const int64_t *pattarn, tokencode_t c0, tokencode_t c1) {
+    tokencode_t cls[2] = {c0, c1};
+    for (int64_t k = 0; k < 2; k++) {
+        if (pattarn[k] == PTN_END || pattarn[k] == PTN_EXPR) {
+            return true;
+        }
+        if (!ptn_elem_match(pattarn[k], cls[k])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void init_stmt_table() {
+    if (stmt_table_ready) {
+        return;
+    }
+
+    for (tokencode_t c0 = 0; c0 < TOKEN_CLASS_NUM; c0++) {
+        for (tokencode_t c1 = 0; c1 < TOKEN_CLASS_NUM; c1++) {
+            uint64_t candidates = 0;
+            for (int64_t k = 0; k < STMT_NUM; k++) {
+                if (ptn_can_match(stmt_ptns[k], c0, c1)) {
+                    candidates |= (uint64_t)1 << k;
+                }
+            }
+            stmt_table[c0][c1] = candidates;
+        }
+    }
+    stmt_table_ready = true;
+}
+
+/* src[i]から始まる文の種類を調べる. 一致したトークンはtmpvarsに入る */
+static stmt_t match_stmt(SliceI64 *srctcs, int64_t i) {
+    tokencode_t c0 = TOKEN_CLASS(slice_i64_get(srctcs, i));
+    tokencode_t c1 = TOKEN_CLASS(slice_i64_get(srctcs, i + 1));
+    uint64_t candidates = stmt_table[c0][c1];
+
+    for (int64_t k = 0; candidates != 0; k++, candidates >>= 1) {
+        if ((candidates & 1) == 0 || !ptn_cmp(srctcs, i, stmt_ptns[k])) {
+            continue;
+        }
+        if (k == STMT_FUNC_CALL && VAR(tmpvars[1])->type != TY_FUNC) {
+            // 関数でないものの後ろの"["は配列の要素など
+            continue;
+        }
+        return (stmt_t)k;
+    }
+
+    return STMT_NONE;
+}
+
 void assign_to_literal_error_check(tokencode_t tc, SliceI64 *srctcs, int64_t idx) {
     tokentype_t type = VAR(tc)->token->type;
     if (type == TK_TY_LITERAL || type == TK_TY_RSVWORD || type == TK_TY_SYMBOL) {
@@ -100,12 +258,18 @@ void assign_to_literal_error_check(tokencode_t tc, SliceI64 *srctcs, int64_t idx
 
 void compile_sub(int64_t *icp, SliceI64 *srctcs, int64_t start, int64_t end) {
     int64_t i = start;
+    int64_t outer_tcidx = stmt_tcidx;
 
     while (i < end) {
+        stmt_tcidx = srctcs->abs_idx + i;
+
         if (slice_i64_get(srctcs, i) == TC_LF) {
             i++;
+            continue;
+        }
 
-        } else if (ptn_cmp(srctcs, i, PTNS_DEFINE)) {
+        switch (match_stmt(srctcs, i)) {
+        case STMT_DEFINE:
             assign_to_literal_error_check(tmpvars[1], srctcs, i);
             if (VAR(tmpvars[2])->type != TY_CONST) {
                 oto_error(OTO_DEFINE_ERROR);
@@ -113,89 +277,118 @@ void compile_sub(int64_t *icp, SliceI64 *srctcs, int64_t start, int64_t end) {
             VAR(tmpvars[1])->value = VAR(tmpvars[2])->value;
             VAR(tmpvars[1])->type  = TY_CONST;
             i += 5;
+            break;
 
-        } else if (ptn_cmp(srctcs, i, PTNS_SOUNDDEF)) {
+        case STMT_SOUNDDEF:
             assign_to_literal_error_check(tmpvars[1], srctcs, i);
             put_opcode(icp, OP_SOUNDDEF, VAR(tmpvars[1]), VAR(tmpvars[2]), 0, 0);
             i += 7;
+            break;
 
-        } else if (ptn_cmp(srctcs, i, PTNS_OSCILFMDEF)) {
+        case STMT_OSCILFMDEF:
             assign_to_literal_error_check(tmpvars[1], srctcs, i);
             put_opcode(icp, OP_OSCILDEF, VAR(tmpvars[1]), VAR(tmpvars[2]), VAR(tmpvars[3]), VAR(tmpvars[4]));
             i += 11;
+            break;
 
-        } else if (ptn_cmp(srctcs, i, PTNS_OSCILDEF)) {
+        case STMT_OSCILDEF:
             assign_to_literal_error_check(tmpvars[1], srctcs, i);
             put_opcode(icp, OP_OSCILDEF, VAR(tmpvars[1]), VAR(tmpvars[2]), 0, 0);
             i += 7;
+            break;
 
-        } else if (ptn_cmp(srctcs, i, PTNS_ARRAYDEF)) {
+        case STMT_SAMPLEDEF:
+            assign_to_literal_error_check(tmpvars[1], srctcs, i);
+            put_opcode(icp, OP_SAMPLEDEF, VAR(tmpvars[1]), VAR(tmpvars[2]), 0, 0);
+            i += 7;
+            break;
+
+        case STMT_SAMPLEBASEDEF:
+            assign_to_literal_error_check(tmpvars[1], srctcs, i);
+            put_opcode(icp, OP_SAMPLEDEF, VAR(tmpvars[1]), VAR(tmpvars[2]), VAR(tmpvars[3]), 0);
+            i += 9;
+            break;
+
+        case STMT_ARRAYDEF:
             assign_to_literal_error_check(tmpvars[1], srctcs, i);
             compile_array(icp, srctcs, &i);
+            break;
 
-        } else if (ptn_cmp(srctcs, i, PTNS_CONNECT_FILTER)) {
+        case STMT_CONNECT_FILTER: {
             SliceI64 *conntcs = make_line_tokencodes(srctcs, i);
             compile_conn_filter(icp, conntcs);
 
             i += conntcs->length;
-            free_slice_i64(conntcs);
+            break;
+        }
 
-        } else if (ptn_cmp(srctcs, i, PTNS_CPYD)) {
+        case STMT_CPYD:
             assign_to_literal_error_check(tmpvars[1], srctcs, i);
             put_opcode(icp, OP_CPYD, VAR(tmpvars[1]), VAR(tmpvars[2]), 0, 0);
             i += 4;
+            break;
 
-        } else if (ptn_cmp(srctcs, i, PTNS_ADDCPY)) {
+        case STMT_ADDCPY:
             assign_to_literal_error_check(tmpvars[1], srctcs, i);
             put_opcode(icp, OP_ADD2, VAR(tmpvars[1]), VAR(tmpvars[1]), VAR(tmpvars[2]), 0);
             i += 4;
+            break;
 
-        } else if (ptn_cmp(srctcs, i, PTNS_SUBCPY)) {
+        case STMT_SUBCPY:
             assign_to_literal_error_check(tmpvars[1], srctcs, i);
             put_opcode(icp, OP_SUB2, VAR(tmpvars[1]), VAR(tmpvars[1]), VAR(tmpvars[2]), 0);
             i += 4;
+            break;
 
-        } else if (ptn_cmp(srctcs, i, PTNS_MULCPY)) {
+        case STMT_MULCPY:
             assign_to_literal_error_check(tmpvars[1], srctcs, i);
             put_opcode(icp, OP_MUL2, VAR(tmpvars[1]), VAR(tmpvars[1]), VAR(tmpvars[2]), 0);
             i += 4;
+            break;
 
-        } else if (ptn_cmp(srctcs, i, PTNS_DIVCPY)) {
+        case STMT_DIVCPY:
             assign_to_literal_error_check(tmpvars[1], srctcs, i);
             put_opcode(icp, OP_DIV2, VAR(tmpvars[1]), VAR(tmpvars[1]), VAR(tmpvars[2]), 0);
             i += 4;
+            break;
 
-        } else if (ptn_cmp(srctcs, i, PTNS_MODCPY)) {
+        case STMT_MODCPY:
             assign_to_literal_error_check(tmpvars[1], srctcs, i);
             put_opcode(icp, OP_MOD2, VAR(tmpvars[1]), VAR(tmpvars[1]), VAR(tmpvars[2]), 0);
             i += 4;
+            break;
 
-        } else if (ptn_cmp(srctcs, i, PTNS_ADD2)) {
+        case STMT_ADD2:
             assign_to_literal_error_check(tmpvars[1], srctcs, i);
             put_opcode(icp, OP_ADD2, VAR(tmpvars[1]), VAR(tmpvars[2]), VAR(tmpvars[3]), 0);
             i += 6;
+            break;
 
-        } else if (ptn_cmp(srctcs, i, PTNS_SUB2)) {
+        case STMT_SUB2:
             assign_to_literal_error_check(tmpvars[1], srctcs, i);
             put_opcode(icp, OP_SUB2, VAR(tmpvars[1]), VAR(tmpvars[2]), VAR(tmpvars[3]), 0);
             i += 6;
+            break;
 
-        } else if (ptn_cmp(srctcs, i, PTNS_MUL2)) {
+        case STMT_MUL2:
             assign_to_literal_error_check(tmpvars[1], srctcs, i);
             put_opcode(icp, OP_MUL2, VAR(tmpvars[1]), VAR(tmpvars[2]), VAR(tmpvars[3]), 0);
             i += 6;
+            break;
 
-        } else if (ptn_cmp(srctcs, i, PTNS_DIV2)) {
+        case STMT_DIV2:
             assign_to_literal_error_check(tmpvars[1], srctcs, i);
             put_opcode(icp, OP_DIV2, VAR(tmpvars[1]), VAR(tmpvars[2]), VAR(tmpvars[3]), 0);
             i += 6;
+            break;
 
-        } else if (ptn_cmp(srctcs, i, PTNS_MOD2)) {
+        case STMT_MOD2:
             assign_to_literal_error_check(tmpvars[1], srctcs, i);
             put_opcode(icp, OP_MOD2, VAR(tmpvars[1]), VAR(tmpvars[2]), VAR(tmpvars[3]), 0);
             i += 6;
+            break;
 
-        } else if (ptn_cmp(srctcs, i, PTNS_CPY_EXPR)) {
+        case STMT_CPY_EXPR: {
             assign_to_literal_error_check(tmpvars[1], srctcs, i);
             SliceI64 *exprtcs = make_line_tokencodes(srctcs, i + 2);
             compile_expr(icp, exprtcs, vars);
@@ -204,11 +397,14 @@ void compile_sub(int64_t *icp, SliceI64 *srctcs, int64_t start, int64_t end) {
 
             // "<Var> =" の分だけ+2
             i += exprtcs->length + 2;
-            free_slice_i64(exprtcs);
+            break;
+        }
 
-        } else if (ptn_cmp(srctcs, i, PTNS_ADDCPY_EXPR) || ptn_cmp(srctcs, i, PTNS_SUBCPY_EXPR)
-                   || ptn_cmp(srctcs, i, PTNS_MULCPY_EXPR) || ptn_cmp(srctcs, i, PTNS_DIVCPY_EXPR)
-                   || ptn_cmp(srctcs, i, PTNS_MODCPY_EXPR)) {
+        case STMT_ADDCPY_EXPR:
+        case STMT_SUBCPY_EXPR:
+        case STMT_MULCPY_EXPR:
+        case STMT_DIVCPY_EXPR:
+        case STMT_MODCPY_EXPR: {
             assign_to_literal_error_check(tmpvars[1], srctcs, i);
             put_opcode(icp, OP_PUSH, VAR(tmpvars[1]), 0, 0, 0);
             SliceI64 *exprtcs = make_line_tokencodes(srctcs, i + 2);
@@ -230,58 +426,109 @@ void compile_sub(int64_t *icp, SliceI64 *srctcs, int64_t start, int64_t end) {
 
             // "<Var> =" の分だけ+2
             i += exprtcs->length + 2;
-            free_slice_i64(exprtcs);
+            break;
+        }
 
+        case STMT_FUNC_CALL:
+            compile_func_call(icp, srctcs, &i);
+            break;
 
-        } else if (ptn_cmp(srctcs, i, PTNS_LOOP)) {
+        case STMT_FUNC:
+            compile_func(icp, srctcs, &i);
+            break;
+
+        case STMT_LOOP:
             compile_loop(icp, srctcs, &i);
+            break;
 
-        } else if (ptn_cmp(srctcs, i, PTNS_IF)) {
+        case STMT_IF:
             compile_if(icp, srctcs, &i);
+            break;
 
-        } else if (ptn_cmp(srctcs, i, PTNS_INST)) {
+        case STMT_INST:
             compile_instruction(icp, srctcs, &i);
+            break;
 
-        } else if (ptn_cmp(srctcs, i, PTNS_LABEL_ONLY)) {
+        case STMT_LABEL_ONLY:
             i += 2;
+            break;
 
-        } else if (ptn_cmp(srctcs, i, PTNS_PRINT)) {
+        case STMT_PRINT:
             put_opcode(icp, OP_PRINT, VAR(tmpvars[1]), 0, 0, 0);
             i += 2;
+            break;
 
-        } else if (ptn_cmp(srctcs, i, PTNS_EXIT)) {
+        case STMT_EXIT:
             put_opcode(icp, OP_EXIT, 0, 0, 0, 0);
             i += 2;
+            break;
 
-        } else {
+        default:
             error_compiler(OTO_INVALID_SYNTAX_ERROR, srctcs, i);
+            break;
         }
     }
+
+    // ブロックの後ろに置く命令(LOOPのJMPなど)はブロックを含む文のもの
+    stmt_tcidx = outer_tcidx;
 }
 
+#define DEFAULT_MAX_OPCODES 4096
+#define COMPILE_ARENA_BLOCK_SIZE (64 * 1024)
+
 static void init_compile(VectorPTR *var_list, VectorPTR *opcodes, char *src_str, Status *status) {
     vars = var_list;
     ops = opcodes;
     src = src_str;
     oto_status = status;
+    loop_num = 0;
+    compile_unit++;
+    init_stmt_table();
+
+    free_vector_i64(ic_tcidx);
+    ic_tcidx = new_vector_i64(DEFAULT_MAX_OPCODES / 5);
+    if (IS_NULL(ic_tcidx)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+    stmt_tcidx = 0;
+
+    // 前回のコンパイルがエラーで抜けていても, ここで全部捨てる
+    if (IS_NULL(compile_arena)) {
+        compile_arena = new_arena(COMPILE_ARENA_BLOCK_SIZE);
+        if (IS_NULL(compile_arena)) {
+            oto_error(OTO_INTERNAL_ERROR);
+        }
+    }
+    arena_reset(compile_arena);
 }
 
-#define DEFAULT_MAX_OPCODES 4096
 VectorPTR *compile(VectorI64 *src_tokens, VectorPTR *var_list, char *src_str, Status *status) {
     VectorPTR *opcodes = new_vector_ptr(DEFAULT_MAX_OPCODES);
     if (IS_NULL(opcodes)) {
         oto_error(OTO_INTERNAL_ERROR);
     }
 
-    // 式や制御構文の解析でスライスの方が扱いやすい
-    SliceI64 *srctcs_slice = new_slice_i64(src_tokens, 0, src_tokens->length);
     init_compile(var_list, opcodes, src_str, status);
 
+    // 式や制御構文の解析でスライスの方が扱いやすい
+    SliceI64 *srctcs_slice = arena_slice_i64(compile_arena, src_tokens, 0, src_tokens->length);
+    if (IS_NULL(srctcs_slice)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+
     // opcodeをどこまで書き込んだか
     int64_t icp = 0;
     compile_sub(&icp, srctcs_slice, 0, src_tokens->length);
 
-    free_slice_i64(srctcs_slice);
+    arena_reset(compile_arena);
 
     return opcodes;
 }
+
+/* 内部コードのpc番目の命令を生成した文の位置. わからなければNULL */
+const SrcPos *get_ic_pos(int64_t pc) {
+    if (IS_NULL(ic_tcidx) || pc / 5 >= ic_tcidx->length) {
+        return NULL;
+    }
+    return get_src_pos(ic_tcidx->data[pc / 5]);
+}
@@ -5,6 +5,28 @@
 extern char *src;
 extern VectorPTR *vars;
 extern Status *oto_status;
+extern int64_t loop_num;
+extern int64_t compile_unit;
+
+/* compile()の間だけ使うスライスなどを置く領域. compile()のたびに空になる */
+extern Arena *compile_arena;
+
+/**
+ * FUNCで定義した関数(コンパイル時の情報)
+ *
+ * REPLでは入力ごとに内部コードが変わるので, 本体のトークン列を持っておき
+ * 別の入力から呼ばれたときにもう一度出力する.
+ * 変数の値と同じだけ残るので, REGION_FUNCに置いてRESETや--watchの読み直しで捨てる.
+ */
+typedef struct {
+    VectorI64 *params;   // 引数のトークンコード
+    VectorI64 *body;     // 本体のトークンコード列
+    VectorI64 *written;  // 本体で書き換えられる変数のトークンコード
+    int64_t body_idx;    // 本体の先頭のトークンの位置
+    int64_t entry;       // 本体を出力した内部コードの位置
+    int64_t unit;        // 本体を出力したコンパイル単位
+    bool inlinable;
+} Func;
 
 /* 変数を取得するための便利マクロ */
 #define VAR(tc)  ((Var *)(vars->data[tc]))
@@ -15,11 +37,14 @@ void put_opcode(int64_t *icp, opcode_t op, Var *v1, Var *v2, Var *v3, Var *v4);
 void compile_sub(int64_t *icp, SliceI64 *srctcs, int64_t start, int64_t end);
 void compile_loop(int64_t *icp, SliceI64 *srctcs, int64_t *idx);
 void compile_if(int64_t *icp, SliceI64 *srctcs, int64_t *idx);
+void compile_func(int64_t *icp, SliceI64 *srctcs, int64_t *idx);
+void compile_func_call(int64_t *icp, SliceI64 *srctcs, int64_t *idx);
 void compile_expr(int64_t *icp, SliceI64 *exprtcs, VectorPTR *vars);
 void compile_args(int64_t *icp, SliceI64 *argtcs, int64_t max_params);
 void compile_instruction(int64_t *icp, SliceI64 *srctcs, int64_t *idx);
 void compile_conn_filter(int64_t *icp, SliceI64 *conntcs);
 void compile_array(int64_t *icp, SliceI64 *srctcs, int64_t *idx);
+void compile_mml(int64_t *icp, SliceI64 *argtcs);
 
 SliceI64 *make_line_tokencodes(SliceI64 *srctcs, int64_t start);
 SliceI64 *make_args_enclosed_br(SliceI64 *srctcs, int64_t sqbropn);
@@ -29,7 +54,4 @@ SliceI64 *make_ifthen_block(SliceI64 *srctcs, int64_t then);
 
 void print_slice_srcs(SliceI64 *srctcs);
 
-void error_compiler(errorcode_t err, SliceI64 *srctcs, int64_t idx);
-
-// トークンコード列でのidxをソース文字列でのidxに変換する
-int64_t tc2srcidx(SliceI64 *srctcs, int64_t tcidx);
\ No newline at end of file
+void error_compiler(errorcode_t err, SliceI64 *srctcs, int64_t idx);
\ No newline at end of file
@@ -1,8 +1,10 @@
 #include "compiler.h"
 
 static int64_t get_init_filtercode(tokencode_t tc) {
+    Token *token = VAR(tc)->token;
     for (int64_t i = 0; i < FILTER_NUM; i++) {
-        if (strcmp(def_filters[i].s, VAR(tc)->token->str) == 0) {
+        if (def_filters[i].sl == token->len
+            && strncmp(def_filters[i].s, token->str, token->len) == 0) {
             return i;
         }
     }
@@ -1,7 +1,5 @@
 #include "compiler.h"
 
-#define DEFAULT_RPN_TC_LIST_SIZE 1000
-
 static opcode_t tc2op(tokencode_t tc) {
     switch (tc) {
         case TC_PLUS:   return OP_ADD;
@@ -55,8 +53,14 @@ static int32_t priority_cmp(tokencode_t tc1, tokencode_t tc2) {
     return p1 - p2;
 }
 
+/* 逆ポーランド記法に並べ替える. rpntcsには式のトークン数だけ空きが必要 */
 static void rpn(SliceI64 *exprtcs, VectorI64 *rpntcs) {
-    Stack *stack = new_stack();
+    // 演算子のスタック(式のトークン数より深くはならない)
+    tokencode_t *stack = ARENA_ALLOC(compile_arena, exprtcs->length + 1, tokencode_t);
+    if (IS_NULL(stack)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+    int64_t sp = 0;
 
     /* 直前のトークンが演算子だったかどうか */
     bool is_before_op = true;
@@ -65,14 +69,13 @@ static void rpn(SliceI64 *exprtcs, VectorI64 *rpntcs) {
         tokencode_t tc = slice_i64_get(exprtcs, i);
 
         if (IS_AVAILABLE_VAR(tc)) {
-            vector_i64_append(rpntcs, tc);
+            rpntcs->data[rpntcs->length++] = tc;
             is_before_op = false;
         
         } else if (tc == TC_BROPN) {
             SliceI64 *exprtcs2 = make_args_enclosed_br(exprtcs, i);
             rpn(exprtcs2, rpntcs);
             i += exprtcs2->length;
-            free_slice_i64(exprtcs2);
             is_before_op = false;
 
         } else if (IS_ARITH_OPERATOR(tc)) {
@@ -84,16 +87,17 @@ static void rpn(SliceI64 *exprtcs, VectorI64 *rpntcs) {
                 is_before_op = true;
             }
 
-            if (priority_cmp(tc, stack_peeki(stack)) > 0) {
-                stack_pushi(stack, tc);
+            // 空のスタックの先頭は優先度0(TC_LF)として比べる
+            if (sp == 0 || priority_cmp(tc, stack[sp - 1]) > 0) {
+                stack[sp++] = tc;
                 continue;
             }
 
             /* スタックの先頭の優先度が低くなるか, spが0になるまで書き込む */
-            while (stack->sp > 0 && priority_cmp(tc, stack_peeki(stack)) <= 0) {
-                vector_i64_append(rpntcs, stack_popi(stack));
+            while (sp > 0 && priority_cmp(tc, stack[sp - 1]) <= 0) {
+                rpntcs->data[rpntcs->length++] = stack[--sp];
             }
-            stack_pushi(stack, tc);
+            stack[sp++] = tc;
         }
     }
 
@@ -103,11 +107,9 @@ static void rpn(SliceI64 *exprtcs, VectorI64 *rpntcs) {
     }
 
     /* 残っている演算子を全て書き込む */
-    while (stack->sp > 0) {
-        vector_i64_append(rpntcs, stack_popi(stack));
+    while (sp > 0) {
+        rpntcs->data[rpntcs->length++] = stack[--sp];
     }
-
-    free_stack(stack);
 }
 
 static void expr_sub(int64_t *icp, VectorI64 *rpntcs, VectorPTR *vars) {
@@ -129,12 +131,18 @@ static void expr_sub(int64_t *icp, VectorI64 *rpntcs, VectorPTR *vars) {
 
 /* idxは式の先頭 */
 void compile_expr(int64_t *icp, SliceI64 *exprtcs, VectorPTR *vars) {
-    VectorI64 *rpntcs = new_vector_i64(DEFAULT_RPN_TC_LIST_SIZE);
-    rpn(exprtcs, rpntcs);
+    // 逆ポーランド記法にしても式のトークン数より長くはならない
+    VectorI64 rpntcs = {0};
+    rpntcs.capacity = exprtcs->length;
+    rpntcs.data = ARENA_ALLOC(compile_arena, rpntcs.capacity, int64_t);
+    if (IS_NULL(rpntcs.data)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+
+    rpn(exprtcs, &rpntcs);
 #ifdef DEBUG
-    print_rpn_tc(rpntcs);
+    print_rpn_tc(&rpntcs);
 #endif
 
-    expr_sub(icp, rpntcs, vars);
-    free_vector_i64(rpntcs);
+    expr_sub(icp, &rpntcs, vars);
 }
@@ -13,11 +13,11 @@ void compile_loop(int64_t *icp, SliceI64 *srctcs, int64_t *idx) {
     compile_sub(icp, slice, 0, slice->length);
 
     put_opcode(icp, OP_JMP, (Var *)jmp_icp, 0, 0, 0);
-    put_opcode(&jmp_icp, OP_LOOP, ((Var *)*icp), loop_cnt, 0, 0);
+    // ループカウンタは実行フレームのloop_cnts[slot]に置く
+    int64_t slot = loop_num++;
+    put_opcode(&jmp_icp, OP_LOOP, ((Var *)*icp), loop_cnt, (Var *)slot, 0);
 
     *idx = idx2 + slice->length;
-
-    free_slice_i64(slice);
 }
 
 void compile_if(int64_t *icp, SliceI64 *srctcs, int64_t *idx) {
@@ -33,7 +33,6 @@ void compile_if(int64_t *icp, SliceI64 *srctcs, int64_t *idx) {
     SliceI64 *slice = make_args_enclosed_br(srctcs, idx2);
     compile_expr(icp, slice, vars);
     idx2 += slice->length + 2;
-    free_slice_i64(slice);
 
     int64_t jmp_icp = *icp;
     put_opcode(icp, OP_JZ, 0, 0, 0, 0);
@@ -41,7 +40,6 @@ void compile_if(int64_t *icp, SliceI64 *srctcs, int64_t *idx) {
     slice = make_ifthen_block(srctcs, idx2);
     compile_sub(icp, slice, 0, slice->length);
     idx2 += slice->length + 1;
-    free_slice_i64(slice);
 
     int64_t jmp_icp2 = *icp;
     put_opcode(icp, OP_JMP, 0, 0, 0, 0);
@@ -60,7 +58,6 @@ void compile_if(int64_t *icp, SliceI64 *srctcs, int64_t *idx) {
 
         compile_sub(icp, slice, 0, slice->length);
         idx2 += slice->length;
-        free_slice_i64(slice);
 
     } else {
         idx2++;
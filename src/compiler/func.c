@@ -0,0 +1,242 @@
+#include "compiler.h"
+
+/* この数以下のトークンで書かれた関数はインライン展開の候補にする */
+#define FUNC_INLINE_MAX_TOKENS 48
+
+/* 代入や接続で書き換えられるトークンならtrue */
+static bool is_written(Func *func, tokencode_t tc) {
+    for (int64_t i = 0; i < func->written->length; i++) {
+        if (func->written->data[i] == tc) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* 本体の中で書き換えられる変数を集める */
+static void collect_written(Func *func) {
+    VectorI64 *body = func->body;
+    int64_t line_start = 0;
+
+    while (line_start < body->length) {
+        int64_t line_end = line_start;
+        int64_t assign = -1;
+        bool connect = false;
+        while (line_end < body->length && body->data[line_end] != TC_LF) {
+            tokencode_t tc = body->data[line_end];
+            if (assign < 0 && (tc == TC_EQU || tc == TC_COLON
+                               || (TC_PLUSEQ <= tc && tc <= TC_PERCEQ))) {
+                assign = line_end;
+            } else if (tc == TC_RARROW) {
+                connect = true;
+            }
+            line_end++;
+        }
+
+        // "a = ..." や "DEFINE a : ..." の左辺, "a -> LPF[..] -> b" の全部
+        int64_t end = connect ? line_end : assign;
+        for (int64_t i = line_start; i < end; i++) {
+            if (IS_AVAILABLE_VAR(body->data[i])) {
+                vector_i64_append(func->written, body->data[i]);
+            }
+        }
+
+        line_start = line_end + 1;
+    }
+}
+
+/* 他の関数を呼ばない小さな関数で, 引数を書き換えないならインライン展開できる */
+static bool is_inlinable(Func *func) {
+    if (func->body->length > FUNC_INLINE_MAX_TOKENS) {
+        return false;
+    }
+
+    for (int64_t i = 0; i < func->body->length; i++) {
+        tokencode_t tc = func->body->data[i];
+        if (tc == TC_FUNC || tc == TC_EXIT || VAR(tc)->type == TY_FUNC) {
+            return false;
+        }
+    }
+
+    for (int64_t i = 0; i < func->params->length; i++) {
+        if (is_written(func, func->params->data[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* REGION_FUNCに置くベクタ. 入る数を先に決めるので伸ばさない */
+static VectorI64 *new_func_vector(size_t capacity) {
+    VectorI64 *vec = REGION_ALLOC(REGION_FUNC, 1, VectorI64);
+    vec->data     = REGION_ALLOC(REGION_FUNC, capacity, int64_t);
+    vec->length   = 0;
+    vec->capacity = capacity;
+    return vec;
+}
+
+/* 関数の本体を出力する (JMP 関数の後ろ; PARAM ...; 本体; RET) */
+static void put_func_body(int64_t *icp, Func *func) {
+    int64_t jmp_icp = *icp;
+    put_opcode(icp, OP_JMP, 0, 0, 0, 0);
+
+    func->entry = *icp;
+    func->unit  = compile_unit;
+    for (int64_t i = 0; i < func->params->length; i++) {
+        put_opcode(icp, OP_PARAM, VAR(func->params->data[i]), (Var *)i, 0, 0);
+    }
+
+    SliceI64 *body = arena_slice_i64(compile_arena, func->body, 0, func->body->length);
+    if (IS_NULL(body)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+    body->abs_idx = func->body_idx;
+    compile_sub(icp, body, 0, body->length);
+
+    put_opcode(icp, OP_RET, (Var *)func->params->length, 0, 0, 0);
+    put_opcode(&jmp_icp, OP_JMP, (Var *)*icp, 0, 0, 0);
+}
+
+void compile_func(int64_t *icp, SliceI64 *srctcs, int64_t *idx) {
+    int64_t idx2 = *idx + 1;
+
+    tokencode_t name = slice_i64_get(srctcs, idx2);
+    if (!IS_AVAILABLE_VAR(name) || VAR(name)->token->type != TK_TY_VARIABLE) {
+        error_compiler(OTO_INVALID_SYNTAX_ERROR, srctcs, idx2);
+    }
+    idx2++;
+
+    if (slice_i64_get(srctcs, idx2) != TC_SQBROPN) {
+        error_compiler(OTO_INVALID_SYNTAX_ERROR, srctcs, idx2);
+    }
+
+    Func *func = REGION_ALLOC(REGION_FUNC, 1, Func);
+
+    // 引数 [a, b, ...]
+    SliceI64 *paramtcs = make_args_enclosed_br(srctcs, idx2);
+    func->params = new_func_vector(paramtcs->length / 2 + 1);
+    for (int64_t i = 0; i < paramtcs->length; i += 2) {
+        tokencode_t tc = slice_i64_get(paramtcs, i);
+        if (!IS_AVAILABLE_VAR(tc) || VAR(tc)->token->type != TK_TY_VARIABLE
+            || (i + 1 < paramtcs->length && slice_i64_get(paramtcs, i + 1) != TC_COMMA)) {
+            error_compiler(OTO_INVALID_SYNTAX_ERROR, srctcs, idx2 + 1 + i);
+        }
+        vector_i64_append(func->params, tc);
+    }
+    if (func->params->length > FUNC_MAX_PARAMS) {
+        error_compiler(OTO_TOO_MANY_ARGUMENTS_ERROR, srctcs, idx2);
+    }
+    idx2 += paramtcs->length + 1;
+
+    // "]"の次からENDまでが本体
+    SliceI64 *body = make_begin_end_block(srctcs, idx2);
+    func->body = new_func_vector(body->length + 1);
+    // 書き換えられる変数は本体のトークンの数より多くならない
+    func->written = new_func_vector(body->length + 1);
+    for (int64_t i = 0; i < body->length; i++) {
+        vector_i64_append(func->body, slice_i64_get(body, i));
+    }
+    func->body_idx = body->abs_idx;
+
+    // 本体の中で自分自身を呼べるように先に登録する
+    VAR(name)->type    = TY_FUNC;
+    VAR(name)->value.p = (void *)func;
+
+    collect_written(func);
+    func->inlinable = is_inlinable(func);
+    put_func_body(icp, func);
+
+    *idx = idx2 + 1 + body->length + 1;
+}
+
+/* 引数を書き換えた本体をその場でコンパイルする */
+static void inline_func(int64_t *icp, Func *func, SliceI64 *argtcs) {
+    VectorI64 body = {0};
+    body.capacity = func->body->length;
+    body.data = ARENA_ALLOC(compile_arena, body.capacity, int64_t);
+    if (IS_NULL(body.data)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+
+    for (int64_t i = 0; i < func->body->length; i++) {
+        tokencode_t tc = func->body->data[i];
+        for (int64_t j = 0; j < func->params->length; j++) {
+            if (tc == func->params->data[j]) {
+                tc = slice_i64_get(argtcs, j * 2);
+                break;
+            }
+        }
+        body.data[body.length++] = tc;
+    }
+
+    SliceI64 *slice = arena_slice_i64(compile_arena, &body, 0, body.length);
+    if (IS_NULL(slice)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+    slice->abs_idx = func->body_idx;
+    compile_sub(icp, slice, 0, slice->length);
+}
+
+/* 引数がすべて1トークンで, 本体で書き換えられないならインライン展開できる */
+static bool can_inline_args(Func *func, SliceI64 *argtcs) {
+    if (!func->inlinable) {
+        return false;
+    }
+
+    for (int64_t i = 0; i < argtcs->length; i++) {
+        tokencode_t tc = slice_i64_get(argtcs, i);
+        if (i % 2 == 1) {
+            if (tc != TC_COMMA) {
+                return false;
+            }
+        } else if (IS_SYMBOL(tc) || is_written(func, tc)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void compile_func_call(int64_t *icp, SliceI64 *srctcs, int64_t *idx) {
+    Func *func = (Func *)VAR(slice_i64_get(srctcs, *idx))->value.p;
+    SliceI64 *argtcs = make_args_enclosed_br(srctcs, *idx + 1);
+
+    // 引数の数を数える
+    int64_t argc = 0;
+    int64_t nest = 0;
+    for (int64_t i = 0; i < argtcs->length; i++) {
+        tokencode_t tc = slice_i64_get(argtcs, i);
+        if (tc == TC_SQBROPN || tc == TC_BROPN) {
+            nest++;
+        } else if (tc == TC_SQBRCLS || tc == TC_BRCLS) {
+            nest--;
+        } else if (tc == TC_COMMA && nest == 0) {
+            argc++;
+        }
+    }
+    if (argtcs->length > 0) {
+        argc++;
+    }
+
+    if (argc > func->params->length) {
+        error_compiler(OTO_TOO_MANY_ARGUMENTS_ERROR, srctcs, *idx);
+    } else if (argc < func->params->length) {
+        error_compiler(OTO_MISSING_ARGUMENTS_ERROR, srctcs, *idx);
+    }
+
+    if (can_inline_args(func, argtcs)) {
+        inline_func(icp, func, argtcs);
+
+    } else {
+        // REPLで前の入力で定義した関数は今の内部コードにもう一度出力する
+        if (func->unit != compile_unit) {
+            put_func_body(icp, func);
+        }
+
+        compile_args(icp, argtcs, argc);
+        put_opcode(icp, OP_CALL, (Var *)func->entry, (Var *)argc, 0, 0);
+    }
+
+    *idx += argtcs->length + 3;
+}
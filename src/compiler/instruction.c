@@ -17,10 +17,21 @@ void compile_instruction(int64_t *icp, SliceI64 *srctcs, int64_t *idx) {
         compile_args(icp, argtcs, 4);
         put_opcode(icp, OP_PLAY, 0, 0, 0, 0);
         break;
+    case TC_PLAYMIDI:
+        compile_args(icp, argtcs, 1 + PLAYMIDI_MAX_SOUNDS);
+        put_opcode(icp, OP_PLAYMIDI, 0, 0, 0, 0);
+        break;
+    case TC_MML:
+        compile_mml(icp, argtcs);
+        break;
     case TC_PRINTWAV:
         compile_args(icp, argtcs, 4);
         put_opcode(icp, OP_PRINTWAV, 0, 0, 0, 0);
         break;
+    case TC_PRINTSPEC:
+        compile_args(icp, argtcs, 4);
+        put_opcode(icp, OP_PRINTSPEC, 0, 0, 0, 0);
+        break;
     case TC_PRINTVAR:
         compile_args(icp, argtcs, 0);
         put_opcode(icp, OP_PRINTVAR, 0, 0, 0, 0);
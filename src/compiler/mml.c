@@ -0,0 +1,228 @@
+#include <ctype.h>
+#include <math.h>
+
+#include "compiler.h"
+
+/**
+ * MML (Music Macro Language) をコンパイル時に音の並びへ展開する
+ *
+ *   MML "t120 o4 l8 cdefedc4", S
+ *
+ * 文字列はコンパイルのときに解釈して, PLAYMML命令1つとその後ろに続く
+ * 音の数だけのMMLNOTE(鳴り始め, 長さ, 周波数, 音量)として出力する.
+ * 実行時には並びをそのままSongにして鳴らすので, 1音ずつPLAYを実行する
+ * のと違って文字列の解釈も命令の実行も音の数に比例しない.
+ *
+ * c d e f g a b : 音符 (+ # で半音上げ, - で半音下げ. 後ろに長さと付点)
+ * r             : 休符
+ * o<n> < >      : オクターブ (o4のaが440Hz)
+ * l<n>          : 長さを省略したときの長さ
+ * t<n>          : テンポ (4分音符/分)
+ * v<n>          : 音量 (0 ~ 100)
+ * &             : 次の音が同じ高さなら前の音に長さを足す (タイ).
+ *                 違う高さなら切らずに次の音を鳴らす (レガート)
+ */
+
+#define MML_DEFAULT_TEMPO  120
+#define MML_DEFAULT_OCTAVE 4
+#define MML_DEFAULT_LENGTH 4
+#define MML_DEFAULT_VOLUME 80
+#define MML_MAX_OCTAVE     9
+
+typedef struct {
+    double start;   // 秒
+    double length;  // 秒
+    double freq;
+    int64_t volume;
+} MmlNote;
+
+typedef struct {
+    const char *s;
+    size_t len;
+    size_t pos;
+} MmlReader;
+
+static bool mml_eof(MmlReader *r) {
+    return r->pos >= r->len;
+}
+
+static char mml_peek(MmlReader *r) {
+    return mml_eof(r) ? '\0' : (char)tolower((unsigned char)r->s[r->pos]);
+}
+
+/* 数字が続けば読んで返す. なければdefを返す */
+static int64_t mml_number(MmlReader *r, int64_t def) {
+    if (!isdigit((unsigned char)mml_peek(r))) {
+        return def;
+    }
+    int64_t n = 0;
+    while (isdigit((unsigned char)mml_peek(r))) {
+        n = n * 10 + (r->s[r->pos++] - '0');
+        if (n > 10000) {
+            n = 10000;
+        }
+    }
+    return n;
+}
+
+/* 長さ(n分音符)と付点を読んで秒にする */
+static double mml_duration(MmlReader *r, int64_t def_len, int64_t tempo) {
+    int64_t n = mml_number(r, def_len);
+    if (n <= 0) {
+        n = def_len;
+    }
+
+    double whole = 4 * 60.0 / tempo;
+    double dur = whole / n;
+    double dot = dur;
+    while (mml_peek(r) == '.') {
+        r->pos++;
+        dot /= 2;
+        dur += dot;
+    }
+    return dur;
+}
+
+/* "cdefgab"の何番目の音から, cからの半音の数 */
+static const int64_t mml_semitones[] = {9, 11, 0, 2, 4, 5, 7};
+
+/* 文字列を音の並びにする. 解釈できない文字があれば-1を返す */
+static int64_t parse_mml(const char *s, size_t len, MmlNote *notes, double *total) {
+    MmlReader r = {s, len, 0};
+    int64_t tempo   = MML_DEFAULT_TEMPO;
+    int64_t octave  = MML_DEFAULT_OCTAVE;
+    int64_t def_len = MML_DEFAULT_LENGTH;
+    int64_t volume  = MML_DEFAULT_VOLUME;
+    double t = 0;
+    int64_t count = 0;
+    int64_t prev_key = -1;  // 最後に出した音の高さ
+    bool tie = false;
+
+    while (!mml_eof(&r)) {
+        char c = mml_peek(&r);
+        r.pos++;
+
+        if (isspace((unsigned char)c) || c == '|') {
+            continue;
+        }
+
+        if ('a' <= c && c <= 'g') {
+            int64_t key = 12 * (octave + 1) + mml_semitones[c - 'a'];
+            for (;;) {
+                char acc = mml_peek(&r);
+                if (acc == '+' || acc == '#') {
+                    key++;
+                } else if (acc == '-') {
+                    key--;
+                } else {
+                    break;
+                }
+                r.pos++;
+            }
+            double dur = mml_duration(&r, def_len, tempo);
+
+            if (tie && count > 0 && key == prev_key) {
+                notes[count - 1].length += dur;
+            } else {
+                MmlNote *note = &notes[count++];
+                note->start  = t;
+                note->length = dur;
+                note->freq   = 440.0 * pow(2.0, (key - 69) / 12.0);
+                note->volume = volume;
+                prev_key = key;
+            }
+            t += dur;
+            tie = false;
+
+        } else if (c == 'r') {
+            t += mml_duration(&r, def_len, tempo);
+            tie = false;
+
+        } else if (c == '&') {
+            tie = true;
+
+        } else if (c == 'o') {
+            octave = mml_number(&r, MML_DEFAULT_OCTAVE);
+            if (octave > MML_MAX_OCTAVE) {
+                octave = MML_MAX_OCTAVE;
+            }
+        } else if (c == '<') {
+            if (octave > 0) {
+                octave--;
+            }
+        } else if (c == '>') {
+            if (octave < MML_MAX_OCTAVE) {
+                octave++;
+            }
+        } else if (c == 'l') {
+            def_len = mml_number(&r, MML_DEFAULT_LENGTH);
+            if (def_len <= 0) {
+                def_len = MML_DEFAULT_LENGTH;
+            }
+        } else if (c == 't') {
+            tempo = mml_number(&r, MML_DEFAULT_TEMPO);
+            if (tempo <= 0) {
+                tempo = MML_DEFAULT_TEMPO;
+            }
+        } else if (c == 'v') {
+            volume = mml_number(&r, MML_DEFAULT_VOLUME);
+            if (volume > 100) {
+                volume = 100;
+            }
+        } else {
+            return -1;
+        }
+    }
+
+    *total = t;
+    return count;
+}
+
+/* 秒や周波数をそのまま内部コードのオペランドに入れる */
+static Var *double_operand(double val) {
+    union value_u v = {0};
+    v.f = val;
+    return (Var *)v.p;
+}
+
+void compile_mml(int64_t *icp, SliceI64 *argtcs) {
+    if (argtcs->length == 0) {
+        error_compiler(OTO_MISSING_ARGUMENTS_ERROR, argtcs, 0);
+    }
+    tokencode_t str_tc = slice_i64_get(argtcs, 0);
+    if (!IS_AVAILABLE_VAR(str_tc) || VAR(str_tc)->token->type != TK_TY_STRING) {
+        error_compiler(OTO_ARGUMENTS_TYPE_ERROR, argtcs, 0);
+    }
+
+    // MML "..." または MML "...", S
+    Var *sound = NULL;
+    if (argtcs->length == 3 && slice_i64_get(argtcs, 1) == TC_COMMA
+        && IS_AVAILABLE_VAR(slice_i64_get(argtcs, 2))) {
+        sound = VAR(slice_i64_get(argtcs, 2));
+    } else if (argtcs->length > 3) {
+        error_compiler(OTO_TOO_MANY_ARGUMENTS_ERROR, argtcs, 0);
+    } else if (argtcs->length != 1) {
+        error_compiler(OTO_INVALID_SYNTAX_ERROR, argtcs, 0);
+    }
+
+    // 1文字で1音より多くはならない
+    const char *str = ((String *)VAR(str_tc)->value.p)->str;
+    size_t len = strlen(str);
+    MmlNote *notes = ARENA_ALLOC(compile_arena, len + 1, MmlNote);
+    if (IS_NULL(notes)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+
+    double total = 0;
+    int64_t count = parse_mml(str, len, notes, &total);
+    if (count < 0) {
+        error_compiler(OTO_INVALID_SYNTAX_ERROR, argtcs, 0);
+    }
+
+    put_opcode(icp, OP_PLAYMML, sound, (Var *)count, double_operand(total), 0);
+    for (int64_t i = 0; i < count; i++) {
+        put_opcode(icp, OP_MMLNOTE, double_operand(notes[i].start),
+                   double_operand(notes[i].length), double_operand(notes[i].freq),
+                   (Var *)notes[i].volume);
+    }
+}
@@ -9,7 +9,7 @@ SliceI64 *make_line_tokencodes(SliceI64 *srctcs, int64_t start) {
         }
     }
 
-    SliceI64 *slice = new_slice_i64_from_slice(srctcs, start, end);
+    SliceI64 *slice = arena_slice_i64_from_slice(compile_arena, srctcs, start, end);
     if (IS_NULL(slice)) {
         oto_error(OTO_INTERNAL_ERROR);
     }
@@ -40,7 +40,7 @@ SliceI64 *make_args_enclosed_br(SliceI64 *srctcs, int64_t sqbropn) {
         end++;
     }
 
-    SliceI64 *slice = new_slice_i64_from_slice(srctcs, start, end);
+    SliceI64 *slice = arena_slice_i64_from_slice(compile_arena, srctcs, start, end);
     if (IS_NULL(slice)) {
         oto_error(OTO_INTERNAL_ERROR);
     }
@@ -56,8 +56,8 @@ SliceI64 *make_begin_end_block(SliceI64 *srctcs, int64_t begin) {
     for (;;) {
         tokencode_t tc = srctcs->data[end];
 
-        /* ifの個数とifブロックのendの個数は一致する */
-        if (tc == TC_BEGIN || tc == TC_IF) {
+        /* if, funcの個数とそのブロックのendの個数は一致する */
+        if (tc == TC_BEGIN || tc == TC_IF || tc == TC_FUNC) {
             nest++;
         } else if  (tc == TC_END) {
             nest--;
@@ -72,7 +72,7 @@ SliceI64 *make_begin_end_block(SliceI64 *srctcs, int64_t begin) {
         end++;
     }
 
-    SliceI64 *slice = new_slice_i64_from_slice(srctcs, start, end);
+    SliceI64 *slice = arena_slice_i64_from_slice(compile_arena, srctcs, start, end);
     if (IS_NULL(slice)) {
         oto_error(OTO_INTERNAL_ERROR);
     }
@@ -88,12 +88,12 @@ SliceI64 *make_ifthen_block(SliceI64 *srctcs, int64_t then) {
     for (;;) {
         tokencode_t tc = srctcs->data[end];
 
-        // ブロック内のif-end, begin-endを飛ばす
-        if (tc == TC_IF || tc == TC_BEGIN) {
+        // ブロック内のif-end, begin-end, func-endを飛ばす
+        if (tc == TC_IF || tc == TC_BEGIN || tc == TC_FUNC) {
             int64_t nest = 0;
             for (;;) {
                 tc = srctcs->data[end];
-                if (tc == TC_IF || tc == TC_BEGIN) {
+                if (tc == TC_IF || tc == TC_BEGIN || tc == TC_FUNC) {
                     nest++;
                 } else if (tc == TC_END) {
                     nest--;
@@ -115,7 +115,7 @@ SliceI64 *make_ifthen_block(SliceI64 *srctcs, int64_t then) {
         end++;
     }
 
-    SliceI64 *slice = new_slice_i64_from_slice(srctcs, start, end);
+    SliceI64 *slice = arena_slice_i64_from_slice(compile_arena, srctcs, start, end);
     if (IS_NULL(slice)) {
         oto_error(OTO_INTERNAL_ERROR);
     }
@@ -145,10 +145,12 @@ void compile_args(int64_t *icp, SliceI64 *argtcs, int64_t max_params) {
 
         } else {
             // 引数一つのコンパイル
-            SliceI64 *slice = new_slice_i64_from_slice(argtcs, start, end);
+            SliceI64 *slice = arena_slice_i64_from_slice(compile_arena, argtcs, start, end);
+            if (IS_NULL(slice)) {
+                oto_error(OTO_INTERNAL_ERROR);
+            }
             compile_expr(icp, slice, vars);
             idx += slice->length;
-            free_slice_i64(slice);          
         }
 
         params++;
@@ -170,7 +172,8 @@ void print_slice_srcs(SliceI64 *srctcs) {
     printf("\n[slice]\n");
 
     for (int64_t i = 0; i < srctcs->length; i++) {
-        printf("%I64d : %s\n", i, VAR(slice_i64_get(srctcs, i))->token->str);
+        Token *token = VAR(slice_i64_get(srctcs, i))->token;
+        printf("%I64d : %.*s\n", i, (int)token->len, token->str);
     }
     printf("\n");
 }
@@ -178,175 +181,11 @@ void print_slice_srcs(SliceI64 *srctcs) {
 void error_compiler(errorcode_t err, SliceI64 *srctcs, int64_t idx) {
     print_error(err, oto_status);
 
-    int64_t srcidx = tc2srcidx(srctcs, srctcs->abs_idx + idx);
-    // printf("srcidx : %I64d\n", srcidx);
-
-    int64_t line = get_current_line(src, srcidx);
-    printf("line %I64d : ", line);
-    print_line(src, line);
-
-    int64_t l = 1;
-    int64_t i = 0;
-    while (l != line) {
-        if (src[i] == '\n') {
-            l++;
-        } else if (src[i] == '\0') {
-            break;
-        }
-        i++;
-    }
-
-    // "line OOO : "の分だけ空白をあける
-    printf("        ");
-    int j = 0;
-    while (j <= (line / 10)) {
-        printf(" ");
-        j++;
+    // 字句解析のときに記録した位置を引く
+    const SrcPos *pos = get_src_pos(srctcs->abs_idx + idx);
+    if (IS_NOT_NULL(pos)) {
+        print_src_pos(pos);
     }
 
-    while (i < idx) {
-        printf(" ");
-        i++;
-    }
-    fprintf(stderr, "\x1b[31m");
-    fprintf(stderr, "^~~");
-    fprintf(stderr, "\x1b[39m");
-    printf("\n");
-
     oto_error_throw(err);
 }
-
-static bool is_number(char c) {
-    if ('0' <= c && c <= '9') return true;
-    return false;
-}
-
-static bool is_varname(char c) {
-    if ('0' <= c && c <= '9') return true;
-    if ('a' <= c && c <= 'z') return true;
-    if ('A' <= c && c <= 'Z') return true;
-    if (c == '_') return true;
-    if (c == '#') return true;
-    return false;
-}
-
-static bool is_symbol_char(char c) {
-    if (strchr("=+-*/%<>!:~|'$`^", c) != 0) return true;
-    return false;
-}
-
-static size_t count_constant_len(char *s) {
-    size_t len = 0;
-    bool is_float = false;
-
-    while (1) {
-        if (is_number(s[len])) {
-            len++;
-        } else if (s[len] == '.' && !is_float) {
-            is_float = true;
-            len++;
-        } else {
-            break;
-        }
-    }
-
-    return len;
-}
-
-static size_t count_varname_len(char *s) {
-    size_t len = 0;
-    while (is_varname(s[len])) {
-        len++;
-    }
-
-    return len;
-}
-
-static size_t count_operator_len(char *s) {
-    size_t len = 0;
-    while (is_symbol_char(s[len]) && s[len] != '\0') {
-        len++;
-    }
-
-    return len;
-}
-
-#define IS_IGNORE_CHAR(c)   (c == ' ' || c == '\t' || c == '\r')
-
-int64_t tc2srcidx(SliceI64 *srctcs, int64_t tcidx) {
-    int64_t tci = 0;
-    int64_t i = 0;
-    // printf("tcidx : %I64d\n", tcidx);
-    while (src[i] != 0) {
-        if (tci == tcidx) {
-            return i;
-        }
-
-        if (IS_IGNORE_CHAR(src[i])) {
-            i++;
-            continue;
-        
-        } else if (src[i] == '/' && src[i + 1] == '*') {
-            int64_t nest = 0;
-            for (;;) {
-                if (src[i] == '/' && src[i + 1] == '*') {
-                    nest++;
-                } else if (src[i] == '*' && src[i + 1] == '/') {
-                    nest--;
-                    if (nest == 0) break;
-
-                } else if (src[i] == 0) {
-                    return 0;
-                }
-                i++;
-            }
-            i += 2;
-            continue;
-
-        } else if (src[i] == -29 && src[i + 1] == -128 && src[i + 2] == -128) {
-            // UTF-8の全角スペース
-            i += 3;
-            continue;
-
-        } else if (src[i] == -127 && src[i + 1] == 64) {
-            // Shift-JISの全角スペース
-            i += 2;
-            continue;
-
-        }
-
-        size_t len = 0;
-        if (src[i] == '@') {
-            while (src[i] != '\n' && src[i] != '\0') i++;
-            continue;
-        
-        } else if (src[i] == '\\') {
-            do {
-                i++;
-            } while (src[i] == ' ' || src[i] == '\n');
-            continue;
-        
-        } else if (src[i] == ';') {
-            // 改行と読み替える
-            src[i] = '\n';
-            len  = 1;
-        
-        } else if (strchr("()[]:,\n", src[i]) != 0) {
-            len  = 1;
-
-        } else if (is_symbol_char(src[i])) {
-            len = count_operator_len(&src[i]);
-
-        } else if (is_number(src[i])) {
-            len  = count_constant_len(&src[i]);
-        
-        } else if (is_varname(src[i])) {
-            len  = count_varname_len(&src[i]);
-
-        }
-
-        tci += 1;
-        i += len;
-    }
-    return 0;
-}
\ No newline at end of file
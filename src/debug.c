@@ -32,7 +32,7 @@ void print_var(VectorPTR *var_list) {
         if (i == TC_LF) {
             printf("str : %15s, ", "\\n");
         } else {
-            printf("str : %15s, ", var->token->str);
+            printf("str : %15.*s, ", (int)var->token->len, var->token->str);
         }
 
         printf("strlen : %I64d, ",  var->token->len);
@@ -79,21 +79,43 @@ static struct operation {
     {"JNZ",          OP_JNZ          },
     {"OSCILDEF",     OP_OSCILDEF     },
     {"SOUNDDEF",     OP_SOUNDDEF     },
+    {"SAMPLEDEF",    OP_SAMPLEDEF    },
     {"ARRAYDEF",     OP_ARRAYDEF     },
     {"CPYS",         OP_CPYS         },
     {"CONNFILTER",   OP_CONNFILTER   },
     {"PRINT",        OP_PRINT        },
     {"BEEP",         OP_BEEP         },
     {"PLAY",         OP_PLAY         },
+    {"PLAYMIDI",     OP_PLAYMIDI     },
+    {"PLAYMML",      OP_PLAYMML      },
+    {"MMLNOTE",      OP_MMLNOTE      },
     {"PRINTWAV",     OP_PRINTWAV     },
+    {"PRINTSPEC",    OP_PRINTSPEC    },
     {"PRINTVAR",     OP_PRINTVAR     },
     {"SLEEP",        OP_SLEEP        },
     {"SETSYNTH",     OP_SETSYNTH     },
     {"SETLOOP",      OP_SETLOOP      },
     {"STOP",         OP_STOP         },
+    {"CALL",         OP_CALL         },
+    {"PARAM",        OP_PARAM        },
+    {"RET",          OP_RET          },
     {"EXIT",         OP_EXIT         }
 };
 
+const char *opcode_name(opcode_t op) {
+    if (op < 0 || op > OP_EXIT) {
+        return "?";
+    }
+    return operations[op].str;
+}
+
+/* doubleのビット列をそのまま入れたオペランドを取り出す */
+static double operand_double(Var *operand) {
+    union value_u v = {0};
+    v.p = (void *)operand;
+    return v.f;
+}
+
 void print_ic_list(VectorPTR *ic_list) {
     printf("- Internal code -\n");
 
@@ -116,26 +138,49 @@ void print_ic_list(VectorPTR *ic_list) {
 
         if (op == OP_LOOP) {
             printf("%10I64d ", (int64_t)v1);
-            printf("%10s\n", v2->token->str);
+            printf("%10.*s ", (int)v2->token->len, v2->token->str);
+            printf("%10I64d\n", (int64_t)v3);
             continue;
 
-        } else if (op == OP_JMP || op == OP_JZ || op == OP_JNZ) {
+        } else if (op == OP_JMP || op == OP_JZ || op == OP_JNZ || op == OP_RET) {
             printf("%10I64d\n", (int64_t)v1);
             continue;
-        
+
+        } else if (op == OP_CALL) {
+            printf("%10I64d ", (int64_t)v1);
+            printf("%10I64d\n", (int64_t)v2);
+            continue;
+
+        } else if (op == OP_PLAYMML) {
+            if (IS_NULL(v1)) {
+                printf("%10s ", "-");
+            } else {
+                printf("%10.*s ", (int)v1->token->len, v1->token->str);
+            }
+            printf("%10I64d ", (int64_t)v2);
+            printf("%10.3f\n", operand_double(v3));
+            continue;
+
+        } else if (op == OP_MMLNOTE) {
+            printf("%10.3f ", operand_double(v1));
+            printf("%10.3f ", operand_double(v2));
+            printf("%10.2f ", operand_double(v3));
+            printf("%10I64d\n", (int64_t)v4);
+            continue;
+
         } 
 
         if (IS_NULL(v1)) {
             printf("\n");
             continue;
         }
-        printf("%10s ", v1->token->str);
+        printf("%10.*s ", (int)v1->token->len, v1->token->str);
 
         if (op == OP_CONNFILTER) {
             printf("%10s\n", def_filters[(int64_t)v2].s);
             continue;
         
-        } else if (op == OP_ARRAYDEF) {
+        } else if (op == OP_ARRAYDEF || op == OP_PARAM) {
             printf("%10I64d\n", (int64_t)v2);
             continue;
         }
@@ -144,19 +189,19 @@ void print_ic_list(VectorPTR *ic_list) {
             printf("\n");
             continue;
         }
-        printf("%10s ", v2->token->str);
+        printf("%10.*s ", (int)v2->token->len, v2->token->str);
 
         if (IS_NULL(v3)) {
             printf("\n");
             continue;
         }
-        printf("%10s ", v3->token->str);
+        printf("%10.*s ", (int)v3->token->len, v3->token->str);
 
         if (IS_NULL(v4)) {
             printf("\n");
             continue;
         }
-        printf("%10s ", v4->token->str);
+        printf("%10.*s ", (int)v4->token->len, v4->token->str);
         
         printf("\n");
     }
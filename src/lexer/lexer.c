@@ -113,7 +113,19 @@ static size_t count_operator_len(char *s) {
 #define IS_IGNORE_CHAR(c)   (c == ' ' || c == '\t' || c == '\r')
 #define IS_PREPROCESS(c)    (c == '@')
 
+/* posをsrc[idx]まで進める. 前回の位置からの改行だけを数える */
+static void seek_pos(SrcPos *pos, char *src, int64_t idx) {
+    for (int64_t j = (int64_t)pos->offset; j < idx; j++) {
+        if (src[j] == '\n') {
+            pos->line++;
+        }
+    }
+    pos->offset = idx;
+}
+
 void tokenize(char *src, VectorI64 *src_tokens, VectorPTR *var_list, Status *status) {
+    SrcPos pos = {add_src_file(NULL, src), 1, 0};
+
     int64_t i = 0;
     while (src[i] != 0) {
         if (IS_IGNORE_CHAR(src[i])) {
@@ -152,7 +164,15 @@ void tokenize(char *src, VectorI64 *src_tokens, VectorPTR *var_list, Status *sta
 
         size_t len = 0;
         tokentype_t type = -1;
-        if (IS_PREPROCESS(src[i])) {
+        if (IS_PREPROCESS(src[i]) && strncmp_cs("import", &src[i + 1], 6) == 0) {
+            // @import "song.mid" はPLAYMIDI "song.mid"と同じ. 後ろはそのまま字句解析する
+            seek_pos(&pos, src, i);
+            set_src_pos(src_tokens->length, pos);
+            vector_i64_append(src_tokens, TC_PLAYMIDI);
+            i += 7;
+            continue;
+
+        } else if (IS_PREPROCESS(src[i])) {
             if (status->repl_flag == true) {
                 error_lexer(OTO_REPL_ERROR, src, 0, status);
             } else {
@@ -168,14 +188,16 @@ void tokenize(char *src, VectorI64 *src_tokens, VectorPTR *var_list, Status *sta
             // 1行に書かなければいけない処理を複数行書けるようにする
             do {
                 i++;
-            } while (src[i] == ' ' || src[i] == '\n');
+            } while (src[i] == ' ' || src[i] == '\r' || src[i] == '\n');
             continue;
         
         } else if (src[i] == ';') {
-            // 改行と読み替える
-            src[i] = '\n';
-            len  = 1;
-            type = TK_TY_SYMBOL;
+            // 改行と読み替える (ソースはマップしたままで書き換えない)
+            seek_pos(&pos, src, i);
+            set_src_pos(src_tokens->length, pos);
+            vector_i64_append(src_tokens, TC_LF);
+            i++;
+            continue;
         
         } else if (strchr("()[]:,\n", src[i]) != 0) {
             len  = 1;
@@ -211,6 +233,8 @@ void tokenize(char *src, VectorI64 *src_tokens, VectorPTR *var_list, Status *sta
             error_lexer(OTO_SYNTAX_ERROR, src, i, status);
         }
 
+        seek_pos(&pos, src, i);
+        set_src_pos(src_tokens->length, pos);
         vector_i64_append(
             src_tokens,
             allocate_tc(&src[i], len, type, var_list)
@@ -221,6 +245,15 @@ void tokenize(char *src, VectorI64 *src_tokens, VectorPTR *var_list, Status *sta
     return;
 }
 
+/* ソースの終わりに置く改行. 位置は直前のトークンと同じにする */
+static void append_end_lf(VectorI64 *src_tokens) {
+    const SrcPos *last = get_src_pos(src_tokens->length - 1);
+    if (IS_NOT_NULL(last)) {
+        set_src_pos(src_tokens->length, *last);
+    }
+    vector_i64_append(src_tokens, TC_LF);
+}
+
 VectorI64 *lexer(char *src, VectorPTR *var_list, Status *status) {
     VectorI64 *src_tokens = new_vector_i64(DEFAULT_MAX_TC);
     if (IS_NULL(src_tokens)) {
@@ -228,17 +261,19 @@ VectorI64 *lexer(char *src, VectorPTR *var_list, Status *status) {
     }
 
     if (IS_NOT_NULL(status->include_srcpath)) {
-        char *include_src = src_open(status->include_srcpath);
+        char *include_src = open_src_view(status->include_srcpath, status);
         if (IS_NULL(include_src)) {
             print_error(OTO_INCLUDE_FILE_NOT_FOUND_ERROR, status);
+            printf("filename : %s\n", status->include_srcpath);
+            oto_error_throw(OTO_INCLUDE_FILE_NOT_FOUND_ERROR);
         }
+        add_src_file(status->include_srcpath, include_src);
         tokenize(include_src, src_tokens, var_list, status);
-        vector_i64_append(src_tokens, TC_LF);
-        free(include_src);
+        append_end_lf(src_tokens);
     }
 
     tokenize(src, src_tokens, var_list, status);
-    vector_i64_append(src_tokens, TC_LF);
+    append_end_lf(src_tokens);
 
     return src_tokens;
 }
@@ -8,15 +8,196 @@
  * もし既に参照されていた場合はエラーとする
  */
 static void check_circular_ref(char *path, Status *status) {
-    if (map_exist_key(status->srcfile_table, path)) {
-        if (map_geti(status->srcfile_table, path) >= 1) {
-            // 循環参照
-            oto_error(OTO_CIRCULAR_REFERENCE_ERROR);
-        } else {
-            map_inc_val(status->srcfile_table, path);
+    void **count = map_get_or_insert(status->srcfile_table, path, strlen(path), NULL);
+    if (IS_NULL(count)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+
+    if ((int64_t)*count >= 1) {
+        // 循環参照
+        oto_error(OTO_CIRCULAR_REFERENCE_ERROR);
+    }
+    *count = (void *)((int64_t)*count + 1);
+}
+
+/**
+ * インクルードしたファイルのトークン列のキャッシュ
+ *
+ * パス, 更新時刻, サイズが前回と同じなら字句解析をせずにトークン列をそのまま繋げる.
+ * 中でさらにインクルードしたファイルはdepsに入れておき, どれかが変わっていたら作り直す.
+ */
+typedef struct include_unit {
+    char *path;             // include_cacheのキー
+    char *src;              // 最後に読んだソース
+    FileStamp stamp;
+    bool ready;             // 最後まで字句解析できたらtrue
+
+    // 変数のトークンは(TC_EXIT + 1 + namesの添字)にしておく
+    VectorI64 *tokens;
+    SrcPos *positions;      // tokensと同じ添字のトークンの位置
+    VectorPTR *names;       // 変数のトークンの文字列 (Token *)
+    VectorPTR *deps;        // 中でインクルードしたファイル (struct include_unit *)
+
+    // namesをvar_listで引いたときのトークンコード
+    tokencode_t *resolved;
+    VectorPTR *var_list;
+    int64_t var_end;        // 引いたときのvar_list->length
+    Var *last_var;          // 引いたときのvar_listの最後の変数
+} IncludeUnit;
+
+static Map *include_cache = NULL;
+static IncludeUnit *building_unit = NULL;  // 今字句解析しているファイル
+
+static void clear_include_unit(IncludeUnit *unit) {
+    for (int64_t i = 0; i < unit->names->length; i++) {
+        Token *name = (Token *)unit->names->data[i];
+        free(name->str);
+        free(name);
+    }
+    unit->tokens->length = 0;
+    unit->names->length  = 0;
+    unit->deps->length   = 0;
+
+    free(unit->positions);
+    unit->positions = NULL;
+    free(unit->resolved);
+    unit->resolved = NULL;
+    unit->var_list = NULL;
+    unit->ready    = false;
+}
+
+static IncludeUnit *get_include_unit(char *path) {
+    if (IS_NULL(include_cache)) {
+        include_cache = new_map();
+        if (IS_NULL(include_cache)) {
+            oto_error(OTO_INTERNAL_ERROR);
+        }
+    }
+
+    bool found = false;
+    void **slot = map_get_or_insert(include_cache, path, strlen(path), &found);
+    if (IS_NULL(slot)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+    if (found) {
+        return (IncludeUnit *)*slot;
+    }
+
+    IncludeUnit *unit = MYMALLOC1(IncludeUnit);
+    if (IS_NULL(unit)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+    unit->path   = (char *)map_intern(include_cache, path, strlen(path));
+    unit->tokens = new_vector_i64(DEFAULT_MAX_TC);
+    unit->names  = new_vector_ptr(DEFAULT_MAX_TC);
+    unit->deps   = new_vector_ptr(DEFAULT_MAX_TC);
+    if (IS_NULL(unit->tokens) || IS_NULL(unit->names) || IS_NULL(unit->deps)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+    *slot = (void *)unit;
+
+    return unit;
+}
+
+static bool is_fresh_unit(IncludeUnit *unit) {
+    if (!unit->ready) {
+        return false;
+    }
+
+    FileStamp stamp;
+    if (!get_file_stamp(unit->path, &stamp)
+        || stamp.mtime != unit->stamp.mtime || stamp.size != unit->stamp.size) {
+        return false;
+    }
+
+    for (int64_t i = 0; i < unit->deps->length; i++) {
+        if (!is_fresh_unit((IncludeUnit *)unit->deps->data[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* キャッシュを使うときも, 中でインクルードしたファイルまで循環参照を調べる */
+static void check_circular_ref_unit(IncludeUnit *unit, Status *status) {
+    check_circular_ref(unit->path, status);
+    for (int64_t i = 0; i < unit->deps->length; i++) {
+        check_circular_ref_unit((IncludeUnit *)unit->deps->data[i], status);
+    }
+    map_dec_val(status->srcfile_table, unit->path);
+}
+
+/* src_tokensのbegin以降に追加されたトークンをunitに移す */
+static void store_include_unit(IncludeUnit *unit, VectorI64 *src_tokens, int64_t begin, VectorPTR *var_list) {
+    // トークンコード -> namesの添字 + 1
+    int64_t *name_idx = MYMALLOC(var_list->length, int64_t);
+    unit->positions = MYMALLOC(src_tokens->length - begin + 1, SrcPos);
+    if (IS_NULL(name_idx) || IS_NULL(unit->positions)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+
+    for (int64_t i = begin; i < src_tokens->length; i++) {
+        const SrcPos *pos = get_src_pos(i);
+        if (IS_NOT_NULL(pos)) {
+            unit->positions[i - begin] = *pos;
         }
-    } else {
-        map_puti(status->srcfile_table, path, 1);
+
+        tokencode_t tc = src_tokens->data[i];
+        if (IS_AVAILABLE_VAR(tc)) {
+            if (name_idx[tc] == 0) {
+                Token *token = ((Var *)var_list->data[tc])->token;
+                Token *name = MYMALLOC1(Token);
+                char *str = MYMALLOC(token->len + 1, char);
+                if (IS_NULL(name) || IS_NULL(str)) {
+                    oto_error(OTO_INTERNAL_ERROR);
+                }
+                memcpy(str, token->str, token->len);
+                *name = *token;
+                name->str = str;
+
+                vector_ptr_append(unit->names, name);
+                name_idx[tc] = unit->names->length;
+            }
+            tc = TC_EXIT + name_idx[tc];
+        }
+        vector_i64_append(unit->tokens, tc);
+    }
+    free(name_idx);
+}
+
+/* namesをvar_listで引き直す. var_listが前回と同じなら何もしない */
+static void resolve_include_unit(IncludeUnit *unit, VectorPTR *var_list) {
+    if (unit->var_list == var_list && var_list->length >= unit->var_end
+        && (unit->var_end == 0 || var_list->data[unit->var_end - 1] == unit->last_var)) {
+        return;
+    }
+
+    free(unit->resolved);
+    unit->resolved = MYMALLOC(unit->names->length + 1, tokencode_t);
+    if (IS_NULL(unit->resolved)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+
+    for (int64_t i = 0; i < unit->names->length; i++) {
+        Token *name = (Token *)unit->names->data[i];
+        unit->resolved[i] = allocate_tc(name->str, name->len, name->type, var_list);
+    }
+
+    unit->var_list = var_list;
+    unit->var_end  = var_list->length;
+    unit->last_var = var_list->length > 0 ? (Var *)var_list->data[var_list->length - 1] : NULL;
+}
+
+static void splice_include_unit(IncludeUnit *unit, VectorI64 *src_tokens, VectorPTR *var_list) {
+    resolve_include_unit(unit, var_list);
+
+    for (int64_t i = 0; i < unit->tokens->length; i++) {
+        tokencode_t tc = unit->tokens->data[i];
+        if (IS_AVAILABLE_VAR(tc)) {
+            tc = unit->resolved[tc - TC_EXIT - 1];
+        }
+        set_src_pos(src_tokens->length, unit->positions[i]);
+        vector_i64_append(src_tokens, tc);
     }
 }
 
@@ -37,22 +218,125 @@ static void include_file(char *src, int64_t idx, VectorI64 *src_tokens, VectorPT
     if (IS_NULL(path)) {
         oto_error(OTO_PREPROCESS_ERROR);
     }
-    check_circular_ref(path, status);
 
-    char *new_src = src_open(path);
+    IncludeUnit *unit = get_include_unit(path);
+    free(path);
+
+    // 字句解析中のファイルから参照されていることを覚えておく
+    IncludeUnit *parent = building_unit;
+    if (IS_NOT_NULL(parent) && !parent->ready) {
+        vector_ptr_append(parent->deps, unit);
+    }
+
+    if (is_fresh_unit(unit)) {
+        check_circular_ref_unit(unit, status);
+        splice_include_unit(unit, src_tokens, var_list);
+        return;
+    }
+
+    check_circular_ref(unit->path, status);
+    clear_include_unit(unit);
+
+    FileStamp stamp = {0};
+    get_file_stamp(unit->path, &stamp);
+
+    // 変数名はマップしたソースの中を指すので, ソースは終了するまで残しておく
+    // (--watch中はヒープにコピーしたものなので, 読み直したら前のものを捨てる)
+    char *new_src = open_src_view(unit->path, status);
     if (IS_NULL(new_src)) {
         print_error(OTO_INCLUDE_FILE_NOT_FOUND_ERROR, status);
-        printf("filename : %s\n", path);
+        printf("filename : %s\n", unit->path);
         oto_error_throw(OTO_INCLUDE_FILE_NOT_FOUND_ERROR);
     }
+    replace_src_file(unit->src, new_src);
+    add_src_file(unit->path, new_src);
+    close_src_view(unit->src);
+    unit->src = new_src;
 
+    int64_t begin = src_tokens->length;
+    building_unit = unit;
     tokenize(new_src, src_tokens, var_list, status);
+    building_unit = parent;
+
+    store_include_unit(unit, src_tokens, begin, var_list);
+    resolve_include_unit(unit, var_list);
+    unit->stamp = stamp;
+    unit->ready = true;
 
     // ファイル参照回数を1減らす
-    map_dec_val(status->srcfile_table, path);
+    map_dec_val(status->srcfile_table, unit->path);
+}
 
-    free(new_src);
-    free(path);
+/* キャッシュしたファイルのどれかが変わっていたらtrue (--watch用) */
+bool is_include_cache_changed() {
+    if (IS_NULL(include_cache)) {
+        return false;
+    }
+
+    int64_t iter = 0;
+    MapEntry *entry = NULL;
+    while (IS_NOT_NULL(entry = map_next(include_cache, &iter))) {
+        IncludeUnit *unit = (IncludeUnit *)entry->val;
+        if (unit->ready && !is_fresh_unit(unit)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* キャッシュしたファイルの今の更新時刻とサイズをまとめたハッシュ (--watch用) */
+uint64_t include_cache_signature() {
+    uint64_t hash = FNV1A_OFFSET_BASIS;
+    if (IS_NULL(include_cache)) {
+        return hash;
+    }
+
+    int64_t iter = 0;
+    MapEntry *entry = NULL;
+    while (IS_NOT_NULL(entry = map_next(include_cache, &iter))) {
+        FileStamp stamp = {0};
+        get_file_stamp(((IncludeUnit *)entry->val)->path, &stamp);
+        hash = hash_fnv1a(&stamp, sizeof(stamp), hash);
+    }
+    return hash;
+}
+
+/**
+ * 字句解析を最初からやり直せるようにする
+ *
+ * エラーで途中から抜けるとファイル参照回数が戻らないので, ルート以外を0にする.
+ */
+void reset_include_state(Status *status) {
+    building_unit = NULL;
+
+    int64_t iter = 0;
+    MapEntry *entry = NULL;
+    while (IS_NOT_NULL(entry = map_next(status->srcfile_table, &iter))) {
+        entry->val = (void *)0;
+    }
+    if (IS_NOT_NULL(status->root_srcpath)) {
+        map_puti(status->srcfile_table, status->root_srcpath, 1);
+    }
+}
+
+void free_include_cache() {
+    if (IS_NULL(include_cache)) {
+        return;
+    }
+
+    int64_t iter = 0;
+    MapEntry *entry = NULL;
+    while (IS_NOT_NULL(entry = map_next(include_cache, &iter))) {
+        IncludeUnit *unit = (IncludeUnit *)entry->val;
+        clear_include_unit(unit);
+        free_vector_i64(unit->tokens);
+        free_vector_ptr(unit->names);
+        free_vector_ptr(unit->deps);
+        free(unit);
+    }
+    free_map(include_cache);
+    include_cache = NULL;
+    building_unit = NULL;
 }
 
 void preprocess(char *src, int64_t idx, VectorI64 *src_tokens, VectorPTR *var_list, Status *status) {
@@ -0,0 +1,145 @@
+#include <oto/oto.h>
+
+/**
+ * トークンの位置の表
+ *
+ * 字句解析のときにsrc_tokensと同じ添字で(ファイル, バイト位置, 行)を記録しておき,
+ * エラー表示やプロファイラではトークンの添字から直接引く.
+ * ソースを先頭から数え直さないので, インクルードしたファイルの中でも正しい位置を指す.
+ */
+
+#define DEFAULT_SRC_POS_CAPACITY 1024
+
+typedef struct {
+    const char *path;   // REPLなどファイルでないときはNULL
+    char *src;
+} SrcFile;
+
+static VectorPTR *src_files = NULL;
+static SrcPos *src_pos = NULL;
+static int64_t src_pos_capacity = 0;
+
+/* 同じsrcなら同じ番号を返す. pathがNULLでなければ上書きする */
+uint32_t add_src_file(const char *path, char *src) {
+    if (IS_NULL(src_files)) {
+        src_files = new_vector_ptr(DEFAULT_MAX_TC);
+        if (IS_NULL(src_files)) {
+            oto_error(OTO_INTERNAL_ERROR);
+        }
+    }
+
+    for (int64_t i = src_files->length - 1; i >= 0; i--) {
+        SrcFile *file = (SrcFile *)src_files->data[i];
+        if (file->src == src) {
+            if (IS_NOT_NULL(path)) {
+                file->path = path;
+            }
+            return (uint32_t)i;
+        }
+    }
+
+    SrcFile *file = MYMALLOC1(SrcFile);
+    if (IS_NULL(file)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+    file->path = path;
+    file->src  = src;
+    vector_ptr_append(src_files, file);
+
+    return (uint32_t)(src_files->length - 1);
+}
+
+/* 読み直したソースを前のソースと同じ番号にする. 前のソースはこの後で捨ててよい */
+void replace_src_file(char *old_src, char *new_src) {
+    if (IS_NULL(src_files) || IS_NULL(old_src)) {
+        return;
+    }
+
+    for (int64_t i = 0; i < src_files->length; i++) {
+        SrcFile *file = (SrcFile *)src_files->data[i];
+        if (file->src == old_src) {
+            file->src = new_src;
+        }
+    }
+}
+
+void set_src_pos(int64_t tcidx, SrcPos pos) {
+    if (tcidx >= src_pos_capacity) {
+        int64_t capacity = src_pos_capacity == 0 ? DEFAULT_SRC_POS_CAPACITY : src_pos_capacity;
+        while (capacity <= tcidx) {
+            capacity *= 2;
+        }
+
+        SrcPos *p = (SrcPos *)realloc(src_pos, capacity * sizeof(SrcPos));
+        if (IS_NULL(p)) {
+            oto_error(OTO_INTERNAL_ERROR);
+        }
+        memset(&p[src_pos_capacity], 0, (capacity - src_pos_capacity) * sizeof(SrcPos));
+        src_pos = p;
+        src_pos_capacity = capacity;
+    }
+    src_pos[tcidx] = pos;
+}
+
+/* 記録されていなければNULL */
+const SrcPos *get_src_pos(int64_t tcidx) {
+    if (tcidx < 0 || tcidx >= src_pos_capacity || src_pos[tcidx].line == 0) {
+        return NULL;
+    }
+    return &src_pos[tcidx];
+}
+
+/* posの行の先頭 */
+static char *get_line_head(const SrcPos *pos) {
+    char *src = ((SrcFile *)src_files->data[pos->file])->src;
+    char *p = &src[pos->offset];
+    while (p > src && p[-1] != '\n') {
+        p--;
+    }
+    return p;
+}
+
+/* posの行を改行の手前まで出力する */
+void print_src_line(const SrcPos *pos) {
+    char *head = get_line_head(pos);
+    size_t len = 0;
+    while (head[len] != '\n' && head[len] != '\r' && head[len] != '\0') {
+        len++;
+    }
+    printf("%.*s\n", (int)len, head);
+}
+
+/* エラー表示用. ファイル名, 行, トークンの下に印を出す */
+void print_src_pos(const SrcPos *pos) {
+    SrcFile *file = (SrcFile *)src_files->data[pos->file];
+    char *root = get_oto_status()->root_srcpath;
+    if (IS_NOT_NULL(file->path) && (IS_NULL(root) || strcmp(file->path, root) != 0)) {
+        printf("filename : %s\n", file->path);
+    }
+
+    int indent = printf("line %I64d : ", (int64_t)pos->line);
+    print_src_line(pos);
+
+    printf("%*s", indent, "");
+    char *head = get_line_head(pos);
+    for (char *p = head; p < &file->src[pos->offset]; p++) {
+        // タブはそのまま出して位置を合わせる
+        putchar(*p == '\t' ? '\t' : ' ');
+    }
+    fprintf(stderr, "\x1b[31m");
+    fprintf(stderr, "^~~");
+    fprintf(stderr, "\x1b[39m");
+    printf("\n");
+}
+
+void free_src_pos() {
+    free(src_pos);
+    src_pos = NULL;
+    src_pos_capacity = 0;
+
+    if (IS_NOT_NULL(src_files)) {
+        free_items_vector_ptr(src_files);
+        free_vector_ptr(src_files);
+        src_files = NULL;
+    }
+}
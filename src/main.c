@@ -1,26 +1,86 @@
 #include <oto/oto.h>
 
 void usage(const char *name) {
-    fprintf(stderr, "Example : %s XXX.oto\n", name);
+    fprintf(stderr, "Example : %s [-T] [--jit] [--profile] [--watch] [--spectrogram OUT.ppm] XXX.oto\n", name);
+    fprintf(stderr, "          %s [--spectrogram OUT.ppm] --midi XXX.mid\n", name);
+    fprintf(stderr, "  -T            : print compile and run time\n");
+    fprintf(stderr, "  --jit         : compile hot LOOPs to native code\n");
+    fprintf(stderr, "  --profile     : print time spent per instruction and source line\n");
+    fprintf(stderr, "  --watch       : rerun XXX.oto whenever it or its includes change\n");
+    fprintf(stderr, "  --spectrogram : render without playing and write a spectrogram to OUT.ppm\n");
+    fprintf(stderr, "  --midi        : play a Standard MIDI File (format 0/1) with sine waves\n");
     return;
 }
 
-int main(int argc, char **argv) {    
-    uint32_t i = 1;
+int main(int argc, char **argv) {
+    int i = 1;
+    bool timecount_flag = false;
+    bool jit_flag = false;
+    bool profile_flag = false;
+    bool watch_flag = false;
+    char *spectrogram_path = NULL;
+    char *midi_path = NULL;
 
     if (argc > 1 && strcmp(argv[1], "--help") == 0) {
         usage(argv[0]);
         return 0;
     }
 
-    // ファイル名が指定されていない場合
-    if (argc != i + 1) {
+    // ファイル名より前にあるオプションを読む
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-T") == 0) {
+            timecount_flag = true;
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            jit_flag = true;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            profile_flag = true;
+        } else if (strcmp(argv[i], "--watch") == 0) {
+            watch_flag = true;
+        } else if (strcmp(argv[i], "--spectrogram") == 0 && i + 1 < argc) {
+            spectrogram_path = argv[++i];
+        } else if (strcmp(argv[i], "--midi") == 0 && i + 1 < argc) {
+            midi_path = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    char *srcpath = NULL;
+    if (i < argc) {
+        srcpath = argv[i];
+    }
+
+    // 音を鳴らすかどうかはoto_initで決まるので先に設定する
+    if (IS_NOT_NULL(spectrogram_path)) {
+        get_oto_status()->spectrogram_path = spectrogram_path;
+    }
+
+    if (IS_NOT_NULL(midi_path)) {
         oto_init(NULL);
-        oto_run(NULL);
-    } else {
-        oto_init(argv[i]);
-        oto_run(argv[i]);
+        oto_run_midi(midi_path);
+        return 0;
     }
 
+    // ファイル名が指定されていない場合はREPL
+    oto_init(srcpath);
+
+    // コマンドラインの指定を.otoconfより優先する
+    Status *status = get_oto_status();
+    if (timecount_flag) {
+        status->timecount_flag = true;
+    }
+    if (jit_flag) {
+        status->jit_flag = true;
+    }
+    if (profile_flag) {
+        status->profile_flag = true;
+    }
+    if (watch_flag) {
+        status->watch_flag = true;
+    }
+
+    oto_run();
+
     return 0;
 }
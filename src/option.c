@@ -2,21 +2,22 @@
 
 static void push_conf_table(Map *conf_table, char *param, size_t paramlen,
                             char *value, size_t valuelen) {    
-    char *key = MYMALLOC(paramlen + 1, char);
-    if (IS_NULL(key)) {
-        // error
-        return;
-    }
     char *val = MYMALLOC(valuelen + 1, char);
     if (IS_NULL(val)) {
         // error
         return;
     }
-
-    strncpy(key, param, paramlen);
     strncpy(val, value, valuelen);
-    
-    map_put(conf_table, key, val);
+
+    // キーはconf_tableの中にコピーされる
+    void **slot = map_get_or_insert(conf_table, param, paramlen, NULL);
+    if (IS_NULL(slot)) {
+        // error
+        free(val);
+        return;
+    }
+    free(*slot);
+    *slot = val;
 }
 
 static Map *parse_otoconf(char *conf) {
@@ -60,9 +61,9 @@ static Map *parse_otoconf(char *conf) {
 }
 
 static void load_config(Status *status, Map *conf_table) {
-    char *option;
-    if (map_exist_key(conf_table, "timecount")) {
-        option = map_get(conf_table, "timecount");
+    char *option = map_get(conf_table, "timecount");
+
+    if (IS_NOT_NULL(option)) {
         if (strcmp(option, "true") == 0) {
             status->timecount_flag = true;
         } else if (strcmp(option, "false") == 0) {
@@ -70,8 +71,8 @@ static void load_config(Status *status, Map *conf_table) {
         }
     }
 
-    if (map_exist_key(conf_table, "repl")) {
-        option = map_get(conf_table, "repl");
+    option = map_get(conf_table, "repl");
+    if (IS_NOT_NULL(option)) {
         if (strcmp(option, "true") == 0) {
             status->repl_flag = true;
         } else if (strcmp(option, "false") == 0) {
@@ -79,8 +80,8 @@ static void load_config(Status *status, Map *conf_table) {
         }
     }
 
-    if (map_exist_key(conf_table, "language")) {
-        option = map_get(conf_table, "language");
+    option = map_get(conf_table, "language");
+    if (IS_NOT_NULL(option)) {
         if (strcmp(option, "kanji") == 0) {
             status->language = LANG_JPN_KANJI;
         } else if (strcmp(option, "hiragana") == 0) {
@@ -90,28 +91,53 @@ static void load_config(Status *status, Map *conf_table) {
         }
     }
 
-    if (map_exist_key(conf_table, "sampling_rate")) {
-        option = map_get(conf_table, "sampling_rate");
+    option = map_get(conf_table, "sampling_rate");
+    if (IS_NOT_NULL(option)) {
         status->sampling_rate = strtol(option, NULL, 0);
     }
 
-    if (map_exist_key(conf_table, "default_srcpath")) {
-        status->root_srcpath = map_get(conf_table, "default_srcpath");
-        map_puti(status->srcfile_table, status->root_srcpath, 1);
+    option = map_get(conf_table, "output_rate");
+    if (IS_NOT_NULL(option)) {
+        status->output_rate = strtol(option, NULL, 0);
+    }
+
+    option = map_get(conf_table, "default_srcpath");
+    if (IS_NOT_NULL(option)) {
+        status->root_srcpath = option;
+        map_puti(status->srcfile_table, option, 1);
     }
 
-    if (map_exist_key(conf_table, "include")) {
-        status->include_srcpath = map_get(conf_table, "include");
-        map_puti(status->srcfile_table, status->include_srcpath, 1);
+    option = map_get(conf_table, "include");
+    if (IS_NOT_NULL(option)) {
+        status->include_srcpath = option;
+        map_puti(status->srcfile_table, option, 1);
     }
 
-    if (map_exist_key(conf_table, "fade_range")) {
-        option = map_get(conf_table, "fade_range");
+    option = map_get(conf_table, "fade_range");
+    if (IS_NOT_NULL(option)) {
         status->fade_range = strtod(option, NULL);
     }
 
-    if (map_exist_key(conf_table, "safety")) {
-        option = map_get(conf_table, "safety");
+    option = map_get(conf_table, "cache");
+    if (IS_NOT_NULL(option)) {
+        if (strcmp(option, "true") == 0) {
+            status->cache_flag = true;
+        } else if (strcmp(option, "false") == 0) {
+            status->cache_flag = false;
+        }
+    }
+
+    option = map_get(conf_table, "jit");
+    if (IS_NOT_NULL(option)) {
+        if (strcmp(option, "true") == 0) {
+            status->jit_flag = true;
+        } else if (strcmp(option, "false") == 0) {
+            status->jit_flag = false;
+        }
+    }
+
+    option = map_get(conf_table, "safety");
+    if (IS_NOT_NULL(option)) {
         if (strcmp(option, "true") == 0) {
             status->safety_flag = true;
         } else if (strcmp(option, "false") == 0) {
@@ -122,28 +148,24 @@ static void load_config(Status *status, Map *conf_table) {
 
 const char otoconf_path[] = ".otoconf";
 void init_option(Status *status, char *srcpath) {
-    char *conf = src_open(otoconf_path);
-    if (IS_NULL(conf)) {
-        return;
-    }
-
-    Map *conf_table = parse_otoconf(conf);
-    if (conf_table == NULL) {
-        return;
-    }
-
     status->srcfile_table = new_map();
-    if (conf_table == NULL) {
+    if (IS_NULL(status->srcfile_table)) {
         return;
     }
 
-    load_config(status, conf_table);
+    char *conf = src_open(otoconf_path);
+    if (IS_NOT_NULL(conf)) {
+        Map *conf_table = parse_otoconf(conf);
+        if (IS_NOT_NULL(conf_table)) {
+            load_config(status, conf_table);
+            free_map(conf_table);
+        }
+        free(conf);
+    }
 
     if (IS_NOT_NULL(srcpath)) {
         status->root_srcpath = srcpath;
         map_puti(status->srcfile_table, srcpath, 1);
     }
-
-    free(conf_table);
-    free(conf);
 }
+
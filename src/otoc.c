@@ -0,0 +1,365 @@
+#include <oto/oto.h>
+
+/**
+ * コンパイル済み内部コードのキャッシュ(.otoc)
+ *
+ * ソースと同じ場所に"<ソース名>c"として書き出し,
+ * 次回の実行ではマップするだけで字句解析とコンパイルを飛ばす.
+ * キーにはソースとインクルードファイルの内容のハッシュを使う.
+ *
+ * 形式:
+ *   OtocHeader
+ *   OtocVar[var_num]      ... 初期化後に追加された変数
+ *   uint64_t[ic_num]      ... 内部コード(変数はtc + 1, NULLは0)
+ *   char[str_size]        ... トークン文字列('\0'終端)
+ */
+
+#define OTOC_MAGIC "OTOC"
+#define OTOC_FORMAT 1
+
+/* 命令コードなどが増えたら自動的に古いキャッシュを無効にする */
+#define OTOC_VERSION \
+    ((OTOC_FORMAT << 24) | (TC_EXIT << 16) | (OP_EXIT << 8) | FILTER_NUM)
+
+#define OTOC_MAX_INCLUDE_DEPTH 16
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint64_t base_vars;
+    uint64_t var_num;
+    uint64_t ic_num;
+    uint64_t str_size;
+} OtocHeader;
+
+typedef struct {
+    uint64_t str_offset;
+    uint64_t len;
+    int64_t token_type;
+    int64_t var_type;
+    int64_t value;
+} OtocVar;
+
+/* トークンの文字列が指しているので終了時まで解放しない */
+static void *otoc_map = NULL;
+
+/* 第n引数(1~4)が変数へのポインタならtrue */
+static bool is_var_operand(opcode_t op, int64_t n) {
+    switch (op) {
+    case OP_LOOP:
+        return n == 2;
+    case OP_JMP:
+    case OP_JZ:
+    case OP_JNZ:
+    case OP_CALL:
+    case OP_RET:
+    case OP_MMLNOTE:
+        return false;
+    case OP_CONNFILTER:
+    case OP_ARRAYDEF:
+    case OP_PARAM:
+    case OP_PLAYMML:
+        return n == 1;
+    default:
+        return true;
+    }
+}
+
+/* 命令の位置(5の倍数)で, 内部コードの中か終わりならtrue */
+static bool is_valid_target(uint64_t target, uint64_t ic_num) {
+    return target % 5 == 0 && target <= ic_num;
+}
+
+/**
+ * 壊れたキャッシュで範囲外を読まないように, 変数の番号とジャンプ先などを確かめる
+ * var_endは読み込んだ後の変数表の長さ
+ */
+static bool is_valid_ics(const uint64_t *ics, uint64_t ic_num, uint64_t var_end) {
+    if (ic_num % 5 != 0) {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < ic_num; i += 5) {
+        opcode_t op = (opcode_t)ics[i];
+        if (ics[i] > OP_EXIT) {
+            return false;
+        }
+
+        for (int64_t n = 1; n <= 4; n++) {
+            if (is_var_operand(op, n) && ics[i + n] > var_end) {
+                return false;
+            }
+        }
+
+        switch (op) {
+        case OP_JMP:
+        case OP_JZ:
+        case OP_JNZ:
+        case OP_CALL:
+            if (!is_valid_target(ics[i + 1], ic_num)) {
+                return false;
+            }
+            break;
+        case OP_LOOP:
+            // ループカウンタの番号はLOOP命令の数より小さい
+            if (!is_valid_target(ics[i + 1], ic_num) || ics[i + 3] >= ic_num / 5) {
+                return false;
+            }
+            break;
+        default:
+            break;
+        }
+
+        if ((op == OP_CALL && ics[i + 2] > FUNC_MAX_PARAMS)
+            || (op == OP_PARAM && ics[i + 2] >= FUNC_MAX_PARAMS)
+            || (op == OP_RET && ics[i + 1] > FUNC_MAX_PARAMS)) {
+            return false;
+        }
+
+        // 後ろに続くMMLNOTEの数
+        if (op == OP_PLAYMML && ics[i + 2] >= (ic_num - i) / 5) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static char *otoc_path(char *srcpath) {
+    size_t len = strlen(srcpath);
+    char *path = MYMALLOC(len + 2, char);
+    if (IS_NULL(path)) {
+        return NULL;
+    }
+    strcpy(path, srcpath);
+    path[len] = 'c';
+
+    return path;
+}
+
+static uint64_t hash_file(const char *path, uint64_t hash, int64_t depth);
+
+/* ソース中の@includeを辿ってハッシュに含める */
+static uint64_t hash_src(char *src, uint64_t hash, int64_t depth) {
+    hash = hash_fnv1a(src, strlen(src), hash);
+    if (depth >= OTOC_MAX_INCLUDE_DEPTH) {
+        return hash;
+    }
+
+    char *p = src;
+    while ((p = strchr(p, '@')) != NULL) {
+        p++;
+        if (strncmp_cs("include", p, 7) != 0) {
+            continue;
+        }
+        p += 7;
+        while (*p == ' ') {
+            p++;
+        }
+
+        char *path = new_string_literal(p, 0);
+        if (IS_NOT_NULL(path)) {
+            hash = hash_file(path, hash, depth + 1);
+            free(path);
+        }
+    }
+
+    return hash;
+}
+
+static uint64_t hash_file(const char *path, uint64_t hash, int64_t depth) {
+    hash = hash_fnv1a(path, strlen(path), hash);
+
+    size_t size = 0;
+    char *src = src_map(path, &size);
+    if (IS_NULL(src)) {
+        return hash;
+    }
+    hash = hash_src(src, hash, depth);
+    src_unmap(src, size);
+
+    return hash;
+}
+
+uint64_t otoc_key(char *src, Status *status) {
+    uint64_t hash = FNV1A_OFFSET_BASIS;
+    if (IS_NOT_NULL(status->include_srcpath)) {
+        hash = hash_file(status->include_srcpath, hash, 0);
+    }
+    return hash_src(src, hash, 0);
+}
+
+VectorPTR *load_otoc(char *srcpath, uint64_t key, VectorPTR *var_list) {
+    char *path = otoc_path(srcpath);
+    if (IS_NULL(path)) {
+        return NULL;
+    }
+
+    size_t size = 0;
+    char *map = mmap_file(path, &size);
+    free(path);
+    if (IS_NULL(map)) {
+        return NULL;
+    }
+
+    OtocHeader *header = (OtocHeader *)map;
+    if (size < sizeof(OtocHeader)
+        || strncmp(header->magic, OTOC_MAGIC, 4) != 0
+        || header->version != OTOC_VERSION
+        || header->key != key
+        || header->base_vars != var_list->length
+        // 掛け算があふれないように, それぞれの数がファイルに収まるかを先に見る
+        || header->var_num > size / sizeof(OtocVar)
+        || header->ic_num > size / sizeof(uint64_t)
+        || header->str_size > size
+        || size != sizeof(OtocHeader) + header->var_num * sizeof(OtocVar)
+                   + header->ic_num * sizeof(uint64_t) + header->str_size) {
+        munmap_file(map);
+        return NULL;
+    }
+
+    OtocVar *vars = (OtocVar *)(map + sizeof(OtocHeader));
+    uint64_t *ics = (uint64_t *)(vars + header->var_num);
+    char *strs = (char *)(ics + header->ic_num);
+
+    // 変数表を書き換える前に確かめて, 壊れていればコンパイルし直してもらう
+    bool valid = is_valid_ics(ics, header->ic_num, header->base_vars + header->var_num);
+    for (uint64_t i = 0; valid && i < header->var_num; i++) {
+        if (vars[i].str_offset >= header->str_size
+            || vars[i].len >= header->str_size - vars[i].str_offset) {
+            valid = false;
+        }
+    }
+    if (!valid) {
+        munmap_file(map);
+        return NULL;
+    }
+
+    VectorPTR *ic_list = new_vector_ptr(header->ic_num + 1);
+    if (IS_NULL(ic_list)) {
+        munmap_file(map);
+        return NULL;
+    }
+
+    for (uint64_t i = 0; i < header->var_num; i++) {
+        Token *token = MYMALLOC1(Token);
+        if (IS_NULL(token)) {
+            oto_error(OTO_INTERNAL_ERROR);
+        }
+        token->tc   = var_list->length;
+        token->str  = &strs[vars[i].str_offset];
+        token->len  = vars[i].len;
+        token->type = vars[i].token_type;
+        add_new_variable(var_list, token);
+
+        // DEFINEされた値などコンパイル時に決まったものを戻す
+        Var *var = (Var *)var_list->data[token->tc];
+        if (vars[i].var_type == TY_CONST || vars[i].var_type == TY_FLOAT) {
+            var->value.i = vars[i].value;
+        }
+        var->type = vars[i].var_type;
+    }
+
+    for (uint64_t i = 0; i < header->ic_num; i += 5) {
+        opcode_t op = (opcode_t)ics[i];
+        vector_ptr_append(ic_list, (void *)op);
+
+        for (int64_t n = 1; n <= 4; n++) {
+            uint64_t operand = ics[i + n];
+            if (is_var_operand(op, n) && operand != 0) {
+                vector_ptr_append(ic_list, var_list->data[operand - 1]);
+            } else {
+                vector_ptr_append(ic_list, (void *)operand);
+            }
+        }
+    }
+
+    otoc_map = map;
+    return ic_list;
+}
+
+/* キャッシュに書き出せない変数が含まれていればfalse */
+static bool is_cacheable(VectorPTR *var_list, int64_t base_vars) {
+    for (int64_t i = base_vars; i < var_list->length; i++) {
+        vartype_t type = ((Var *)var_list->data[i])->type;
+        if (type != TY_VOID && type != TY_CONST && type != TY_FLOAT
+            && type != TY_STRING) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void save_otoc(char *srcpath, uint64_t key, int64_t base_vars,
+               VectorPTR *ic_list, VectorPTR *var_list) {
+    if (!is_cacheable(var_list, base_vars)) {
+        return;
+    }
+
+    char *path = otoc_path(srcpath);
+    if (IS_NULL(path)) {
+        return;
+    }
+
+    FILE *fp = fopen(path, "wb");
+    free(path);
+    if (IS_NULL(fp)) {
+        return;
+    }
+
+    OtocHeader header;
+    memcpy(header.magic, OTOC_MAGIC, 4);
+    header.version   = OTOC_VERSION;
+    header.key       = key;
+    header.base_vars = base_vars;
+    header.var_num   = var_list->length - base_vars;
+    header.ic_num    = ic_list->length;
+    header.str_size  = 0;
+    for (int64_t i = base_vars; i < var_list->length; i++) {
+        header.str_size += ((Var *)var_list->data[i])->token->len + 1;
+    }
+    fwrite(&header, sizeof(OtocHeader), 1, fp);
+
+    uint64_t str_offset = 0;
+    for (int64_t i = base_vars; i < var_list->length; i++) {
+        Var *var = (Var *)var_list->data[i];
+        OtocVar ov;
+        ov.str_offset = str_offset;
+        ov.len        = var->token->len;
+        ov.token_type = var->token->type;
+        ov.var_type   = var->type;
+        ov.value      = var->value.i;
+        fwrite(&ov, sizeof(OtocVar), 1, fp);
+
+        str_offset += var->token->len + 1;
+    }
+
+    for (int64_t i = 0; i < ic_list->length; i += 5) {
+        opcode_t op = (opcode_t)ic_list->data[i];
+        uint64_t ic = (uint64_t)op;
+        fwrite(&ic, sizeof(uint64_t), 1, fp);
+
+        for (int64_t n = 1; n <= 4; n++) {
+            void *operand = ic_list->data[i + n];
+            if (is_var_operand(op, n) && IS_NOT_NULL(operand)) {
+                ic = ((Var *)operand)->token->tc + 1;
+            } else {
+                ic = (uint64_t)operand;
+            }
+            fwrite(&ic, sizeof(uint64_t), 1, fp);
+        }
+    }
+
+    for (int64_t i = base_vars; i < var_list->length; i++) {
+        Token *token = ((Var *)var_list->data[i])->token;
+        fwrite(token->str, sizeof(char), token->len, fp);
+        fputc('\0', fp);
+    }
+
+    fclose(fp);
+}
+
+void close_otoc() {
+    munmap_file(otoc_map);
+    otoc_map = NULL;
+}
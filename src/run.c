@@ -9,6 +9,7 @@ static VectorPTR *var_list   = NULL;
 static char *src = NULL;
 static VectorI64 *src_tokens = NULL;
 static VectorPTR *ic_list    = NULL;
+static Frame *frame          = NULL;
 
 void oto_init(char *srcpath) {
     oto_status = get_oto_status();
@@ -21,8 +22,12 @@ void oto_init(char *srcpath) {
     printf("timecount : %d\n", oto_status->timecount_flag);
     printf("repl : %d\n", oto_status->repl_flag);
     printf("sampling_rate : %I64d\n", oto_status->sampling_rate);
+    printf("output_rate : %I64d\n", oto_status->output_rate);
     printf("fade_range : %f\n", oto_status->fade_range);
     printf("safety : %d\n", oto_status->safety_flag);
+    printf("cache : %d\n", oto_status->cache_flag);
+    printf("jit : %d\n", oto_status->jit_flag);
+    printf("profile : %d\n", oto_status->profile_flag);
 #endif
     init_sound_stream(oto_status);
 
@@ -33,6 +38,10 @@ void oto_init(char *srcpath) {
     }
     init_var_list(var_list);
     init_filter(var_list);
+    frame = new_frame();
+    if (IS_NULL(frame)) {
+        exit(EXIT_FAILURE);
+    }
     
     // メモリ解放とPortAudio終了処理用のハンドラを登録する
     if (atexit(oto_exit) != 0) {
@@ -45,7 +54,13 @@ void oto_exit() {
     free_vector_i64(src_tokens);
     free_vector_ptr(ic_list);
     free_vector_ptr(var_list);
-    free(src);
+    free_frame(frame);
+    free_samples();
+    free_region();
+    free_include_cache();
+    free_src_pos();
+    free_src_views();
+    close_otoc();
 
 #ifdef DEBUG
     printf("success\n");
@@ -61,19 +76,100 @@ void oto_error(errorcode_t err) {
     oto_error_throw(err);
 }
 
+static void print_watch_reload() {
+    if (oto_status->language == LANG_JPN_KANJI) {
+        printf("[watch] %s を実行します (終了するときはCtrl+C)\n", oto_status->root_srcpath);
+    } else if (oto_status->language == LANG_JPN_HIRAGANA) {
+        printf("[watch] %s をうごかします (おわるときはCtrl+C)\n", oto_status->root_srcpath);
+    } else if (oto_status->language == LANG_ENG) {
+        printf("[watch] Running %s (press Ctrl+C to quit)\n", oto_status->root_srcpath);
+    }
+}
+
+/* ソースを読み直してコンパイルする. 変数表とインクルードキャッシュは前回のものを使う */
+static VectorPTR *watch_compile(int64_t base_vars) {
+    char *new_src = open_src_view(oto_status->root_srcpath, oto_status);
+    if (IS_NULL(new_src)) {
+        print_error(OTO_FILE_NOT_FOUND_ERROR, oto_status);
+        printf("filename : %s\n", oto_status->root_srcpath);
+        oto_error_throw(OTO_FILE_NOT_FOUND_ERROR);
+    }
+    // 位置の表では前のソースと同じ番号にする
+    replace_src_file(src, new_src);
+    add_src_file(oto_status->root_srcpath, new_src);
+
+    reset_var_values(var_list, base_vars);
+    free_samples();
+    reset_region();
+    reset_include_state(oto_status);
+
+    // 変数名はビューの外に移してあるので, 前のソースはもう指されていない
+    close_src_view(src);
+    src = new_src;
+
+    free_vector_i64(src_tokens);
+    src_tokens = NULL;
+    src_tokens = lexer(src, var_list, oto_status);
+
+    return compile(src_tokens, var_list, src, oto_status);
+}
+
+/**
+ * --watch: ソースかインクルードしたファイルが変わるたびに最初から実行し直す
+ *
+ * PortAudioのストリームは開いたまま, 新しい内部コードをコンパイルできたときだけ入れ替える.
+ * 実行中に変わったときはexec()がLOOPかPLAYの手前で抜けてくる.
+ */
+static void watch_run() {
+    int64_t base_vars = var_list->length;
+
+    for (;;) {
+        update_watch(oto_status->root_srcpath);
+
+        if (setjmp(env) == 0) {
+            VectorPTR *new_ic_list = watch_compile(base_vars);
+            free_vector_ptr(ic_list);
+            ic_list = new_ic_list;
+
+            print_watch_reload();
+            exec(ic_list, var_list, oto_status, frame);
+        } else {
+            // エラーで抜けてきたときはフレームに実行中の領域が残っている
+            release_frame(frame);
+        }
+
+        wait_watch_changed();
+    }
+}
+
+/* --midi: スクリプトを使わずにMIDIファイルだけを鳴らす */
+void oto_run_midi(char *path) {
+    if (setjmp(env) == 0) {
+        play_midi_file(oto_status, path, NULL, 0);
+    }
+}
+
 void oto_run() {
     if (oto_status->repl_flag && oto_status->root_srcpath == NULL) {
         repl();
         return;
     }
+
+    if (oto_status->watch_flag) {
+        oto_status->repl_flag = false;
+        watch_run();
+        return;
+    }
     
-    src = src_open(oto_status->root_srcpath);
+    src = open_src_view(oto_status->root_srcpath, oto_status);
     if (IS_NULL(src)) {
         print_error(OTO_FILE_NOT_FOUND_ERROR, oto_status);
         printf("filename : %s\n", oto_status->root_srcpath);
         repl();
         return;
     }
+    // srcはfree_src_views()で解放する
+    add_src_file(oto_status->root_srcpath, src);
     oto_status->repl_flag = false;
 
     if (setjmp(env) == 0) {
@@ -88,13 +184,31 @@ void oto_run() {
             start_time = clock();
         }
 
-        src_tokens = lexer(src, var_list, oto_status);
+        // キャッシュがあれば字句解析とコンパイルを飛ばす
+        // (プロファイルでは行番号が必要なので必ずコンパイルする)
+        uint64_t key = 0;
+        if (oto_status->cache_flag) {
+            key = otoc_key(src, oto_status);
+        }
+        if (oto_status->cache_flag && !oto_status->profile_flag) {
+            ic_list = load_otoc(oto_status->root_srcpath, key, var_list);
+        }
+
+        if (IS_NULL(ic_list)) {
+            int64_t base_vars = var_list->length;
+
+            src_tokens = lexer(src, var_list, oto_status);
 #ifdef DEBUG
-        print_src_tokens(src_tokens);
-        print_var(var_list);
+            print_src_tokens(src_tokens);
+            print_var(var_list);
 #endif
 
-        ic_list = compile(src_tokens, var_list, src, oto_status);
+            ic_list = compile(src_tokens, var_list, src, oto_status);
+
+            if (oto_status->cache_flag) {
+                save_otoc(oto_status->root_srcpath, key, base_vars, ic_list, var_list);
+            }
+        }
 #ifdef DEBUG
         print_ic_list(ic_list);
 #endif
@@ -110,7 +224,7 @@ void oto_run() {
             }
 
             start_time = clock();
-            exec(ic_list, var_list, oto_status);
+            exec(ic_list, var_list, oto_status, frame);
             end_time = clock();
 
             if (oto_status->language == LANG_JPN_KANJI) {
@@ -122,7 +236,11 @@ void oto_run() {
             }
 
         } else {
-            exec(ic_list, var_list, oto_status);
+            exec(ic_list, var_list, oto_status, frame);
+        }
+
+        if (oto_status->profile_flag) {
+            print_profile(ic_list, oto_status);
         }
 
     } else {
@@ -132,38 +250,64 @@ void oto_run() {
 }
 
 
+/* 変数と実行時に作った音のオブジェクトを全部捨てて, 起動したときの状態に戻す */
+static void reset_repl() {
+    free_var_list(var_list);
+    free_samples();
+    reset_region();
+
+    var_list = new_vector_ptr(DEFAULT_MAX_TC);
+    if (IS_NULL(var_list)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+    init_var_list(var_list);
+    init_filter(var_list);
+}
+
 void print_repl_help() {
     printf("\n");
 
     if (oto_status->language == LANG_JPN_KANJI) {
         printf("- 操作方法 -\n");
         printf("終了するときは, 「EXIT」と打つか, Ctrl+Cを押してください\n");
+        printf("変数を全部消すときは, 「RESET」と打ってください\n");
         printf("- 命令一覧 -\n");
         printf("PLAY  <周波数[Hz]>, <音の長さ[s]>, <音の大きさ[0-100]>, <音の種類>\n");
+        printf("PLAYMIDI \"<MIDIファイル>\", <1番目のトラックの音の種類>, ...\n");
+        printf("MML   \"<MML (例: t120 o4 cdefedc)>\", <音の種類>\n");
         printf("BEEP  <周波数[Hz]>, <音の長さ[s]>\n");
         printf("PRINT <出力したいもの>\n");
         printf("PRINTVAR\n");
         printf("PRINTWAV  <周波数[Hz]>, <音の長さ[s]>, <音の大きさ[0-100]>, <音の種類>\n");
+        printf("PRINTSPEC <周波数[Hz]>, <音の長さ[s]>, <音の大きさ[0-100]>, <音の種類>\n");
         printf("SLEEP <長さ[秒]>\n");
     } else if (oto_status->language == LANG_JPN_HIRAGANA) {
         printf("- そうさほうほう -\n");
         printf("おわるときは, 「EXIT」とうつか, CtrlキーとCキーをどうじにおしてね\n");
+        printf("へんすうをぜんぶけすときは, 「RESET」とうってね\n");
         printf("- コマンドいちらん -\n");
         printf("PLAY  <おとのたかさ>, <おとのながさ[びょう]>, <おとのおおきさ[0-100]>, <おとのしゅるい>\n");
+        printf("PLAYMIDI \"<MIDIファイル>\", <1ばんめのトラックのおとのしゅるい>, ...\n");
+        printf("MML   \"<がくふ (れい: t120 o4 cdefedc)>\", <おとのしゅるい>\n");
         printf("BEEP  <おとのたかさ>, <おとのながさ[びょう]>\n");
         printf("PRINT <がめんにひょうじしたいもの>\n");
         printf("PRINTVAR\n");
         printf("PRINTWAV  <おとのたかさ>, <おとのながさ[びょう]>, <おとのおおきさ[0-100]>, <おとのしゅるい>\n");
+        printf("PRINTSPEC <おとのたかさ>, <おとのながさ[びょう]>, <おとのおおきさ[0-100]>, <おとのしゅるい>\n");
         printf("SLEEP <ながさ[びょう]>\n");
     } else if (oto_status->language == LANG_ENG) {
         printf("- Usage -\n");
         printf("If you want to exit, type \"EXIT\" or press Ctrl+C.\n");
+        printf("If you want to clear all variables, type \"RESET\".\n");
         printf("- List of instructions -\n");
         printf("PLAY  <frequency[Hz]>, <length[s]>, <volume[0-100]>, <Sound>\n");
+        printf("PLAYMIDI \"<MIDI file>\", <Sound for track 1>, ...\n");
+        printf("MML   \"<MML (e.g. t120 o4 cdefedc)>\", <Sound>\n");
         printf("BEEP  <frequency[Hz]>, <length[s]>\n");
         printf("PRINT <variable or literal>\n");
         printf("PRINTVAR\n");
         printf("PRINTWAV  <frequency[Hz]>, <length[s]>, <volume[0-100]>, <Sound>\n");
+        printf("PRINTSPEC <frequency[Hz]>, <length[s]>, <volume[0-100]>, <Sound>\n");
         printf("SLEEP <length[s]>\n");
     }
 
@@ -196,6 +340,16 @@ void print_repl_exit() {
     }
 }
 
+void print_repl_reset() {
+    if (oto_status->language == LANG_JPN_KANJI) {
+        printf("変数を全部消しました\n");
+    } else if (oto_status->language == LANG_JPN_HIRAGANA) {
+        printf("へんすうをぜんぶけしました\n");
+    } else if (oto_status->language == LANG_ENG) {
+        printf("All variables have been cleared.\n");
+    }
+}
+
 #define REPL_STR_BUFSIZE 10000
 void repl() {
     oto_status->repl_flag = true;
@@ -226,13 +380,20 @@ void repl() {
                 break;
             } else if (strncmp_cs(str, "HELP", 4) == 0) {
                 print_repl_help();
+            } else if (strncmp_cs(str, "RESET", 5) == 0) {
+                reset_repl();
+                print_repl_reset();
+                free_vector_i64(src_tokens);
+                continue;
             }
 
             src_tokens = lexer(str, var_list, oto_status);
 
             ic_list = compile(src_tokens, var_list, str, oto_status);
             
-            exec(ic_list, var_list, oto_status);
+            exec(ic_list, var_list, oto_status, frame);
+        } else {
+            release_frame(frame);
         }
 
         free_vector_i64(src_tokens);
@@ -0,0 +1,108 @@
+#include <oto/oto.h>
+#include <oto/oto_sound.h>
+
+/**
+ * DELAY, CHORUS, FLANGER用の遅延線
+ *
+ * 長さを2の冪にした循環バッファに書き込み, 書き込み位置から遅延分だけ
+ * 戻った位置を隣の2点の線形補間で読む. 位置は & mask で折り返すので剰余はいらない.
+ * バッファはフィルタを接続したときに確保し, 演奏中には確保しない.
+ *
+ * 遅延時間とLFOはDELAY_BLOCK_SIZEサンプルのブロックごとに計算し,
+ * ブロックの間は遅延を直線で動かす. sin()をサンプルごとに呼ばずに済み,
+ * 遅延時間を変えたときのノイズも出ない.
+ */
+
+void init_delay_line(DelayLine *line, int64_t max_delay) {
+    // 補間で1つ先も読むので2つ余分に取る
+    int64_t size = 1;
+    while (size < max_delay + 2) {
+        size <<= 1;
+    }
+
+    line->buf  = REGION_ALLOC(REGION_FILTER, size, float);
+    line->mask = size - 1;
+    line->pos  = 0;
+}
+
+void reset_delay_line(DelayLine *line) {
+    memset(line->buf, 0, (line->mask + 1) * sizeof(float));
+    line->pos = 0;
+}
+
+/* delayサンプル前の値. delayは1以上, 長さ - 2以下 */
+float delay_line_read(const DelayLine *line, double delay) {
+    double rp = line->pos - delay;
+    int64_t i = (int64_t)floor(rp);
+    float frac = (float)(rp - i);
+
+    float a = line->buf[i & line->mask];
+    float b = line->buf[(i + 1) & line->mask];
+    return a + (b - a) * frac;
+}
+
+void delay_line_write(DelayLine *line, float d) {
+    line->buf[line->pos] = d;
+    line->pos = (line->pos + 1) & line->mask;
+}
+
+DelayEffect *new_delay_effect(double max_time, int64_t sampling_rate) {
+    DelayEffect *de = REGION_ALLOC(REGION_FILTER, 1, DelayEffect);
+    de->sampling_rate = sampling_rate;
+    init_delay_line(&de->line, (int64_t)ceil(max_time * sampling_rate) + DELAY_BLOCK_SIZE);
+
+    reset_delay_effect(de);
+    return de;
+}
+
+void reset_delay_effect(DelayEffect *de) {
+    reset_delay_line(&de->line);
+    de->delay      = -1;
+    de->delay_step = 0;
+    de->lfo_phase  = 0;
+    de->block_pos  = 0;
+}
+
+static double clamp(double x, double min, double max) {
+    if (x < min) {
+        return min;
+    } else if (x > max) {
+        return max;
+    }
+    return x;
+}
+
+/* 次のブロックの終わりでの遅延を求めて, そこまで直線で動かす */
+static void delay_next_block(DelayEffect *de, double base_time, double sweep_time, double speed) {
+    double target = (base_time + sweep_time * sin(2 * PI * de->lfo_phase)) * de->sampling_rate;
+    target = clamp(target, 1, de->line.mask - 1);
+
+    if (de->delay < 0) {
+        de->delay = target;
+    }
+    de->delay_step = (target - de->delay) / DELAY_BLOCK_SIZE;
+
+    de->lfo_phase += speed * DELAY_BLOCK_SIZE / de->sampling_rate;
+    de->lfo_phase -= floor(de->lfo_phase);
+}
+
+/**
+ * base_time ± sweep_time (speed[Hz]で揺らす) 遅らせた音を混ぜる
+ * 遅らせた音にfeedbackを掛けて遅延線に戻すと繰り返しになる
+ */
+float delay_effect(DelayEffect *de, float d, double base_time, double sweep_time,
+                   double speed, double feedback, double mix) {
+    if (de->block_pos == 0) {
+        delay_next_block(de, base_time, sweep_time, speed);
+    }
+    de->block_pos = (de->block_pos + 1) % DELAY_BLOCK_SIZE;
+
+    feedback = clamp(feedback, -DELAY_MAX_FEEDBACK, DELAY_MAX_FEEDBACK);
+    mix = clamp(mix, 0, 1);
+
+    float wet = delay_line_read(&de->line, de->delay);
+    delay_line_write(&de->line, d + feedback * wet);
+    de->delay += de->delay_step;
+
+    return (1 - mix) * d + mix * wet;
+}
@@ -0,0 +1,198 @@
+#include <oto/oto.h>
+#include <oto/oto_sound.h>
+
+/**
+ * 実数FFT
+ *
+ * n点の実数列を n/2点の複素数列 z[j] = x[2j] + i x[2j+1] に詰めて複素FFTし,
+ * 偶数番目と奇数番目のスペクトルに分けてから合成する.
+ * 複素FFTはビット反転した入力に対して, 2段ずつまとめた基数4の段と
+ * 余った1段の基数2の段で計算する.
+ *
+ * スペクトルは X[0] ... X[n/2] の n/2 + 1個を(実部, 虚部)の順に並べる.
+ */
+
+FFTPlan *new_fft_plan(int64_t n) {
+    if (n < 4 || (n & (n - 1)) != 0) {
+        return NULL;
+    }
+
+    FFTPlan *plan = MYMALLOC1(FFTPlan);
+    if (IS_NULL(plan)) {
+        return NULL;
+    }
+    plan->n    = n;
+    plan->half = n / 2;
+    plan->rev  = MYMALLOC(plan->half, int64_t);
+    plan->cos_tab = MYMALLOC(plan->half, float);
+    plan->sin_tab = MYMALLOC(plan->half, float);
+    if (IS_NULL(plan->rev) || IS_NULL(plan->cos_tab) || IS_NULL(plan->sin_tab)) {
+        free_fft_plan(plan);
+        return NULL;
+    }
+
+    int64_t bits = 0;
+    while (((int64_t)1 << bits) < plan->half) {
+        bits++;
+    }
+    for (int64_t i = 0; i < plan->half; i++) {
+        int64_t r = 0;
+        for (int64_t b = 0; b < bits; b++) {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        plan->rev[i] = r;
+    }
+
+    // exp(-2πik/n)
+    for (int64_t k = 0; k < plan->half; k++) {
+        plan->cos_tab[k] = cos(2 * PI * k / n);
+        plan->sin_tab[k] = -sin(2 * PI * k / n);
+    }
+
+    return plan;
+}
+
+void free_fft_plan(FFTPlan *plan) {
+    if (IS_NULL(plan)) {
+        return;
+    }
+    free(plan->rev);
+    free(plan->cos_tab);
+    free(plan->sin_tab);
+    free(plan);
+}
+
+/* a * b を a に入れる */
+#define CMUL(ar, ai, br, bi) do { \
+    float _r = (ar) * (br) - (ai) * (bi); \
+    (ai) = (ar) * (bi) + (ai) * (br); \
+    (ar) = _r; \
+} while (0)
+
+/* ビット反転済みのhalf点の複素数列をその場でFFTする */
+static void complex_fft(const FFTPlan *plan, float *x) {
+    int64_t half = plan->half;
+    int64_t m = 1;
+
+    // 基数4 (長さ2mと4mの段をまとめる)
+    while (4 * m <= half) {
+        int64_t step1 = plan->n / (2 * m);
+        int64_t step2 = plan->n / (4 * m);
+        for (int64_t g = 0; g < half; g += 4 * m) {
+            for (int64_t j = 0; j < m; j++) {
+                float *x0 = &x[2 * (g + j)];
+                float *x1 = x0 + 2 * m;
+                float *x2 = x0 + 4 * m;
+                float *x3 = x0 + 6 * m;
+                float w1r = plan->cos_tab[j * step1], w1i = plan->sin_tab[j * step1];
+                float w2r = plan->cos_tab[j * step2], w2i = plan->sin_tab[j * step2];
+
+                float tr = x1[0], ti = x1[1];
+                CMUL(tr, ti, w1r, w1i);
+                float a0r = x0[0] + tr, a0i = x0[1] + ti;
+                float a1r = x0[0] - tr, a1i = x0[1] - ti;
+
+                tr = x3[0]; ti = x3[1];
+                CMUL(tr, ti, w1r, w1i);
+                float a2r = x2[0] + tr, a2i = x2[1] + ti;
+                float a3r = x2[0] - tr, a3i = x2[1] - ti;
+
+                tr = a2r; ti = a2i;
+                CMUL(tr, ti, w2r, w2i);
+                x0[0] = a0r + tr; x0[1] = a0i + ti;
+                x2[0] = a0r - tr; x2[1] = a0i - ti;
+
+                // w^(j+m) = -i * w^j
+                tr = a3r; ti = a3i;
+                CMUL(tr, ti, w2i, -w2r);
+                x1[0] = a1r + tr; x1[1] = a1i + ti;
+                x3[0] = a1r - tr; x3[1] = a1i - ti;
+            }
+        }
+        m *= 4;
+    }
+
+    // 基数2 (段数が奇数のときの最後の1段)
+    if (2 * m <= half) {
+        int64_t step = plan->n / (2 * m);
+        for (int64_t j = 0; j < m; j++) {
+            float *x0 = &x[2 * j];
+            float *x1 = x0 + 2 * m;
+            float tr = x1[0], ti = x1[1];
+            CMUL(tr, ti, plan->cos_tab[j * step], plan->sin_tab[j * step]);
+            x1[0] = x0[0] - tr; x1[1] = x0[1] - ti;
+            x0[0] += tr;        x0[1] += ti;
+        }
+    }
+}
+
+/* in(n点) -> out(n/2 + 1個の複素数) */
+void rfft(const FFTPlan *plan, const float *in, float *out) {
+    int64_t half = plan->half;
+
+    for (int64_t j = 0; j < half; j++) {
+        out[2 * plan->rev[j]]     = in[2 * j];
+        out[2 * plan->rev[j] + 1] = in[2 * j + 1];
+    }
+    complex_fft(plan, out);
+
+    // 偶数番目E, 奇数番目Oのスペクトルに分けて X[k] = E[k] + w^k O[k]
+    float z0r = out[0], z0i = out[1];
+    out[0] = z0r + z0i;
+    out[1] = 0;
+    out[2 * half]     = z0r - z0i;
+    out[2 * half + 1] = 0;
+
+    for (int64_t k = 1; k <= half / 2; k++) {
+        float ar = out[2 * k], ai = out[2 * k + 1];
+        float br = out[2 * (half - k)], bi = out[2 * (half - k) + 1];
+
+        float er = 0.5 * (ar + br), ei = 0.5 * (ai - bi);
+        float dr = 0.5 * (ai + bi), di = -0.5 * (ar - br);
+        CMUL(dr, di, plan->cos_tab[k], plan->sin_tab[k]);
+
+        out[2 * k]     = er + dr;
+        out[2 * k + 1] = ei + di;
+        // X[n/2 - k] = conj(E[k] - w^k O[k])
+        out[2 * (half - k)]     = er - dr;
+        out[2 * (half - k) + 1] = -(ei - di);
+    }
+}
+
+/* in(n/2 + 1個の複素数) -> out(n点). inは作業に使うので壊れる */
+void irfft(const FFTPlan *plan, float *in, float *out) {
+    int64_t half = plan->half;
+
+    // Z[k] = E[k] + i O[k] に戻す
+    float x0 = in[0], xh = in[2 * half];
+    in[0] = 0.5 * (x0 + xh);
+    in[1] = 0.5 * (x0 - xh);
+
+    for (int64_t k = 1; k <= half / 2; k++) {
+        float ar = in[2 * k], ai = in[2 * k + 1];
+        float br = in[2 * (half - k)], bi = in[2 * (half - k) + 1];
+
+        float er = 0.5 * (ar + br), ei = 0.5 * (ai - bi);
+        float dr = 0.5 * (ar - br), di = 0.5 * (ai + bi);
+        CMUL(dr, di, plan->cos_tab[k], -plan->sin_tab[k]);
+
+        in[2 * k]     = er - di;
+        in[2 * k + 1] = ei + dr;
+        // Z[n/2 - k] = conj(E[k]) + i conj(O[k])
+        in[2 * (half - k)]     = er + di;
+        in[2 * (half - k) + 1] = -ei + dr;
+    }
+
+    // 共役をとって順方向のFFTで逆変換する
+    for (int64_t j = 0; j < half; j++) {
+        out[2 * plan->rev[j]]     = in[2 * j];
+        out[2 * plan->rev[j] + 1] = -in[2 * j + 1];
+    }
+    complex_fft(plan, out);
+
+    float scale = 1.0 / half;
+    for (int64_t j = 0; j < half; j++) {
+        out[2 * j]     *= scale;
+        out[2 * j + 1] *= -scale;
+    }
+}
@@ -2,19 +2,25 @@
 #include <oto/oto_sound.h>
 
 const struct init_define_filters def_filters[] = {
-    {"CLIP",        4, CLIP,        0},
-    {"FADE_IN",     7, FADE_IN,     1},
-    {"FADE_OUT",    8, FADE_OUT,    1},
-    {"FADE",        4, FADE,        2},
-    {"AMP",         3, AMP,         1},
-    {"TREMOLO",     7, TREMOLO,     2},
-    {"DETUNE",      6, DETUNE,      1},
-    {"CHOP",        4, CHOP,        1},
-    {"LPF",         3, LPF,         1},
-    {"HPF",         3, HPF,         1},
-    {"WAH",         3, WAH,         3},
-    {"RADIO",       5, RADIO,       0},
-    {"VIBRATO",     7, VIBRATO,     2}
+    {"CLIP",        4, CLIP,        0, 4},
+    {"FADE_IN",     7, FADE_IN,     1, 0},
+    {"FADE_OUT",    8, FADE_OUT,    1, 0},
+    {"FADE",        4, FADE,        2, 0},
+    {"AMP",         3, AMP,         1, 0},
+    {"TREMOLO",     7, TREMOLO,     2, 0},
+    {"DETUNE",      6, DETUNE,      1, 0},
+    {"CHOP",        4, CHOP,        1, 0},
+    {"LPF",         3, LPF,         1, 0},
+    {"HPF",         3, HPF,         1, 0},
+    {"WAH",         3, WAH,         3, 0},
+    {"RADIO",       5, RADIO,       0, 0},
+    {"VIBRATO",     7, VIBRATO,     2, 0},
+    {"SOFTCLIP",    8, SOFTCLIP,    1, 2},
+    {"WAVESHAPE",   9, WAVESHAPE,   1, 4},
+    {"REVERB",      6, REVERB,      1, 0},
+    {"DELAY",       5, DELAY,       3, 0},
+    {"CHORUS",      6, CHORUS,      4, 0},
+    {"FLANGER",     7, FLANGER,     4, 0}
 };
 
 Filter *new_filter(filtercode_t fc) {
@@ -22,19 +28,100 @@ Filter *new_filter(filtercode_t fc) {
         return NULL;
     }
     
-    Filter *filter = MYMALLOC1(Filter);
-    if (IS_NULL(filter)) {
-        return NULL;
-    }
+    Filter *filter = REGION_ALLOC(REGION_FILTER, 1, Filter);
 
     filter->num = fc;
     for (int64_t i = 0; i < FILTER_ARG_SIZE; i++) {
         filter->args[i] = NULL;
     }
+    filter->state = NULL;
+    filter->next = NULL;
 
     return filter;
 }
 
+/* 引数が揃った接続時に内部状態を確保する. 演奏中には確保しない */
+void init_filter_state(Filter *filter, int64_t sampling_rate) {
+    switch (filter->num) {
+    case DELAY: {
+        // 後から遅延時間を長くしても, 接続したときの長さまでしか遅らせない
+        double time = filter->args[0]->value.f;
+        if (time > DELAY_MAX_TIME) {
+            time = DELAY_MAX_TIME;
+        } else if (time < 0) {
+            time = 0;
+        }
+        filter->state = new_delay_effect(time, sampling_rate);
+        break;
+    }
+    case CHORUS:
+        filter->state = new_delay_effect(CHORUS_BASE_TIME + CHORUS_SWEEP_TIME, sampling_rate);
+        break;
+    case FLANGER:
+        filter->state = new_delay_effect(FLANGER_BASE_TIME + FLANGER_SWEEP_TIME, sampling_rate);
+        break;
+    case REVERB: {
+        Var *impulse = filter->args[0];
+        if (impulse->type == TY_ARRAY) {
+            Array *array = (Array *)impulse->value.p;
+            filter->state = new_convolver(array->data, array->len);
+            break;
+        }
+
+        // SAMPLE["ir.wav"]ならインパルス応答として合成のサンプリング周波数に変換して使う
+        Oscillator *osc = (Oscillator *)impulse->value.p;
+        if (impulse->type != TY_OSCIL || osc->wave != SAMPLE_WAVE) {
+            oto_error(OTO_ARGUMENTS_TYPE_ERROR);
+        }
+        Sample *sample = osc->sample;
+        double step = (double)sample->rate / sampling_rate;
+        int64_t len = (int64_t)ceil(sample->frames / step);
+        double *ir = MYMALLOC(len + 1, double);
+        if (IS_NULL(ir)) {
+            oto_error(OTO_INTERNAL_ERROR);
+        }
+        // 1サンプルあたりの重みも変わるので, 全体の大きさが同じになるようにstepを掛ける
+        for (int64_t i = 0; i < len; i++) {
+            ir[i] = sample_read(sample, i * step) * step;
+        }
+        filter->state = new_convolver(ir, len);
+        free(ir);
+        break;
+    }
+    default:
+        // 非線形フィルタはエイリアスを抑えるために上げたレートで処理する
+        if (def_filters[filter->num].oversample > 1) {
+            filter->state = new_oversampler(def_filters[filter->num].oversample);
+        }
+        break;
+    }
+}
+
+/* 音を鳴らし始める前にフィルタの内部状態を消す */
+void reset_filters(Sound *sound) {
+    if (IS_NULL(sound)) {
+        return;
+    }
+    for (Filter *filter = sound->filters; IS_NOT_NULL(filter); filter = filter->next) {
+        if (IS_NULL(filter->state)) {
+            continue;
+        }
+        switch (filter->num) {
+        case REVERB:
+            reset_convolver((Convolver *)filter->state);
+            break;
+        case DELAY:
+        case CHORUS:
+        case FLANGER:
+            reset_delay_effect((DelayEffect *)filter->state);
+            break;
+        default:
+            reset_oversampler((Oversampler *)filter->state);
+            break;
+        }
+    }
+}
+
 void init_filter(VectorPTR *var_list) {
     int64_t filters_num = GET_ARRAY_LENGTH(def_filters);
     int64_t i = 0;
@@ -64,6 +151,26 @@ inline static float clip(float d) {
     return d;
 }
 
+static float clip_shape(float d, Filter *filter) {
+    return clip(d);
+}
+
+/* tanhで滑らかに飽和させる */
+static float softclip_shape(float d, Filter *filter) {
+    double drive = filter->args[0]->value.f;
+    return tanh(drive * d);
+}
+
+/* (1 + k)x / (1 + k|x|). kが大きいほど歪む */
+static float waveshape_shape(float d, Filter *filter) {
+    double k = filter->args[0]->value.f;
+    if (k < 0) {
+        k = 0;
+    }
+    d = clip(d);
+    return (1 + k) * d / (1 + k * fabs(d));
+}
+
 inline static float fade_in(float d, Playdata *info, uint64_t t, double fade_time) {
     fade_time = fade_time * info->sampling_rate;
     if (t < fade_time) {
@@ -98,12 +205,16 @@ inline static float tremolo(float d, Playdata *info, uint64_t t, double depth, d
 
 inline static float detune(float d, Playdata *info, uint64_t t, double depth) {
     float data = d;
+    // ずらした声部で本来の声部の位相を進めないように, ビブラートは外して鳴らす
+    Filter *vibrato = info->vibrato;
+    info->vibrato = NULL;
     for (int64_t ch = 0; ch < info->sound_num; ch++) {
         float org = info->freq[ch];
         info->freq[ch] = info->freq[ch] + depth;
         data += ((float)info->volume / 100) * sound_generate(info, t, ch);
         info->freq[ch] = org;
     }
+    info->vibrato = vibrato;
     data /= info->sound_num;
     return data;
 }
@@ -190,26 +301,27 @@ static float radio(float d, Playdata *info, uint64_t t) {
     return lpf(d, info, t, 1000, 10) * 0.8;
 }
 
-static float vibrato(float d, Playdata *info, uint64_t t, double depth, double speed) {
-    return d;
+/* CHORUS, FLANGERの揺れの深さは0 ~ 1 (1で揺れ幅いっぱい) */
+inline static double chorus_depth(double depth) {
+    if (depth < 0) {
+        return 0;
+    } else if (depth > 1) {
+        return 1;
+    }
+    return depth;
 }
 
-float filtering(float data, Playdata *info, uint64_t t) {
+
+/* skip_detuneなら, 1音ずつかけ終わっているDETUNEを飛ばす */
+static float apply_filters(float data, Playdata *info, uint64_t t, bool skip_detune) {
     if (info->sound == NULL) {
         return data;
     }
-    VectorPTR *filters = info->sound->filters;
-
-    uint64_t i = 0;
-    while (i < filters->length) {
-        Filter *filter = ((Filter *)(filters->data[i]));
-        if (filter == NULL) {
-            return data;
-        }
-
+    Filter *filter = info->sound->filters;
+    while (filter != NULL) {
         switch (filter->num) {
         case CLIP:
-            data = clip(data);
+            data = oversample((Oversampler *)filter->state, data, clip_shape, filter);
             break;
         case FADE_IN:
             data = fade_in(data, info, t, 
@@ -239,9 +351,11 @@ float filtering(float data, Playdata *info, uint64_t t) {
             );
             break;
         case DETUNE:
-            data = detune(data, info, t,
-                filter->args[0]->value.f
-            );
+            if (!skip_detune) {
+                data = detune(data, info, t,
+                    filter->args[0]->value.f
+                );
+            }
             break;
         case CHOP:
             data = chop(data, info, t,
@@ -272,9 +386,42 @@ float filtering(float data, Playdata *info, uint64_t t) {
             data = radio(data, info, t);
             break;
         case VIBRATO:
-            data = vibrato(data, info, t,
+            // 発振器の位相増分で処理済み (generator.c)
+            break;
+        case SOFTCLIP:
+            data = oversample((Oversampler *)filter->state, data, softclip_shape, filter);
+            break;
+        case WAVESHAPE:
+            data = oversample((Oversampler *)filter->state, data, waveshape_shape, filter);
+            break;
+        case REVERB:
+            data = convolve((Convolver *)filter->state, data);
+            break;
+        case DELAY:
+            data = delay_effect((DelayEffect *)filter->state, data,
                 filter->args[0]->value.f,
-                filter->args[1]->value.f
+                0,
+                0,
+                filter->args[1]->value.f,
+                filter->args[2]->value.f
+            );
+            break;
+        case CHORUS:
+            data = delay_effect((DelayEffect *)filter->state, data,
+                CHORUS_BASE_TIME,
+                CHORUS_SWEEP_TIME * chorus_depth(filter->args[0]->value.f),
+                filter->args[1]->value.f,
+                filter->args[2]->value.f,
+                filter->args[3]->value.f
+            );
+            break;
+        case FLANGER:
+            data = delay_effect((DelayEffect *)filter->state, data,
+                FLANGER_BASE_TIME,
+                FLANGER_SWEEP_TIME * chorus_depth(filter->args[0]->value.f),
+                filter->args[1]->value.f,
+                filter->args[2]->value.f,
+                filter->args[3]->value.f
             );
             break;
         default:
@@ -282,8 +429,33 @@ float filtering(float data, Playdata *info, uint64_t t) {
             oto_error(OTO_SOUND_PLAYER_ERROR);
         }
 
-        i++;
+        filter = filter->next;
     }
 
     return data;
 }
+
+float filtering(float data, Playdata *info, uint64_t t) {
+    return apply_filters(data, info, t, false);
+}
+
+/**
+ * Songの音色のまとまりにかける
+ * まとまりのPlaydataは音の高さを持たないので, DETUNEはdetune_voice()で1音ずつかける
+ */
+float filtering_bus(float data, Playdata *info, uint64_t t) {
+    return apply_filters(data, info, t, true);
+}
+
+/* Songの1音にDETUNEだけをかける */
+float detune_voice(float data, Playdata *info, uint64_t t) {
+    if (info->sound == NULL) {
+        return data;
+    }
+    for (Filter *filter = info->sound->filters; filter != NULL; filter = filter->next) {
+        if (filter->num == DETUNE) {
+            data = detune(data, info, t, filter->args[0]->value.f);
+        }
+    }
+    return data;
+}
@@ -32,12 +32,89 @@ inline static float osc_white_noise(Playdata *info, uint64_t t, int64_t ch) {
     return ((float)rand()) / RAND_MAX;
 }
 
+/* base_freqで鳴らすと元の高さになるように, 読む速さを周波数に比例させる */
+inline static float osc_sample(Playdata *info, uint64_t t, int64_t ch) {
+    const Sample *s = info->sound->oscillator->sample;
+    double speed = info->freq[ch] / s->base_freq * s->rate / info->sampling_rate;
+
+    return sample_read(s, t * speed);
+}
+
+/* ビブラートがあるときは位相を折り返さずに進めて, 読む位置にする */
+inline static float osc_sample_phase(Playdata *info, int64_t ch) {
+    const Sample *s = info->sound->oscillator->sample;
+    double pos = info->phase[ch] * s->rate / s->base_freq;
+    info->phase[ch] += info->phase_inc[ch] * info->vibrato_mod;
+
+    return sample_read(s, pos);
+}
+
+/* 音色からVIBRATOフィルタを探し, 各声部の位相を初期化する */
+void init_vibrato(Playdata *info) {
+    info->vibrato = NULL;
+    info->vibrato_mod = 1.0;
+    if (IS_NOT_NULL(info->sound)) {
+        for (Filter *f = info->sound->filters; IS_NOT_NULL(f); f = f->next) {
+            if (f->num == VIBRATO) {
+                info->vibrato = f;
+                break;
+            }
+        }
+    }
+
+    for (int64_t ch = 0; ch < MAX_POLYPHONIC; ch++) {
+        info->phase[ch] = 0;
+        info->phase_inc[ch] = (double)info->freq[ch] / info->sampling_rate;
+    }
+}
+
+/* 制御レートでLFOを進める. depthは周波数に対する揺れ幅の割合, speedはHz */
+void update_vibrato(Playdata *info, uint64_t t) {
+    double depth = info->vibrato->args[0]->value.f;
+    double speed = info->vibrato->args[1]->value.f;
+    info->vibrato_mod = 1.0 + depth * sin(2 * PI * speed * t / info->sampling_rate);
+}
+
+/* 位相を進めながら波形を作る. 1サンプルあたり積和1回 */
+inline static float osc_phase_wave(Playdata *info, basicwave_t wave, int64_t ch) {
+    double p = info->phase[ch];
+    info->phase[ch] += info->phase_inc[ch] * info->vibrato_mod;
+    if (info->phase[ch] >= 1.0) {
+        info->phase[ch] -= 1.0;
+    }
+
+    switch (wave) {
+    case SAWTOOTH_WAVE:
+        return 1.0 - 2.0 * p;
+    case SQUARE_WAVE:
+        return (p < 0.5) ? 1.0 : -1.0;
+    case TRIANGLE_WAVE:
+        return (p < 0.5) ? -1.0 + 4.0 * p : 3.0 - 4.0 * p;
+    case WHITE_NOISE:
+        return ((float)rand()) / RAND_MAX;
+    default:
+        return sin(2 * PI * p);
+    }
+}
+
 float sound_generate(Playdata *info, uint64_t t, int64_t ch) {
     Sound *sound = info->sound;
     if (IS_NULL(sound)) {
         return osc_sine_wave(info, t, ch);
     }
 
+    if (sound->oscillator->wave == SAMPLE_WAVE) {
+        if (IS_NOT_NULL(info->vibrato)) {
+            return osc_sample_phase(info, ch);
+        }
+        return osc_sample(info, t, ch);
+    }
+
+    // ビブラートは発振器の位相増分を揺らす
+    if (IS_NOT_NULL(info->vibrato)) {
+        return osc_phase_wave(info, sound->oscillator->wave, ch);
+    }
+
     switch (sound->oscillator->wave) {
     case SINE_WAVE:
         return osc_sine_wave(info, t, ch);
@@ -0,0 +1,92 @@
+#include <oto/oto.h>
+#include <oto/oto_sound.h>
+
+/**
+ * 出力の直前にかけるルックアヘッドのピークリミッター
+ *
+ * 入力をlookaheadサンプル遅らせて出し, その間に入ってくる値の絶対値の最大を
+ * 単調減少のキュー(両端キュー)で1サンプルあたりO(1)で求める.
+ * 最大値がLIMITER_THRESHOLDを超えるならゲインを下げ, 下げたゲインを
+ * lookaheadサンプルで平均してから掛ける. 平均する窓はどれもそのピークを
+ * 見た後のゲインなので, ピークが出てくるときには閾値以下まで下がりきっている.
+ * 下げるときは先読みの間に滑らかに, 戻すときはLIMITER_RELEASE_TIMEでゆっくり戻す.
+ */
+
+#define LIMITER_MASK (LIMITER_MAX_LOOKAHEAD - 1)
+
+void init_limiter(Limiter *lm, int64_t sampling_rate) {
+    lm->lookahead = (int64_t)(LIMITER_LOOKAHEAD_TIME * sampling_rate + 0.5);
+    if (lm->lookahead < 1) {
+        lm->lookahead = 1;
+    } else if (lm->lookahead > LIMITER_MAX_LOOKAHEAD - 1) {
+        // キューには窓のlookahead + 1個が入る
+        lm->lookahead = LIMITER_MAX_LOOKAHEAD - 1;
+    }
+    lm->release = 1 - exp(-1 / (LIMITER_RELEASE_TIME * sampling_rate));
+
+    for (int64_t i = 0; i < LIMITER_MAX_LOOKAHEAD; i++) {
+        lm->delay[i] = 0;
+        lm->gain[i] = 1;
+    }
+    lm->gain_sum = lm->lookahead;
+    lm->held = 1;
+    lm->head = 0;
+    lm->tail = 0;
+    lm->t = 0;
+}
+
+/* 直近lookahead + 1サンプルの絶対値の最大 */
+static float window_peak(Limiter *lm, float a) {
+    int64_t t = lm->t;
+
+    // 窓から出た先頭と, 新しい値以下で最大になりえない末尾を捨てる
+    if (lm->head != lm->tail && lm->peak_t[lm->head & LIMITER_MASK] < t - lm->lookahead) {
+        lm->head++;
+    }
+    while (lm->head != lm->tail && lm->peak[(lm->tail - 1) & LIMITER_MASK] <= a) {
+        lm->tail--;
+    }
+    lm->peak[lm->tail & LIMITER_MASK] = a;
+    lm->peak_t[lm->tail & LIMITER_MASK] = t;
+    lm->tail++;
+
+    return lm->peak[lm->head & LIMITER_MASK];
+}
+
+/* 1サンプル入れて, lookaheadサンプル前の入力にゲインを掛けたものを返す */
+float limit(Limiter *lm, float d) {
+    int64_t t = lm->t;
+    int64_t n = lm->lookahead;
+
+    float peak = window_peak(lm, fabsf(d));
+    float target = (peak > LIMITER_THRESHOLD) ? LIMITER_THRESHOLD / peak : 1;
+    if (target < lm->held) {
+        lm->held = target;
+    } else {
+        lm->held += (target - lm->held) * lm->release;
+    }
+
+    // 直近lookahead個のゲインの平均
+    lm->gain_sum += lm->held - lm->gain[(t - n) & LIMITER_MASK];
+    lm->gain[t & LIMITER_MASK] = lm->held;
+    if ((t & LIMITER_MASK) == LIMITER_MASK) {
+        // 足し引きの誤差が溜まらないようにときどき足し直す
+        lm->gain_sum = 0;
+        for (int64_t i = 0; i < n; i++) {
+            lm->gain_sum += lm->gain[(t - i) & LIMITER_MASK];
+        }
+    }
+    float gain = lm->gain_sum / n;
+
+    float out = lm->delay[(t - n) & LIMITER_MASK] * gain;
+    lm->delay[t & LIMITER_MASK] = d;
+    lm->t++;
+
+    // 計算の誤差で閾値をわずかに超えても1は超えない
+    if (out > 1) {
+        out = 1;
+    } else if (out < -1) {
+        out = -1;
+    }
+    return out;
+}
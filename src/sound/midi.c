@@ -0,0 +1,319 @@
+#include <oto/oto.h>
+#include <oto/oto_sound.h>
+
+/**
+ * Standard MIDI File (フォーマット0, 1) の読み込み
+ *
+ * 全トラックからテンポ変更を集めてテンポマップを作り, ノートオンとオフの組を
+ * サンプル単位の位置と長さに直してSongに入れる. 音色はフォーマット1なら
+ * 音のあるトラックの順, フォーマット0ならチャンネルで分ける.
+ */
+
+#define MIDI_DEFAULT_TEMPO 500000  // 四分音符1つのマイクロ秒 (120BPM)
+
+/* テンポが変わる位置と, そこからの1tickあたりのサンプル数 */
+typedef struct {
+    uint64_t tick;
+    double pos;
+    double samples_per_tick;
+} TempoPoint;
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} MidiReader;
+
+static uint32_t read_be(const uint8_t *p, int64_t n) {
+    uint32_t v = 0;
+    for (int64_t i = 0; i < n; i++) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+/* 可変長の数値. 壊れていれば末尾まで進めて0を返す */
+static uint32_t read_vlq(MidiReader *r) {
+    uint32_t v = 0;
+    for (int64_t i = 0; i < 4 && r->p < r->end; i++) {
+        uint8_t c = *r->p++;
+        v = (v << 7) | (c & 0x7f);
+        if (!(c & 0x80)) {
+            return v;
+        }
+    }
+    r->p = r->end;
+    return 0;
+}
+
+static void skip_bytes(MidiReader *r, uint32_t n) {
+    r->p = (n < (uint32_t)(r->end - r->p)) ? r->p + n : r->end;
+}
+
+/* トラックを読むときの状態 */
+typedef struct {
+    VectorPTR *tempo;  // TempoPoint *
+    Song *song;
+    const TempoPoint *map;
+    int64_t map_len;
+    int64_t bus;       // フォーマット1のときのこのトラックの音色. 0ならチャンネルで分ける
+    bool by_channel;
+    bool has_note;
+    int64_t on_tick[16][128];  // 鳴っている音の始まり (-1なら鳴っていない)
+    uint8_t on_vel[16][128];
+} MidiTrackState;
+
+static double tick_to_pos(const TempoPoint *map, int64_t len, uint64_t tick) {
+    // tick以下で最後のテンポ変更を二分探索する
+    int64_t lo = 0, hi = len - 1;
+    while (lo < hi) {
+        int64_t mid = (lo + hi + 1) / 2;
+        if (map[mid].tick <= tick) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return map[lo].pos + (tick - map[lo].tick) * map[lo].samples_per_tick;
+}
+
+static void note_off(MidiTrackState *st, int64_t ch, int64_t key, uint64_t tick) {
+    if (st->on_tick[ch][key] < 0) {
+        return;
+    }
+    if (IS_NOT_NULL(st->song)) {
+        uint64_t start = (uint64_t)tick_to_pos(st->map, st->map_len, st->on_tick[ch][key]);
+        uint64_t end   = (uint64_t)tick_to_pos(st->map, st->map_len, tick);
+        song_add_note(st->song, start, end - start,
+                      440.0 * pow(2.0, (key - 69) / 12.0),
+                      (int8_t)(st->on_vel[ch][key] * 100 / 127),
+                      st->by_channel ? ch : st->bus);
+    }
+    st->on_tick[ch][key] = -1;
+    st->has_note = true;
+}
+
+/* tempoを集めるときはsongをNULLにして呼ぶ. 壊れたトラックならfalse */
+static bool read_track(MidiReader r, MidiTrackState *st) {
+    uint64_t tick = 0;
+    uint8_t status = 0;
+    memset(st->on_tick, 0xff, sizeof(st->on_tick));
+
+    while (r.p < r.end) {
+        tick += read_vlq(&r);
+        if (r.p >= r.end) {
+            return false;
+        }
+
+        uint8_t c = *r.p;
+        if (c & 0x80) {
+            status = c;
+            r.p++;
+        } else if (status == 0) {
+            // メタイベントなどの直後はランニングステータスを使えない
+            return false;
+        }
+
+        if (status == 0xff) {
+            if (r.p >= r.end) {
+                return false;
+            }
+            uint8_t type = *r.p++;
+            uint32_t len = read_vlq(&r);
+            if (len > (uint32_t)(r.end - r.p)) {
+                return false;
+            }
+            if (type == 0x51 && len == 3 && IS_NOT_NULL(st->tempo)) {
+                TempoPoint *tp = MYMALLOC1(TempoPoint);
+                if (IS_NULL(tp)) {
+                    oto_error(OTO_INTERNAL_ERROR);
+                }
+                tp->tick = tick;
+                tp->samples_per_tick = read_be(r.p, 3);  // 後でサンプル数に直す
+                vector_ptr_append(st->tempo, tp);
+            } else if (type == 0x2f) {
+                break;
+            }
+            skip_bytes(&r, len);
+            status = 0;
+            continue;
+        }
+        if (status == 0xf0 || status == 0xf7) {
+            skip_bytes(&r, read_vlq(&r));
+            status = 0;
+            continue;
+        }
+
+        int64_t ch = status & 0x0f;
+        int64_t data_len = ((status & 0xf0) == 0xc0 || (status & 0xf0) == 0xd0) ? 1 : 2;
+        if (r.end - r.p < data_len) {
+            return false;
+        }
+        int64_t key = r.p[0] & 0x7f;
+        int64_t vel = (data_len == 2) ? (r.p[1] & 0x7f) : 0;
+        r.p += data_len;
+
+        if ((status & 0xf0) == 0x90 && vel > 0) {
+            // 同じ音が重なったら前の音をそこで切る
+            note_off(st, ch, key, tick);
+            st->on_tick[ch][key] = tick;
+            st->on_vel[ch][key] = vel;
+        } else if ((status & 0xf0) == 0x80 || (status & 0xf0) == 0x90) {
+            note_off(st, ch, key, tick);
+        }
+    }
+
+    // 止め忘れた音はトラックの終わりで止める
+    for (int64_t ch = 0; ch < 16; ch++) {
+        for (int64_t key = 0; key < 128; key++) {
+            note_off(st, ch, key, tick);
+        }
+    }
+    return true;
+}
+
+static int compare_tempo_tick(const void *a, const void *b) {
+    const TempoPoint *ta = *(const TempoPoint **)a;
+    const TempoPoint *tb = *(const TempoPoint **)b;
+    return (ta->tick > tb->tick) - (ta->tick < tb->tick);
+}
+
+/**
+ * テンポ変更の一覧からテンポマップを作る
+ * divisionが正なら四分音符あたりのtick数, 負ならSMPTE (上位バイトが-fps, 下位が1フレームのtick数)
+ */
+static TempoPoint *make_tempo_map(VectorPTR *tempo, int16_t division, int64_t sampling_rate, int64_t *len) {
+    qsort(tempo->data, tempo->length, sizeof(void *), compare_tempo_tick);
+
+    TempoPoint *map = MYMALLOC(tempo->length + 1, TempoPoint);
+    if (IS_NULL(map)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+
+    if (division < 0) {
+        // SMPTEではテンポによらず1tickの長さが決まっている
+        double ticks_per_sec = (-(division >> 8)) * (double)(division & 0xff);
+        map[0].samples_per_tick = sampling_rate / ticks_per_sec;
+        *len = 1;
+        return map;
+    }
+
+    double samples_per_us_tick = sampling_rate / (1e6 * division);
+    map[0].samples_per_tick = MIDI_DEFAULT_TEMPO * samples_per_us_tick;
+    int64_t n = 1;
+    for (int64_t i = 0; i < tempo->length; i++) {
+        TempoPoint *tp = (TempoPoint *)tempo->data[i];
+        TempoPoint *prev = &map[n - 1];
+        double pos = prev->pos + (tp->tick - prev->tick) * prev->samples_per_tick;
+        if (tp->tick != prev->tick) {
+            n++;
+        }
+        map[n - 1].tick = tp->tick;
+        map[n - 1].pos  = pos;
+        map[n - 1].samples_per_tick = tp->samples_per_tick * samples_per_us_tick;
+    }
+    *len = n;
+    return map;
+}
+
+static void free_tempo_list(VectorPTR *tempo) {
+    for (int64_t i = 0; i < tempo->length; i++) {
+        free(tempo->data[i]);
+    }
+    free_vector_ptr(tempo);
+}
+
+Song *load_midi(const char *path, int64_t sampling_rate) {
+    size_t size = 0;
+    const uint8_t *map = (const uint8_t *)mmap_file(path, &size);
+    if (IS_NULL(map)) {
+        return NULL;
+    }
+
+    if (size < 14 || memcmp(map, "MThd", 4) != 0 || read_be(map + 4, 4) < 6) {
+        munmap_file((void *)map);
+        return NULL;
+    }
+    uint32_t format   = read_be(map + 8, 2);
+    uint32_t tracks   = read_be(map + 10, 2);
+    int16_t  division = (int16_t)read_be(map + 12, 2);
+    if (format > 1 || division == 0) {
+        // フォーマット2 (独立した複数のパターン) には対応しない
+        munmap_file((void *)map);
+        return NULL;
+    }
+
+    // トラックの場所を集める
+    MidiReader *track = MYMALLOC(tracks + 1, MidiReader);
+    if (IS_NULL(track)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+    int64_t track_num = 0;
+    size_t pos = 8 + read_be(map + 4, 4);
+    while (pos + 8 <= size && track_num < tracks) {
+        size_t len = read_be(map + pos + 4, 4);
+        if (len > size - pos - 8) {
+            len = size - pos - 8;
+        }
+        if (memcmp(map + pos, "MTrk", 4) == 0) {
+            track[track_num].p   = map + pos + 8;
+            track[track_num].end = map + pos + 8 + len;
+            track_num++;
+        }
+        pos += 8 + len;
+    }
+
+    MidiTrackState *st = MYMALLOC1(MidiTrackState);
+    VectorPTR *tempo = new_vector_ptr(16);
+    if (IS_NULL(st) || IS_NULL(tempo)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+
+    // 1回目: テンポ変更だけを集める
+    bool ok = true;
+    st->tempo = tempo;
+    for (int64_t i = 0; i < track_num && ok; i++) {
+        ok = read_track(track[i], st);
+    }
+
+    // 2回目: テンポマップを使って音を入れる
+    Song *song = NULL;
+    if (ok) {
+        int64_t map_len = 0;
+        TempoPoint *tmap = make_tempo_map(tempo, division, sampling_rate, &map_len);
+
+        song = new_song();
+        if (IS_NULL(song)) {
+            oto_error(OTO_INTERNAL_ERROR);
+        }
+        st->tempo      = NULL;
+        st->song       = song;
+        st->map        = tmap;
+        st->map_len    = map_len;
+        st->by_channel = (format == 0);
+        st->bus        = 0;
+        for (int64_t i = 0; i < track_num; i++) {
+            st->has_note = false;
+            read_track(track[i], st);
+            if (st->has_note) {
+                st->bus++;
+            }
+        }
+        finish_song(song);
+        free(tmap);
+    }
+
+    free_tempo_list(tempo);
+    free(st);
+    free(track);
+    munmap_file((void *)map);
+
+#ifdef DEBUG
+    if (IS_NOT_NULL(song)) {
+        printf("MIDI info\n");
+        printf("name : %s, format : %d, tracks : %I64d, notes : %I64d, length : %I64d samples\n\n",
+               path, (int)format, track_num, song->len, (int64_t)song->length);
+    }
+#endif
+
+    return song;
+}
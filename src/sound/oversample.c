@@ -0,0 +1,119 @@
+#include <oto/oto.h>
+#include <oto/oto_sound.h>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define OVERSAMPLE_USE_SSE
+#endif
+
+/**
+ * 非線形フィルタ用の2倍/4倍オーバーサンプリング
+ *
+ * 2倍のハーフバンドFIRを多相分解し, 1段で
+ *   アップ : 偶数位相(HALFBAND_TAPS個の積和)と中央タップ(遅延のみ)
+ *   ダウン : 同じ係数の積和 + 中央タップ
+ * を行う. 4倍は2段を入れ子にする.
+ */
+
+// 0でない方の位相の係数. 左右対称なので履歴の並び順によらない
+static float halfband_coef[HALFBAND_TAPS];
+static bool halfband_coef_ready = false;
+
+/* Blackman窓をかけたsincでハーフバンドフィルタを作る */
+static void init_halfband_coef() {
+    const int64_t len = 4 * HALFBAND_HALF_TAPS - 1;
+    const int64_t center = len / 2;
+    double sum = 0;
+
+    for (int64_t i = 0; i < HALFBAND_TAPS; i++) {
+        int64_t k = 2 * i - center;  // 中心からの距離 (奇数)
+        double w = 0.42 - 0.5 * cos(2 * PI * (2 * i) / (len - 1))
+                 + 0.08 * cos(4 * PI * (2 * i) / (len - 1));
+        halfband_coef[i] = sin(PI * k / 2) / (PI * k) * w;
+        sum += halfband_coef[i];
+    }
+
+    // 直流の利得が1になるように, 中央タップ(0.5)以外の和を0.5に揃える
+    for (int64_t i = 0; i < HALFBAND_TAPS; i++) {
+        halfband_coef[i] *= 0.5 / sum;
+    }
+    halfband_coef_ready = true;
+}
+
+inline static float halfband_dot(const float *x) {
+#ifdef OVERSAMPLE_USE_SSE
+    __m128 acc = _mm_setzero_ps();
+    for (int64_t i = 0; i < HALFBAND_TAPS; i += 4) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(&x[i]), _mm_loadu_ps(&halfband_coef[i])));
+    }
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    return _mm_cvtss_f32(acc);
+#else
+    float acc = 0;
+    for (int64_t i = 0; i < HALFBAND_TAPS; i++) {
+        acc += x[i] * halfband_coef[i];
+    }
+    return acc;
+#endif
+}
+
+/* 履歴の先頭に1つ積む. 戻り値の窓は[0]が最新 */
+inline static float *push_history(float *hist, int64_t pos, float d) {
+    hist[pos] = d;
+    hist[pos + HALFBAND_TAPS] = d;
+    return &hist[pos];
+}
+
+/* 1サンプルから2サンプル作る */
+inline static void halfband_up(HalfbandStage *s, float d, float *y0, float *y1) {
+    s->up_pos = (s->up_pos + HALFBAND_TAPS - 1) % HALFBAND_TAPS;
+    float *x = push_history(s->up, s->up_pos, d);
+
+    // 0を挟んだ分の利得2を掛ける
+    *y0 = 2 * halfband_dot(x);
+    *y1 = x[HALFBAND_HALF_TAPS - 1];
+}
+
+/* 2サンプルから1サンプル作る */
+inline static float halfband_down(HalfbandStage *s, float even, float odd) {
+    s->down_pos = (s->down_pos + HALFBAND_TAPS - 1) % HALFBAND_TAPS;
+    float *e = push_history(s->down_even, s->down_pos, even);
+    float *o = push_history(s->down_odd, s->down_pos, odd);
+
+    return halfband_dot(e) + 0.5 * o[HALFBAND_HALF_TAPS];
+}
+
+Oversampler *new_oversampler(int64_t factor) {
+    if (!halfband_coef_ready) {
+        init_halfband_coef();
+    }
+
+    Oversampler *os = REGION_ALLOC(REGION_FILTER, 1, Oversampler);
+    os->stages = (factor >= 4) ? 2 : 1;
+    reset_oversampler(os);
+
+    return os;
+}
+
+void reset_oversampler(Oversampler *os) {
+    memset(os->stage, 0, sizeof(os->stage));
+}
+
+static float oversample_stage(Oversampler *os, int64_t n, float d, shaper_t shape, Filter *filter) {
+    if (n == os->stages) {
+        return shape(d, filter);
+    }
+
+    HalfbandStage *s = &os->stage[n];
+    float y0, y1;
+    halfband_up(s, d, &y0, &y1);
+    y0 = oversample_stage(os, n + 1, y0, shape, filter);
+    y1 = oversample_stage(os, n + 1, y1, shape, filter);
+    return halfband_down(s, y0, y1);
+}
+
+/* 上げたレートでshapeをかけて元のレートに戻す */
+float oversample(Oversampler *os, float d, shaper_t shape, Filter *filter) {
+    return oversample_stage(os, 0, d, shape, filter);
+}
@@ -0,0 +1,107 @@
+#include <oto/oto.h>
+#include <oto/oto_sound.h>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define RESAMPLE_USE_SSE
+#endif
+
+/**
+ * 合成したサンプリング周波数から出力するサンプリング周波数への変換
+ *
+ * 入力の間をRESAMPLE_PHASES分割した位置ごとに, Kaiser窓をかけたsincの係数を持っておき,
+ * 出力の位置に近い2組の係数で積和をとって線形補間する.
+ * 周波数を下げるときは折り返さないように遮断周波数も下げる.
+ */
+
+#define RESAMPLE_KAISER_BETA 8.0
+
+/* 第1種変形ベッセル関数I0 */
+static double bessel_i0(double x) {
+    double sum = 1, term = 1;
+    for (int64_t k = 1; k < 32; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+void init_resampler(Resampler *rs, int64_t in_rate, int64_t out_rate) {
+    const int64_t T = RESAMPLE_TAPS;
+    float *coef = MYMALLOC((RESAMPLE_PHASES + 1) * T, float);
+    if (IS_NULL(coef)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+
+    // 入力のナイキスト周波数を1とした遮断周波数
+    double fc = (out_rate < in_rate) ? 0.95 * out_rate / in_rate : 0.95;
+    double i0_beta = bessel_i0(RESAMPLE_KAISER_BETA);
+
+    for (int64_t p = 0; p <= RESAMPLE_PHASES; p++) {
+        float *c = &coef[p * T];
+        double sum = 0;
+        for (int64_t k = 0; k < T; k++) {
+            // 窓の真ん中の2つの入力の間, p / RESAMPLE_PHASESの位置からの距離
+            double x = k - (T / 2 - 1) - (double)p / RESAMPLE_PHASES;
+            double u = x / (T / 2);
+            double w = (fabs(u) < 1) ? bessel_i0(RESAMPLE_KAISER_BETA * sqrt(1 - u * u)) / i0_beta : 0;
+            double s = (x == 0) ? 1 : sin(PI * fc * x) / (PI * fc * x);
+            c[k] = fc * s * w;
+            sum += c[k];
+        }
+        // 直流の利得を1に揃える
+        for (int64_t k = 0; k < T; k++) {
+            c[k] /= sum;
+        }
+    }
+
+    rs->coef = coef;
+    rs->step = (double)in_rate / out_rate;
+    rs->frac = 0;
+    rs->pos  = 0;
+    memset(rs->hist, 0, sizeof(rs->hist));
+}
+
+void free_resampler(Resampler *rs) {
+    free((float *)rs->coef);
+    rs->coef = NULL;
+}
+
+void resampler_push(Resampler *rs, float d) {
+    rs->hist[rs->pos] = d;
+    rs->hist[rs->pos + RESAMPLE_TAPS] = d;
+    rs->pos = (rs->pos + 1) % RESAMPLE_TAPS;
+}
+
+inline static float resample_dot(const float *x, const float *c) {
+#ifdef RESAMPLE_USE_SSE
+    __m128 acc = _mm_setzero_ps();
+    for (int64_t i = 0; i < RESAMPLE_TAPS; i += 4) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(&x[i]), _mm_loadu_ps(&c[i])));
+    }
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    return _mm_cvtss_f32(acc);
+#else
+    float acc = 0;
+    for (int64_t i = 0; i < RESAMPLE_TAPS; i++) {
+        acc += x[i] * c[i];
+    }
+    return acc;
+#endif
+}
+
+/* 今の位置の出力. 窓は古い順に並んでいる */
+float resampler_output(const Resampler *rs) {
+    const float *x = &rs->hist[rs->pos];
+    double p = rs->frac * RESAMPLE_PHASES;
+    int64_t i = (int64_t)p;
+    if (i >= RESAMPLE_PHASES) {
+        i = RESAMPLE_PHASES - 1;
+    }
+    float f = p - i;
+
+    float a = resample_dot(x, &rs->coef[i * RESAMPLE_TAPS]);
+    float b = resample_dot(x, &rs->coef[(i + 1) * RESAMPLE_TAPS]);
+    return a + f * (b - a);
+}
@@ -0,0 +1,97 @@
+#include <oto/oto.h>
+#include <oto/oto_sound.h>
+
+/**
+ * REVERB用の畳み込み
+ *
+ * インパルス応答をREVERB_BLOCK_SIZEごとに分割して各々のスペクトルを先に求めておき,
+ * 入力が1ブロック溜まるごとに
+ *   直近2ブロックをFFT -> 遅延線に積む -> 分割ごとに掛けて足す -> 逆FFTの後半を出力
+ * とする(overlap-save). 出力は1ブロック遅れる.
+ */
+
+// FFTの表はどのREVERBでも同じものを使う
+static FFTPlan *reverb_plan = NULL;
+
+#define SPEC_SIZE (2 * (REVERB_BLOCK_SIZE + 1))  // 複素数REVERB_BLOCK_SIZE + 1個
+
+Convolver *new_convolver(const double *ir, int64_t len) {
+    const int64_t B = REVERB_BLOCK_SIZE;
+
+    if (IS_NULL(reverb_plan)) {
+        reverb_plan = new_fft_plan(2 * B);
+        if (IS_NULL(reverb_plan)) {
+            oto_error(OTO_INTERNAL_ERROR);
+        }
+    }
+
+    Convolver *cv = REGION_ALLOC(REGION_FILTER, 1, Convolver);
+    cv->parts   = (len > 0) ? (len + B - 1) / B : 1;
+    cv->ir_spec = REGION_ALLOC(REGION_FILTER, cv->parts * SPEC_SIZE, float);
+    cv->fdl     = REGION_ALLOC(REGION_FILTER, cv->parts * SPEC_SIZE, float);
+    cv->in_buf  = REGION_ALLOC(REGION_FILTER, 2 * B, float);
+    cv->out_buf = REGION_ALLOC(REGION_FILTER, B, float);
+    cv->spec    = REGION_ALLOC(REGION_FILTER, SPEC_SIZE, float);
+    cv->time    = REGION_ALLOC(REGION_FILTER, 2 * B, float);
+
+    // 後ろ半分を0で埋めた分割ごとのスペクトル
+    for (int64_t p = 0; p < cv->parts; p++) {
+        for (int64_t i = 0; i < 2 * B; i++) {
+            int64_t j = p * B + i;
+            cv->time[i] = (i < B && j < len) ? ir[j] : 0;
+        }
+        rfft(reverb_plan, cv->time, &cv->ir_spec[p * SPEC_SIZE]);
+    }
+
+    reset_convolver(cv);
+    return cv;
+}
+
+void reset_convolver(Convolver *cv) {
+    memset(cv->fdl, 0, cv->parts * SPEC_SIZE * sizeof(float));
+    memset(cv->in_buf, 0, 2 * REVERB_BLOCK_SIZE * sizeof(float));
+    memset(cv->out_buf, 0, REVERB_BLOCK_SIZE * sizeof(float));
+    cv->fdl_pos = 0;
+    cv->pos = 0;
+}
+
+static void convolve_block(Convolver *cv) {
+    const int64_t B = REVERB_BLOCK_SIZE;
+
+    cv->fdl_pos = (cv->fdl_pos + cv->parts - 1) % cv->parts;
+    rfft(reverb_plan, cv->in_buf, &cv->fdl[cv->fdl_pos * SPEC_SIZE]);
+
+    // p番目の分割にはpブロック前の入力を掛ける
+    float *acc = cv->spec;
+    memset(acc, 0, SPEC_SIZE * sizeof(float));
+    for (int64_t p = 0; p < cv->parts; p++) {
+        const float *h = &cv->ir_spec[p * SPEC_SIZE];
+        const float *x = &cv->fdl[((cv->fdl_pos + p) % cv->parts) * SPEC_SIZE];
+        for (int64_t k = 0; k < SPEC_SIZE; k += 2) {
+            acc[k]     += x[k] * h[k]     - x[k + 1] * h[k + 1];
+            acc[k + 1] += x[k] * h[k + 1] + x[k + 1] * h[k];
+        }
+    }
+    irfft(reverb_plan, acc, cv->time);
+
+    // 前半は巡回した分なので捨てる
+    memcpy(cv->out_buf, &cv->time[B], B * sizeof(float));
+    memmove(cv->in_buf, &cv->in_buf[B], B * sizeof(float));
+}
+
+float convolve(Convolver *cv, float d) {
+    float out = cv->out_buf[cv->pos];
+    cv->in_buf[REVERB_BLOCK_SIZE + cv->pos] = d;
+
+    cv->pos++;
+    if (cv->pos == REVERB_BLOCK_SIZE) {
+        convolve_block(cv);
+        cv->pos = 0;
+    }
+    return out;
+}
+
+void free_reverb_plan() {
+    free_fft_plan(reverb_plan);
+    reverb_plan = NULL;
+}
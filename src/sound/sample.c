@@ -0,0 +1,161 @@
+#include <oto/oto.h>
+#include <oto/oto_sound.h>
+
+/**
+ * SAMPLE["file.wav"]で取り込むWAVファイル
+ *
+ * ファイル全体をマップして, dataチャンクの中を演奏しながら直接読む.
+ * 読み込み時にはヘッダしか触らないので, 大きなファイルでも必要な所だけが
+ * ページキャッシュから読まれる. 複数のチャンネルは平均して1つにする.
+ */
+
+#define WAVE_FORMAT_PCM        0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+// RESETや終了時にマップを外すために, 読み込んだものを繋いでおく
+static Sample *loaded_samples = NULL;
+
+static uint32_t read_le16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t read_le32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* RIFFのチャンクを辿ってfmtとdataを探す. 使えない形式ならfalse */
+static bool parse_wav(Sample *s, const uint8_t *map, size_t size) {
+    if (size < 12 || memcmp(map, "RIFF", 4) != 0 || memcmp(map + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+
+    const uint8_t *fmt = NULL;
+    size_t pos = 12;
+    while (pos + 8 <= size) {
+        const uint8_t *chunk = map + pos;
+        size_t len = read_le32(chunk + 4);
+        size_t body = pos + 8;
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && len >= 16 && body + 16 <= size) {
+            fmt = map + body;
+        } else if (memcmp(chunk, "data", 4) == 0 && IS_NOT_NULL(fmt)) {
+            // 書きかけのファイルでは長さが実際より大きいことがある
+            if (len > size - body) {
+                len = size - body;
+            }
+            s->data = map + body;
+
+            uint32_t tag  = read_le16(fmt);
+            uint32_t bits = read_le16(fmt + 14);
+            if (tag == WAVE_FORMAT_EXTENSIBLE && read_le32(fmt - 4) >= 26) {
+                tag = read_le16(fmt + 24);
+            }
+            s->channels = read_le16(fmt + 2);
+            s->rate     = read_le32(fmt + 4);
+            s->bytes    = bits / 8;
+            s->is_float = (tag == WAVE_FORMAT_IEEE_FLOAT);
+
+            if (!(tag == WAVE_FORMAT_PCM && 1 <= s->bytes && s->bytes <= 4)
+             && !(s->is_float && s->bytes == 4)) {
+                return false;
+            }
+            if (s->channels <= 0 || s->rate <= 0 || bits % 8 != 0) {
+                return false;
+            }
+            s->frames = len / (s->channels * s->bytes);
+            return s->frames > 0;
+        }
+
+        // チャンクは偶数バイトに揃えてある
+        pos = body + len + (len & 1);
+    }
+
+    return false;
+}
+
+Sample *load_sample(const char *path, double base_freq) {
+    size_t size = 0;
+    uint8_t *map = (uint8_t *)mmap_file(path, &size);
+    if (IS_NULL(map)) {
+        return NULL;
+    }
+
+    Sample *s = REGION_ALLOC(REGION_OSCIL, 1, Sample);
+    if (!parse_wav(s, map, size) || base_freq <= 0) {
+        munmap_file(map);
+        return NULL;
+    }
+    s->map       = map;
+    s->base_freq = base_freq;
+
+    s->next = loaded_samples;
+    loaded_samples = s;
+
+#ifdef DEBUG
+    printf("Sample info\n");
+    printf("name : %s, frames : %I64d, channels : %I64d, rate : %I64d\n\n",
+           path, s->frames, s->channels, s->rate);
+#endif
+
+    return s;
+}
+
+/* Sampleはregionに置くので, reset_region()より前に呼ぶ */
+void free_samples() {
+    for (Sample *s = loaded_samples; IS_NOT_NULL(s); s = s->next) {
+        munmap_file(s->map);
+        s->map  = NULL;
+        s->data = NULL;
+    }
+    loaded_samples = NULL;
+}
+
+/* i番目のフレームのチャンネルを平均した値 (-1 ~ 1) */
+static float sample_frame(const Sample *s, int64_t i) {
+    const uint8_t *p = s->data + i * s->channels * s->bytes;
+    float sum = 0;
+
+    for (int64_t ch = 0; ch < s->channels; ch++, p += s->bytes) {
+        switch (s->bytes) {
+        case 1:
+            // 8bitだけは符号なし
+            sum += (p[0] - 128) / 128.0f;
+            break;
+        case 2:
+            sum += (int16_t)read_le16(p) / 32768.0f;
+            break;
+        case 3:
+            sum += (int32_t)((p[0] << 8) | (p[1] << 16) | ((uint32_t)p[2] << 24)) / 2147483648.0f;
+            break;
+        default:
+            if (s->is_float) {
+                float f;
+                memcpy(&f, p, sizeof(float));
+                sum += f;
+            } else {
+                sum += (int32_t)read_le32(p) / 2147483648.0f;
+            }
+            break;
+        }
+    }
+
+    return (s->channels == 1) ? sum : sum / s->channels;
+}
+
+/* フレーム単位の位置posの値を隣のフレームとの線形補間で求める. 範囲外は0 */
+float sample_read(const Sample *s, double pos) {
+    if (IS_NULL(s->data) || pos < 0) {
+        return 0;
+    }
+
+    int64_t i = (int64_t)pos;
+    if (i >= s->frames) {
+        return 0;
+    }
+    float frac = (float)(pos - i);
+    float d0 = sample_frame(s, i);
+    float d1 = (i + 1 < s->frames) ? sample_frame(s, i + 1) : 0;
+
+    return d0 + (d1 - d0) * frac;
+}
@@ -0,0 +1,179 @@
+#include <oto/oto.h>
+#include <oto/oto_sound.h>
+
+/**
+ * 時刻の決まった音の並び (MIDIファイルやMML) をまとめて鳴らす
+ *
+ * 1音ずつPLAYを実行する代わりに, 鳴り始める順に並べた音を時刻に合わせて
+ * 鳴らし始め, 鳴り終わったものから外していく. 音色(bus)ごとに足してから
+ * フィルタをかけるので, 和音と同じくフィルタの状態は音色ごとに1つになる.
+ * ただしDETUNEは音の高さをずらすので, 足す前に1音ずつかける.
+ */
+
+#define SONG_DEFAULT_CAPACITY 256
+
+Song *new_song() {
+    Song *song = MYMALLOC1(Song);
+    if (IS_NULL(song)) {
+        return NULL;
+    }
+
+    song->capacity = SONG_DEFAULT_CAPACITY;
+    song->notes = MYMALLOC(song->capacity, SongNote);
+    if (IS_NULL(song->notes)) {
+        free(song);
+        return NULL;
+    }
+
+    return song;
+}
+
+void free_song(Song *song) {
+    if (IS_NULL(song)) {
+        return;
+    }
+    free(song->notes);
+    free(song);
+}
+
+void song_add_note(Song *song, uint64_t start, uint64_t length, float freq, int8_t volume, int64_t bus) {
+    if (song->len >= song->capacity) {
+        SongNote *notes = (SongNote *)realloc(song->notes, song->capacity * 2 * sizeof(SongNote));
+        if (IS_NULL(notes)) {
+            oto_error(OTO_INTERNAL_ERROR);
+        }
+        song->notes = notes;
+        song->capacity *= 2;
+    }
+
+    if (bus >= SONG_MAX_BUSES) {
+        bus = SONG_MAX_BUSES - 1;
+    }
+
+    SongNote *note = &song->notes[song->len++];
+    note->start  = start;
+    note->length = length;
+    note->freq   = freq;
+    note->volume = volume;
+    note->bus    = bus;
+
+    if (bus >= song->buses) {
+        song->buses = bus + 1;
+    }
+    if (start + length > song->length) {
+        song->length = start + length;
+    }
+}
+
+static int compare_note_start(const void *a, const void *b) {
+    const SongNote *na = (const SongNote *)a;
+    const SongNote *nb = (const SongNote *)b;
+    if (na->start != nb->start) {
+        return (na->start < nb->start) ? -1 : 1;
+    }
+    return (na->bus < nb->bus) ? -1 : (na->bus > nb->bus);
+}
+
+/* 鳴り始める順に並べる. 音を足し終わったら一度だけ呼ぶ */
+void finish_song(Song *song) {
+    qsort(song->notes, song->len, sizeof(SongNote), compare_note_start);
+}
+
+/**
+ * n番目の音色にsounds[n]を使う. 足りなければ最後のものを使い, 1つもなければ正弦波
+ * 同じSoundを使う音色は1つのまとまりにして, フィルタを2回かけないようにする
+ */
+void init_song_player(SongPlayer *sp, Song *song, Sound **sounds, int64_t sounds_num,
+                      int64_t sampling_rate, double fade_range) {
+    sp->song       = song;
+    sp->buses      = 0;
+    sp->active     = 0;
+    sp->next       = 0;
+    sp->fade_range = fade_range;
+
+    for (int64_t b = 0; b < song->buses; b++) {
+        Sound *sound = NULL;
+        if (sounds_num > 0) {
+            sound = sounds[(b < sounds_num) ? b : sounds_num - 1];
+        }
+
+        int64_t j = 0;
+        while (j < sp->buses && sp->bus[j].sound != sound) {
+            j++;
+        }
+        if (j == sp->buses) {
+            Playdata *info = &sp->bus[j];
+            memset(info, 0, sizeof(Playdata));
+            info->sound         = sound;
+            info->sound_num     = 1;
+            info->length        = song->length;
+            info->freq[0]       = 440;
+            info->volume        = 100;
+            info->sampling_rate = sampling_rate;
+            reset_filters(sound);
+            sp->buses++;
+        }
+        sp->bus_of[b] = j;
+    }
+}
+
+/* 鳴り始めと鳴り終わりをfade_rangeの割合だけ滑らかにする */
+static float voice_fade(const SongPlayer *sp, const SongNote *note, uint64_t t) {
+    double range = sp->fade_range * note->length;
+    if (t < range) {
+        return t / range;
+    } else if (note->length - t < range) {
+        return (note->length - t) / range;
+    }
+    return 1;
+}
+
+/* 全体の位置tのサンプルを作る. tは0から1ずつ進める */
+float song_render(SongPlayer *sp, uint64_t t) {
+    Song *song = sp->song;
+
+    // 鳴り始める音を空いている声部に入れる
+    while (sp->next < song->len && song->notes[sp->next].start <= t) {
+        const SongNote *note = &song->notes[sp->next++];
+        if (sp->active >= SONG_MAX_VOICES) {
+            continue;
+        }
+
+        Playdata *bus = &sp->bus[sp->bus_of[note->bus]];
+        SongVoice *voice = &sp->voices[sp->active++];
+        voice->note = note;
+        voice->info.sound         = bus->sound;
+        voice->info.sound_num     = 1;
+        voice->info.length        = note->length;
+        voice->info.freq[0]       = note->freq;
+        voice->info.volume        = note->volume;
+        voice->info.sampling_rate = bus->sampling_rate;
+        init_vibrato(&voice->info);
+    }
+
+    float sums[SONG_MAX_BUSES] = {0};
+    for (int64_t v = 0; v < sp->active;) {
+        SongVoice *voice = &sp->voices[v];
+        uint64_t vt = t - voice->note->start;
+        if (vt > voice->note->length) {
+            // 最後の声部と入れ替えて外す
+            *voice = sp->voices[--sp->active];
+            continue;
+        }
+
+        if (IS_NOT_NULL(voice->info.vibrato) && vt % VIBRATO_CONTROL_PERIOD == 0) {
+            update_vibrato(&voice->info, vt);
+        }
+        float d = sound_generate(&voice->info, vt, 0) * voice->note->volume / 100;
+        d = detune_voice(d, &voice->info, vt);
+        sums[sp->bus_of[voice->note->bus]] += d * voice_fade(sp, voice->note, vt);
+        v++;
+    }
+
+    float d = 0;
+    for (int64_t b = 0; b < sp->buses; b++) {
+        d += filtering_bus(sums[b], &sp->bus[b], t);
+    }
+
+    return d * SONG_MIX_GAIN;
+}
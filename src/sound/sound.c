@@ -8,29 +8,18 @@
  * PLAY 500, 1, 1, AAA
  */
 
-#define DEFAULT_FILTERS_SIZE 50
-
 Sound *new_sound(Oscillator *osc) {
-    Sound *sound = MYMALLOC1(Sound);
-    if (IS_NULL(sound)) {
-        oto_error(OTO_INTERNAL_ERROR);
-    }
-
-    sound->oscillator = osc;
-    sound->filters = new_vector_ptr(DEFAULT_FILTERS_SIZE);
-    if (IS_NULL(sound->filters)) {
-        free(sound);
-        oto_error(OTO_INTERNAL_ERROR);
-    }
+    Sound *sound = REGION_ALLOC(REGION_SOUND, 1, Sound);
+
+    sound->oscillator  = osc;
+    sound->filters     = NULL;
+    sound->last_filter = NULL;
 
     return sound;
 }
 
 Oscillator *new_oscil(basicwave_t wave, basicwave_t fm_wave, float fm_freq) {
-    Oscillator *osc = MYMALLOC1(Oscillator);
-    if (IS_NULL(osc)) {
-        oto_error(OTO_INTERNAL_ERROR);
-    }
+    Oscillator *osc = REGION_ALLOC(REGION_OSCIL, 1, Oscillator);
 
     osc->wave = wave;
     osc->fm_wave = fm_wave;
@@ -39,3 +28,16 @@ Oscillator *new_oscil(basicwave_t wave, basicwave_t fm_wave, float fm_freq) {
     return osc;
 }
 
+/**
+ * smp = SAMPLE["piano.wav", 261.63]
+ * AAA = SOUND[smp]
+ *
+ * PLAY 523.25, 1, 1, AAA  // 1オクターブ上げて鳴らす
+ */
+Oscillator *new_sample_oscil(Sample *sample) {
+    Oscillator *osc = new_oscil(SAMPLE_WAVE, NO_WAVE, 0);
+    osc->sample = sample;
+
+    return osc;
+}
+
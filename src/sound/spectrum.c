@@ -0,0 +1,234 @@
+#include <oto/oto.h>
+#include <oto/oto_sound.h>
+
+/**
+ * スペクトログラム
+ *
+ * 渡された信号を1バッチ分(SPEC_BATCHフレーム)だけ溜めておき, 溜まるごとに
+ * フレームをスレッドに分けてHann窓をかけたFFTを求め, dB値を1フレームずつ順にrowへ渡す.
+ * 信号全体は持たないので, 長い曲でも使うメモリは変わらない.
+ */
+
+#define SPEC_BUF_SIZE ((SPEC_BATCH - 1) * SPEC_HOP + SPEC_FFT_SIZE)
+#define SPEC_WORK_SIZE (2 * SPEC_FFT_SIZE + 2)  // 窓をかけた入力とスペクトル
+
+typedef struct {
+    Spectrogram *spec;
+    int64_t begin;
+    int64_t end;
+    float *work;
+} SpecTask;
+
+Spectrogram *new_spectrogram(spec_row_t row, void *arg) {
+    Spectrogram *spec = MYMALLOC1(Spectrogram);
+    if (IS_NULL(spec)) {
+        return NULL;
+    }
+
+    spec->plan   = new_fft_plan(SPEC_FFT_SIZE);
+    spec->window = MYMALLOC(SPEC_FFT_SIZE, float);
+    spec->buf    = MYMALLOC(SPEC_BUF_SIZE, float);
+    spec->db     = MYMALLOC(SPEC_BATCH * SPEC_BINS, float);
+    spec->work   = MYMALLOC(SPEC_THREADS * SPEC_WORK_SIZE, float);
+    if (IS_NULL(spec->plan) || IS_NULL(spec->window) || IS_NULL(spec->buf)
+        || IS_NULL(spec->db) || IS_NULL(spec->work)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+
+    // 振幅1の正弦波が0dBになるように窓の和で割る
+    spec->window_gain = 0;
+    for (int64_t i = 0; i < SPEC_FFT_SIZE; i++) {
+        spec->window[i] = 0.5 - 0.5 * cos(2 * PI * i / SPEC_FFT_SIZE);
+        spec->window_gain += spec->window[i];
+    }
+    spec->window_gain = 2 / spec->window_gain;
+
+    spec->buf_len = 0;
+    spec->row     = row;
+    spec->arg     = arg;
+    spec->frames  = 0;
+
+    return spec;
+}
+
+static DWORD WINAPI spec_worker(LPVOID p) {
+    SpecTask *task = (SpecTask *)p;
+    Spectrogram *spec = task->spec;
+    float *frame = task->work;
+    float *bins  = task->work + SPEC_FFT_SIZE;
+
+    for (int64_t f = task->begin; f < task->end; f++) {
+        const float *src = &spec->buf[f * SPEC_HOP];
+        for (int64_t i = 0; i < SPEC_FFT_SIZE; i++) {
+            frame[i] = src[i] * spec->window[i];
+        }
+        rfft(spec->plan, frame, bins);
+
+        float *db = &spec->db[f * SPEC_BINS];
+        for (int64_t k = 0; k < SPEC_BINS; k++) {
+            float re = bins[2 * k], im = bins[2 * k + 1];
+            db[k] = 10 * log10((re * re + im * im) * spec->window_gain * spec->window_gain + 1e-20);
+        }
+    }
+    return 0;
+}
+
+/* バッファの先頭からframes個のフレームを求めてrowへ流す */
+static void spec_batch(Spectrogram *spec, int64_t frames) {
+    SpecTask tasks[SPEC_THREADS];
+    HANDLE threads[SPEC_THREADS];
+    int64_t nthreads = 0;
+    int64_t per = (frames + SPEC_THREADS - 1) / SPEC_THREADS;
+
+    for (int64_t i = 0; i < SPEC_THREADS && i * per < frames; i++) {
+        tasks[i].spec  = spec;
+        tasks[i].begin = i * per;
+        tasks[i].end   = (i + 1) * per < frames ? (i + 1) * per : frames;
+        tasks[i].work  = &spec->work[i * SPEC_WORK_SIZE];
+        HANDLE thread = CreateThread(NULL, 0, spec_worker, &tasks[i], 0, NULL);
+        if (IS_NULL(thread)) {
+            // スレッドが作れなければこのスレッドで計算する
+            spec_worker(&tasks[i]);
+        } else {
+            threads[nthreads++] = thread;
+        }
+    }
+    if (nthreads > 0) {
+        WaitForMultipleObjects(nthreads, threads, TRUE, INFINITE);
+        for (int64_t i = 0; i < nthreads; i++) {
+            CloseHandle(threads[i]);
+        }
+    }
+
+    for (int64_t f = 0; f < frames; f++) {
+        spec->row(&spec->db[f * SPEC_BINS], spec->arg);
+    }
+    spec->frames += frames;
+
+    // 次のバッチで使う分を前に詰める
+    int64_t used = frames * SPEC_HOP;
+    if (used < spec->buf_len) {
+        memmove(spec->buf, &spec->buf[used], (spec->buf_len - used) * sizeof(float));
+        spec->buf_len -= used;
+    } else {
+        spec->buf_len = 0;
+    }
+}
+
+void spectrogram_push(Spectrogram *spec, const float *data, int64_t n) {
+    while (n > 0) {
+        int64_t m = SPEC_BUF_SIZE - spec->buf_len;
+        if (m > n) {
+            m = n;
+        }
+        memcpy(&spec->buf[spec->buf_len], data, m * sizeof(float));
+        spec->buf_len += m;
+        data += m;
+        n -= m;
+
+        if (spec->buf_len == SPEC_BUF_SIZE) {
+            spec_batch(spec, SPEC_BATCH);
+        }
+    }
+}
+
+/* 残りを0で埋めて出し切り, 解放する */
+void finish_spectrogram(Spectrogram *spec) {
+    while (spec->buf_len > 0) {
+        int64_t frames = (spec->buf_len + SPEC_HOP - 1) / SPEC_HOP;
+        if (frames > SPEC_BATCH) {
+            frames = SPEC_BATCH;
+        }
+        int64_t need = (frames - 1) * SPEC_HOP + SPEC_FFT_SIZE;
+        memset(&spec->buf[spec->buf_len], 0, (need - spec->buf_len) * sizeof(float));
+        spec_batch(spec, frames);
+    }
+
+    free_fft_plan(spec->plan);
+    free(spec->window);
+    free(spec->buf);
+    free(spec->db);
+    free(spec->work);
+    free(spec);
+}
+
+/* 黒 -> 青 -> 赤 -> 黄 -> 白 */
+void spec_color(float db, uint8_t rgb[3]) {
+    float v = (db - SPEC_MIN_DB) / -SPEC_MIN_DB;
+    if (v < 0) {
+        v = 0;
+    } else if (v > 1) {
+        v = 1;
+    }
+
+    static const float table[5][3] = {
+        {0, 0, 0}, {0, 0, 160}, {220, 0, 40}, {255, 220, 0}, {255, 255, 255}
+    };
+    float x = v * 4;
+    int64_t i = (int64_t)x;
+    if (i >= 4) {
+        i = 3;
+    }
+    float r = x - i;
+    for (int64_t c = 0; c < 3; c++) {
+        rgb[c] = (uint8_t)(table[i][c] + (table[i + 1][c] - table[i][c]) * r);
+    }
+}
+
+/**
+ * PPM(P6)への書き出し
+ *
+ * 1フレームを1行とし, 時間は上から下, 周波数は左から右に並べる.
+ * 行数は最後まで分からないので, ヘッダの高さは幅を固定して書いておき閉じるときに書き直す.
+ */
+
+#define PPM_HEADER_FORMAT "P6\n%5d %10d\n255\n"
+
+typedef struct {
+    FILE *fp;
+    uint8_t *line;
+    int64_t rows;
+} SpecFile;
+
+static void write_ppm_header(FILE *fp, int64_t rows) {
+    fprintf(fp, PPM_HEADER_FORMAT, (int)SPEC_BINS, (int)rows);
+}
+
+static void write_ppm_row(const float *db, void *arg) {
+    SpecFile *file = (SpecFile *)arg;
+    for (int64_t k = 0; k < SPEC_BINS; k++) {
+        spec_color(db[k], &file->line[3 * k]);
+    }
+    fwrite(file->line, 1, 3 * SPEC_BINS, file->fp);
+    file->rows++;
+}
+
+Spectrogram *open_spectrogram_file(const char *path) {
+    SpecFile *file = MYMALLOC1(SpecFile);
+    if (IS_NULL(file)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+    file->fp = fopen(path, "wb");
+    if (IS_NULL(file->fp)) {
+        free(file);
+        oto_error(OTO_FILE_NOT_FOUND_ERROR);
+    }
+    file->line = MYMALLOC(3 * SPEC_BINS, uint8_t);
+    if (IS_NULL(file->line)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+
+    write_ppm_header(file->fp, 0);
+    return new_spectrogram(write_ppm_row, file);
+}
+
+void close_spectrogram_file(Spectrogram *spec) {
+    SpecFile *file = (SpecFile *)spec->arg;
+    finish_spectrogram(spec);
+
+    fseek(file->fp, 0, SEEK_SET);
+    write_ppm_header(file->fp, file->rows);
+    fclose(file->fp);
+    free(file->line);
+    free(file);
+}
@@ -21,10 +21,18 @@ typedef struct {
     bool print_flag;
     bool safety_flag;
     bool fade_flag;
+    SongPlayer *song;  // NULLでなければinfoの代わりにこれを鳴らす
+
+    // 合成と出力のサンプリング周波数が違うときに変換する
+    bool resample_flag;
+    Resampler rs;
+
+    // safety_flagのときは出力の直前にかける
+    Limiter limiter;
 } Currentdata;
 Currentdata out_data;
 
-static void init_out_data(int64_t sampling_rate, bool print_flag, bool safety_flag) {
+static void init_out_data(int64_t sampling_rate, int64_t output_rate, bool print_flag, bool safety_flag) {
     out_data.info.sound = NULL;
     out_data.info.length = 0;
     out_data.info.volume = 0;
@@ -34,9 +42,16 @@ static void init_out_data(int64_t sampling_rate, bool print_flag, bool safety_fl
         out_data.info.freq[i] = 1;
     }
     out_data.info.sampling_rate = sampling_rate;
+    init_vibrato(&out_data.info);
     out_data.print_flag = print_flag;
     out_data.safety_flag = safety_flag;
     out_data.fade_flag = true;
+
+    out_data.resample_flag = (output_rate != sampling_rate);
+    if (out_data.resample_flag) {
+        init_resampler(&out_data.rs, sampling_rate, output_rate);
+    }
+    init_limiter(&out_data.limiter, output_rate);
 }
 
 static bool stream_active_flag = false;
@@ -48,20 +63,114 @@ void set_stream_active_flag(bool b) {
     stream_active_flag = b;
 }
 
-void write_out_data(Playdata data, bool print_flag, bool fade_flag) {
-    out_data.t = 0;
-    out_data.info.sound = data.sound;
-    out_data.info.sound_num = data.sound_num;
-    out_data.info.length = data.length;
+static void set_play_data(Currentdata *cur, Playdata data, bool print_flag, bool fade_flag) {
+    // 前の曲は解放されているかもしれないので先に外す
+    cur->song = NULL;
+    // コールバックがfiltering()で使う前にフィルタの状態を戻しておき,
+    // 最後にtを戻して新しい音を鳴らし始める
+    reset_filters(data.sound);
+    cur->info.sound = data.sound;
+    cur->info.sound_num = data.sound_num;
     for (uint64_t i = 0; i < data.sound_num; i++) {
-        out_data.info.freq[i] = data.freq[i];
+        cur->info.freq[i] = data.freq[i];
     }
-    out_data.info.volume = data.volume;
-    out_data.print_flag = print_flag;
-    out_data.fade_flag = fade_flag;
+    cur->info.volume = data.volume;
+    cur->print_flag = print_flag;
+    cur->fade_flag = fade_flag;
+    init_vibrato(&cur->info);
+    cur->info.length = data.length;
+    cur->t = 0;
+}
+
+void write_out_data(Playdata data, bool print_flag, bool fade_flag) {
+    set_play_data(&out_data, data, print_flag, fade_flag);
+}
+
+static void set_play_song(Currentdata *cur, SongPlayer *sp) {
+    // tを戻す前に曲を差し替えて, 前の(解放済みかもしれない)曲を鳴らさないようにする
+    cur->print_flag = false;
+    cur->song = sp;
+    cur->info.length = sp->song->length;
+    cur->t = 0;
+}
+
+void write_out_song(SongPlayer *sp) {
+    set_play_song(&out_data, sp);
+}
+
+/* 鳴らし終わった曲を解放する前に外す. ストリームが止まっているときに呼ぶ */
+void clear_out_song() {
+    out_data.song = NULL;
 }
 
 static double FADE_RANGE = 0.05;
+
+/* PLAYの音を1サンプル作る */
+static float synth_sample(Currentdata *data) {
+    if (IS_NOT_NULL(data->info.vibrato) && data->t % VIBRATO_CONTROL_PERIOD == 0) {
+        update_vibrato(&data->info, data->t);
+    }
+
+    float d = ((float)data->info.volume / 100) * sound_generate(&(data->info), data->t, 0);
+    for (int64_t i = 1; i < data->info.sound_num; i++) {
+        d += ((float)data->info.volume / 100) * sound_generate(&(data->info), data->t, i);
+    }
+    d /= (float)data->info.sound_num;
+    d = filtering(d, &data->info, data->t);
+
+    /* フェード処理 */
+    if (data->fade_flag) {
+        if (data->t < (FADE_RANGE * data->info.length)) {
+            d *= data->t / (FADE_RANGE * data->info.length);
+        } else if ((data->info.length - data->t) < (FADE_RANGE * data->info.length)) {
+            d *= (data->info.length - data->t) / (FADE_RANGE * data->info.length);
+        }
+    }
+
+    return d;
+}
+
+/* 合成するサンプリング周波数で1サンプル作る */
+static float render_sample(Currentdata *data) {
+    if (data->t > data->info.length) {
+        return 0;
+    }
+
+    float d = IS_NOT_NULL(data->song) ? song_render(data->song, data->t) : synth_sample(data);
+
+    if (data->print_flag) {
+        databuf[data->t] = d;
+    }
+
+    data->t += 1;
+    return d;
+}
+
+/* 出力するサンプリング周波数で1サンプル作る. 足りない分だけ合成する */
+static float resample_output(Currentdata *data) {
+    if (!data->resample_flag) {
+        return render_sample(data);
+    }
+
+    Resampler *rs = &data->rs;
+    while (rs->frac >= 1.0) {
+        resampler_push(rs, render_sample(data));
+        rs->frac -= 1.0;
+    }
+    float d = resampler_output(rs);
+    rs->frac += rs->step;
+    return d;
+}
+
+/* 変換の後の出力にリミッターをかける. 和音で大きくなっても割れない */
+static float render_output_sample(Currentdata *data) {
+    float d = resample_output(data);
+    if (data->safety_flag) {
+        d = limit(&data->limiter, d);
+    }
+    return d;
+}
+
 static int play_callback(const void *inputBuffer,
                          void *outputBuffer,
                          unsigned long framesPerBuffer,
@@ -73,74 +182,113 @@ static int play_callback(const void *inputBuffer,
     
     // ここに出力データを書き込む
     float *out = (float *)outputBuffer;
-    float d = 0;
 
     for (uint64_t i = 0; i < framesPerBuffer; i++) {
-        if (data->t > data->info.length) {
-            *out++ = 0;
-            continue;
-        }
+        *out++ = render_output_sample(data);
+    }
+
+    if (data->t > data->info.length) {
+        stream_active_flag = false;
+        data->print_flag = false;
+    }
 
-        d = ((float)data->info.volume / 100) * sound_generate(&(data->info), data->t, 0);
-        for (int64_t i = 1; i < data->info.sound_num; i++) {
-            d += ((float)data->info.volume / 100) * sound_generate(&(data->info), data->t, i);
+    return 0;
+}
+
+static void render_cur_spectrogram(Currentdata *cur, Spectrogram *spec) {
+    float buf[FRAMES_PER_BUFFER];
+    while (cur->t <= cur->info.length) {
+        // 残りの合成サンプルを使い切るのに要る出力のサンプル数だけ作る
+        uint64_t n = cur->info.length + 1 - cur->t;
+        if (cur->resample_flag) {
+            n = (uint64_t)ceil(n / cur->rs.step);
         }
-        d /= (float)data->info.sound_num;
-        d = filtering(d, &data->info, data->t);
-
-        /* フェード処理 */
-        if (data->fade_flag) {
-            if (data->t < (FADE_RANGE * data->info.length)) {
-                d *= data->t / (FADE_RANGE * data->info.length);
-            } else if ((data->info.length - data->t) < (FADE_RANGE * data->info.length)) {
-                d *= (data->info.length - data->t) / (FADE_RANGE * data->info.length);
-            }
+        if (n > FRAMES_PER_BUFFER) {
+            n = FRAMES_PER_BUFFER;
         }
+        play_callback(NULL, buf, n, NULL, 0, cur);
+        spectrogram_push(spec, buf, n);
+    }
+}
+
+/* 音を鳴らさずに最後まで作ってスペクトログラムに流す */
+void render_spectrogram(Playdata data, Spectrogram *spec) {
+    // 鳴っているストリームとは別の演奏情報を使う
+    Currentdata cur = out_data;
+    set_play_data(&cur, data, false, true);
+    render_cur_spectrogram(&cur, spec);
+}
 
+// --spectrogramのときは音を鳴らさずにここへ書き出す
+static Spectrogram *offline_spec = NULL;
 
-        if (data->print_flag) {
-            databuf[data->t] = d;
-        }
+/**
+ * --spectrogramのときはストリームを開かないので, out_dataをそのまま使う.
+ * リミッターと変換の状態が音の間で続くので, 先読みで遅れた音の終わりも次の音の前に出る
+ */
+void render_offline(Playdata data) {
+    set_play_data(&out_data, data, false, true);
+    render_cur_spectrogram(&out_data, offline_spec);
+}
 
-        if (data->safety_flag) {
-            d *= 0.3;
-            if (d >= 1.0) {
-                *out++ = 1.0;
-            } else if (d <= -1.0) {
-                *out++ = -1.0;
-            } else {
-                *out++ = d;
-            }
-        } else {
-            *out++ = d;
-        }
+void render_song_offline(SongPlayer *sp) {
+    set_play_song(&out_data, sp);
+    render_cur_spectrogram(&out_data, offline_spec);
+    clear_out_song();
+}
 
-        data->t += 1;
+/* 最後の音の, リミッターの先読みで遅れている分を書き出す */
+static void flush_offline() {
+    if (!out_data.safety_flag) {
+        return;
     }
 
-    if (data->t > data->info.length) {
-        stream_active_flag = false;
-        data->print_flag = false;
+    float buf[LIMITER_MAX_LOOKAHEAD];
+    int64_t n = out_data.limiter.lookahead;
+    for (int64_t i = 0; i < n; i++) {
+        buf[i] = limit(&out_data.limiter, 0);
+    }
+    spectrogram_push(offline_spec, buf, n);
+}
+
+/* 合成するサンプリング周波数でのサンプル数を, 出力する周波数でのサンプル数にする */
+uint64_t output_length(uint64_t length) {
+    if (!out_data.resample_flag) {
+        return length;
     }
+    return (uint64_t)ceil(length / out_data.rs.step);
+}
 
-    return 0;
+/* 音を出すサンプリング周波数. 指定がなければ合成と同じ */
+static int64_t get_output_rate(Status *status) {
+    if (status->output_rate > 0) {
+        return status->output_rate;
+    }
+    return status->sampling_rate;
 }
 
 static PaStream *stream;
 void init_sound_stream(Status *status) {
     PaError err = paNoError;
 
+    if (IS_NOT_NULL(status->spectrogram_path)) {
+        init_out_data(status->sampling_rate, get_output_rate(status), false, status->safety_flag);
+        FADE_RANGE = status->fade_range;
+        offline_spec = open_spectrogram_file(status->spectrogram_path);
+        return;
+    }
+
     err = Pa_Initialize();
     if (err != paNoError) {
         oto_error(OTO_INTERNAL_ERROR);
     }
 
     init_stream_param();
-    init_out_data(status->sampling_rate, false, status->safety_flag);
+    init_out_data(status->sampling_rate, get_output_rate(status), false, status->safety_flag);
     FADE_RANGE = status->fade_range;
 
     err = Pa_OpenStream(&stream, NULL, &out_param,
-                        (float)status->sampling_rate,
+                        (float)get_output_rate(status),
                         FRAMES_PER_BUFFER, paClipOff, play_callback, &out_data);
     if (err != paNoError) {
         oto_error(OTO_INTERNAL_ERROR);
@@ -156,6 +304,17 @@ void terminate_sound_stream() {
     if (IS_NOT_NULL(databuf)) {
         free(databuf);
     }
+    free_reverb_plan();
+    if (out_data.resample_flag) {
+        free_resampler(&out_data.rs);
+        out_data.resample_flag = false;
+    }
+    if (IS_NOT_NULL(offline_spec)) {
+        flush_offline();
+        close_spectrogram_file(offline_spec);
+        offline_spec = NULL;
+        return;
+    }
     PaError err = paNoError;
 
     if (!Pa_IsStreamStopped(stream)) {
@@ -4,11 +4,17 @@ static Status oto_status = {
     false,  // timecount_flag
     false,  // repl_flag
     true,   // safety_flag
+    true,   // cache_flag
+    false,  // jit_flag
+    false,  // profile_flag
+    false,  // watch_flag
     NULL,   // root_srcpath
     NULL,   // include_srcpath
+    NULL,   // spectrogram_path
     NULL,   // srcfile_table
     LANG_JPN_KANJI,  // language
     44100,  // sampling_rate
+    0,      // output_rate
     0.05    // fade_range
 };
 
@@ -0,0 +1,332 @@
+#include <oto/oto.h>
+#include <oto/oto_sound.h>
+#include "../vm/vm.h"
+
+static const char test_src[] =
+    "FUNC step[v, w]\n"
+    "    c = c + v - w\n"
+    "END\n"
+    "x = 0\n"
+    "y = 1\n"
+    "c = 0\n"
+    "LOOP [50] BEGIN\n"
+    "    LOOP [40] BEGIN\n"
+    "        x = x + 1\n"
+    "        y = y * 3 % 1000 + x\n"
+    "    END\n"
+    "    IF [x % 3 == 0] THEN\n"
+    "        c = c + x / 4\n"
+    "    ELSIF [x % 3 == 1 AND y > 100] THEN\n"
+    "        c = c - 1\n"
+    "    ELSE\n"
+    "        c = c + 2\n"
+    "    END\n"
+    "    step[x % 5, 1]\n"
+    "END\n";
+
+static const char test_mml_src[] =
+    "LOOP [20] BEGIN\n"
+    "    MML \"t120 o4 a4 b8. r8 > c+&c2 d+&e-8\"\n"
+    "END\n";
+
+/* 再帰する関数の中のLOOPは呼び出しごとに回る (rec[d]で2 + 2 * rec[d - 1]回) */
+static const char test_recursion_src[] =
+    "cnt = 0\n"
+    "FUNC rec[d]\n"
+    "    LOOP [2] BEGIN\n"
+    "        cnt = cnt + 1\n"
+    "        IF [d > 0] THEN\n"
+    "            e = d - 1\n"
+    "            rec[e]\n"
+    "        END\n"
+    "    END\n"
+    "END\n"
+    "rec[2]\n";
+
+static const char test_otoc_src[] =
+    "x = 0\n"
+    "LOOP [3] BEGIN\n"
+    "    IF [x < 2] THEN\n"
+    "        x = x + 1\n"
+    "    END\n"
+    "END\n";
+
+/* 終わらないループ. --watch中ならネイティブコードになってもソースが変われば抜ける */
+static const char test_watch_src[] =
+    "x = 0\n"
+    "LOOP [1000000000000] BEGIN\n"
+    "    x = x + 1\n"
+    "END\n";
+
+static VectorPTR *compile_src(const char *s, VectorPTR *var_list, Status *status) {
+    char *src = MYMALLOC(strlen(s) + 1, char);
+    strcpy(src, s);
+
+    VectorI64 *src_tokens = lexer(src, var_list, status);
+    VectorPTR *ic_list = compile(src_tokens, var_list, src, status);
+    free_vector_i64(src_tokens);
+
+    return ic_list;
+}
+
+/* 1回分のフレームを作って実行する */
+static void exec_once(const VectorPTR *ic_list, VectorPTR *var_list, Status *status) {
+    Frame *frame = new_frame();
+    exec(ic_list, var_list, status, frame);
+    free_frame(frame);
+}
+
+static VectorPTR *compile_test_src(VectorPTR *var_list, Status *status) {
+    return compile_src(test_src, var_list, status);
+}
+
+static VectorPTR *run_test_src(bool jit_flag) {
+    Status *status = get_oto_status();
+    status->jit_flag = jit_flag;
+
+    VectorPTR *var_list = new_vector_ptr(DEFAULT_MAX_TC);
+    init_var_list(var_list);
+    init_filter(var_list);
+
+    VectorPTR *ic_list = compile_test_src(var_list, status);
+    exec_once(ic_list, var_list, status);
+    free_vector_ptr(ic_list);
+
+    return var_list;
+}
+
+/* インタプリタとJITで実行結果が同じになるか */
+void test_jit_differential() {
+    VectorPTR *expected = run_test_src(false);
+    VectorPTR *actual   = run_test_src(true);
+
+    TEST_EQ_NOT_PRINT(expected->length, actual->length);
+    for (int64_t i = 0; i < expected->length; i++) {
+        Var *v1 = (Var *)expected->data[i];
+        Var *v2 = (Var *)actual->data[i];
+        TEST_EQ_NOT_PRINT(v1->type, v2->type);
+        if (v1->type == TY_FUNC) {
+            // 関数の値は実行ごとに違うポインタ
+            continue;
+        }
+        TEST_EQ_NOT_PRINT(v1->value.i, v2->value.i);
+
+    }
+}
+
+void test_jit_compile() {
+    Status *status = get_oto_status();
+
+    VectorPTR *var_list = new_vector_ptr(DEFAULT_MAX_TC);
+    init_var_list(var_list);
+    init_filter(var_list);
+
+    VectorPTR *ic_list = compile_test_src(var_list, status);
+    for (int64_t i = 0; i < ic_list->length; i += 5) {
+        if ((opcode_t)ic_list->data[i] != OP_LOOP) {
+            continue;
+        }
+
+        // 関数呼び出しを含むループはインタプリタで実行する
+        bool has_call = false;
+        for (int64_t j = i; j < (int64_t)ic_list->data[i + 1]; j += 5) {
+            if ((opcode_t)ic_list->data[j] == OP_CALL) {
+                has_call = true;
+            }
+        }
+
+        JitCode *code = jit_compile(ic_list, i, false);
+#if defined(__x86_64__) || defined(_M_X64)
+        if (has_call) {
+            TEST_EQ_NOT_PRINT(code, NULL);
+        } else {
+            TEST_NE_NOT_PRINT(code, NULL);
+        }
+#endif
+
+        jit_free(code);
+    }
+
+    free_vector_ptr(ic_list);
+}
+
+static double operand_double(void *operand) {
+    union value_u v = {0};
+    v.p = operand;
+    return v.f;
+}
+
+static Var *find_var(VectorPTR *var_list, const char *name) {
+    for (int64_t i = 0; i < var_list->length; i++) {
+        Var *var = (Var *)var_list->data[i];
+        if (IS_NOT_NULL(var) && IS_NOT_NULL(var->token) && var->token->len == strlen(name)
+            && strncmp(var->token->str, name, var->token->len) == 0) {
+            return var;
+        }
+    }
+    return NULL;
+}
+
+void test_func_recursion_loop() {
+    Status *status = get_oto_status();
+
+    // 同じフレームを別の内部コードの実行に使い回せるか
+    Frame *frame = new_frame();
+    for (int64_t jit = 0; jit < 2; jit++) {
+        status->jit_flag = jit;
+
+        VectorPTR *var_list = new_vector_ptr(DEFAULT_MAX_TC);
+        init_var_list(var_list);
+        init_filter(var_list);
+
+        VectorPTR *ic_list = compile_src(test_recursion_src, var_list, status);
+        exec(ic_list, var_list, status, frame);
+        free_vector_ptr(ic_list);
+
+        Var *cnt = find_var(var_list, "cnt");
+        TEST_NE_NOT_PRINT(cnt, NULL);
+        TEST_EQ_NOT_PRINT(cnt->value.f, 14.0);
+    }
+    free_frame(frame);
+    status->jit_flag = false;
+}
+
+static VectorPTR *new_test_var_list() {
+    VectorPTR *var_list = new_vector_ptr(DEFAULT_MAX_TC);
+    init_var_list(var_list);
+    init_filter(var_list);
+    return var_list;
+}
+
+/* キャッシュから読んだ内部コードも同じように動き, 壊れたキャッシュは読まない */
+void test_otoc() {
+    Status *status = get_oto_status();
+    char srcpath[] = "test_otoc.oto";
+    char *src = MYMALLOC(strlen(test_otoc_src) + 1, char);
+    strcpy(src, test_otoc_src);
+    uint64_t key = otoc_key(src, status);
+
+    VectorPTR *var_list = new_test_var_list();
+    int64_t base_vars = var_list->length;
+    VectorPTR *ic_list = compile_src(test_otoc_src, var_list, status);
+    save_otoc(srcpath, key, base_vars, ic_list, var_list);
+
+    VectorPTR *loaded_vars = new_test_var_list();
+    VectorPTR *loaded = load_otoc(srcpath, key, loaded_vars);
+    TEST_NE_NOT_PRINT(loaded, NULL);
+    TEST_EQ_NOT_PRINT(loaded->length, ic_list->length);
+    exec_once(loaded, loaded_vars, status);
+    Var *x = find_var(loaded_vars, "x");
+    TEST_NE_NOT_PRINT(x, NULL);
+    TEST_EQ_NOT_PRINT(x->value.f, 2.0);
+    free_vector_ptr(loaded);
+    close_otoc();
+
+    // 最初の命令(x = 0)のオペランドを範囲外の変数にする
+    // (OtocHeaderは48バイトで, var_numは24バイト目から)
+    FILE *fp = fopen("test_otoc.otoc", "r+b");
+    uint64_t var_num = 0;
+    fseek(fp, 24, SEEK_SET);
+    fread(&var_num, sizeof(uint64_t), 1, fp);
+    uint64_t bad = base_vars + var_num + 1;
+    fseek(fp, 48 + var_num * 40 + 8, SEEK_SET);
+    fwrite(&bad, sizeof(uint64_t), 1, fp);
+    fclose(fp);
+
+    VectorPTR *bad_vars = new_test_var_list();
+    TEST_EQ_NOT_PRINT(load_otoc(srcpath, key, bad_vars), NULL);
+    TEST_EQ_NOT_PRINT(bad_vars->length, base_vars);
+
+    free_vector_ptr(ic_list);
+    remove("test_otoc.otoc");
+}
+
+void test_jit_watch() {
+    Status *status = get_oto_status();
+    char path[] = "test_watch.oto";
+    FILE *fp = fopen(path, "wb");
+    fputs(test_watch_src, fp);
+    fclose(fp);
+    update_watch(path);
+
+    // 監視を始めた後にソースを書き換える
+    fp = fopen(path, "wb");
+    fputs("x = 1\n", fp);
+    fclose(fp);
+
+    status->jit_flag   = true;
+    status->watch_flag = true;
+    VectorPTR *var_list = new_test_var_list();
+    VectorPTR *ic_list = compile_src(test_watch_src, var_list, status);
+    exec_once(ic_list, var_list, status);
+    status->jit_flag   = false;
+    status->watch_flag = false;
+
+    Var *x = find_var(var_list, "x");
+    TEST_NE_NOT_PRINT(x, NULL);
+    TEST_EQ_NOT_PRINT(x->value.f > JIT_HOT_LOOP_COUNT, true);
+
+    free_vector_ptr(ic_list);
+    remove(path);
+}
+
+/* MMLはコンパイル時に音の並びになり, JITでも読み飛ばせる */
+void test_mml() {
+    Status *status = get_oto_status();
+
+    VectorPTR *var_list = new_vector_ptr(DEFAULT_MAX_TC);
+    init_var_list(var_list);
+    init_filter(var_list);
+
+    VectorPTR *ic_list = compile_src(test_mml_src, var_list, status);
+    TEST_EQ_NOT_PRINT((opcode_t)ic_list->data[0], OP_LOOP);
+    TEST_EQ_NOT_PRINT((opcode_t)ic_list->data[5], OP_PLAYMML);
+    TEST_EQ_NOT_PRINT(ic_list->data[6], NULL);
+    TEST_EQ_NOT_PRINT((int64_t)ic_list->data[7], 5);
+    TEST_EQ_NOT_PRINT(operand_double(ic_list->data[8]),
+                      0.5 + 0.375 + 0.25 + 0.5 + 1.0 + 0.5 + 0.25);
+
+    // a4: 0秒から0.5秒, 440Hz
+    TEST_EQ_NOT_PRINT((opcode_t)ic_list->data[10], OP_MMLNOTE);
+    TEST_EQ_NOT_PRINT(operand_double(ic_list->data[11]), 0.0);
+    TEST_EQ_NOT_PRINT(operand_double(ic_list->data[12]), 0.5);
+    TEST_EQ_NOT_PRINT(operand_double(ic_list->data[13]), 440.0);
+    TEST_EQ_NOT_PRINT((int64_t)ic_list->data[14], 80);
+
+    // b8.: 付点8分音符
+    TEST_EQ_NOT_PRINT(operand_double(ic_list->data[16]), 0.5);
+    TEST_EQ_NOT_PRINT(operand_double(ic_list->data[17]), 0.375);
+
+    // 休符の後の > c+&c2 は高さが違うので2つの音のまま続けて鳴らす
+    TEST_EQ_NOT_PRINT(operand_double(ic_list->data[21]), 1.125);
+    TEST_EQ_NOT_PRINT(operand_double(ic_list->data[22]), 0.5);
+    double freq = operand_double(ic_list->data[23]);
+    TEST_EQ_NOT_PRINT(freq > 554.36 && freq < 554.37, true);
+    TEST_EQ_NOT_PRINT(operand_double(ic_list->data[26]), 1.625);
+    TEST_EQ_NOT_PRINT(operand_double(ic_list->data[27]), 1.0);
+    freq = operand_double(ic_list->data[28]);
+    TEST_EQ_NOT_PRINT(freq > 523.25 && freq < 523.26, true);
+
+    // d+&e-8 は同じ高さなのでタイで1つの音になる
+    TEST_EQ_NOT_PRINT(operand_double(ic_list->data[31]), 2.625);
+    TEST_EQ_NOT_PRINT(operand_double(ic_list->data[32]), 0.75);
+    freq = operand_double(ic_list->data[33]);
+    TEST_EQ_NOT_PRINT(freq > 622.25 && freq < 622.26, true);
+
+#if defined(__x86_64__) || defined(_M_X64)
+    JitCode *code = jit_compile(ic_list, 0, false);
+    TEST_NE_NOT_PRINT(code, NULL);
+    jit_free(code);
+#endif
+
+    free_vector_ptr(ic_list);
+}
+
+int main(void) {
+    test_jit_compile();
+    test_jit_differential();
+    test_func_recursion_loop();
+    test_otoc();
+    test_jit_watch();
+    test_mml();
+}
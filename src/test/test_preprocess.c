@@ -7,6 +7,121 @@ void test_new_string_literal() {
     TEST_EQ_NOT_PRINT(strcmp("12345", str), 0);
 }
 
+static void write_test_file(const char *path, const char *str) {
+    FILE *fp = fopen(path, "w");
+    fputs(str, fp);
+    fclose(fp);
+}
+
+static VectorPTR *new_test_var_list() {
+    VectorPTR *var_list = new_vector_ptr(DEFAULT_MAX_TC);
+    init_var_list(var_list);
+    init_filter(var_list);
+    return var_list;
+}
+
+static VectorI64 *lex_test_src(VectorPTR *var_list, Status *status) {
+    char src[] = "@include \"test_include_a.oto\"\nx = a + c\n";
+    return lexer(src, var_list, status);
+}
+
+/* キャッシュから繋いだトークン列が字句解析した結果と同じになるか */
+void test_include_cache() {
+    Status *status = get_oto_status();
+    if (IS_NULL(status->srcfile_table)) {
+        status->srcfile_table = new_map();
+    }
+
+    write_test_file("test_include_a.oto", "a = 1\n@include \"test_include_b.oto\"\n");
+    write_test_file("test_include_b.oto", "b = 2\nc = b + 1\n");
+
+    VectorPTR *var_list1 = new_test_var_list();
+    VectorI64 *tokens1 = lex_test_src(var_list1, status);
+
+    // 同じ変数表ならトークンコードもそのまま同じ
+    VectorI64 *tokens2 = lex_test_src(var_list1, status);
+    TEST_EQ_NOT_PRINT(tokens1->length, tokens2->length);
+    for (int64_t i = 0; i < tokens1->length; i++) {
+        TEST_EQ_NOT_PRINT(tokens1->data[i], tokens2->data[i]);
+    }
+
+    // 別の変数表ではトークンコードが変わっても同じ名前を指す
+    VectorPTR *var_list2 = new_test_var_list();
+    allocate_tc("zz", 2, TK_TY_VARIABLE, var_list2);
+    VectorI64 *tokens3 = lex_test_src(var_list2, status);
+    TEST_EQ_NOT_PRINT(tokens1->length, tokens3->length);
+    for (int64_t i = 0; i < tokens1->length; i++) {
+        tokencode_t tc1 = tokens1->data[i];
+        tokencode_t tc3 = tokens3->data[i];
+        if (IS_AVAILABLE_VAR(tc1)) {
+            TEST_NE_NOT_PRINT(tc1, tc3);
+            Token *t1 = ((Var *)var_list1->data[tc1])->token;
+            Token *t3 = ((Var *)var_list2->data[tc3])->token;
+            TEST_EQ_NOT_PRINT(t1->len, t3->len);
+            TEST_EQ_NOT_PRINT(strncmp(t1->str, t3->str, t1->len), 0);
+        } else {
+            TEST_EQ_NOT_PRINT(tc1, tc3);
+        }
+    }
+
+    // 中でインクルードしたファイルが変わったら読み直す
+    write_test_file("test_include_b.oto", "b = 2\nc = b + 1\nd = 3\n");
+    VectorI64 *tokens4 = lex_test_src(var_list1, status);
+    TEST_EQ_NOT_PRINT(tokens4->length, tokens1->length + 4);
+
+    remove("test_include_a.oto");
+    remove("test_include_b.oto");
+
+    free_vector_i64(tokens1);
+    free_vector_i64(tokens2);
+    free_vector_i64(tokens3);
+    free_vector_i64(tokens4);
+    free_include_cache();
+}
+
+/* インクルードしたファイルのトークンはそのファイルの行を指すか */
+void test_src_pos() {
+    Status *status = get_oto_status();
+    if (IS_NULL(status->srcfile_table)) {
+        status->srcfile_table = new_map();
+    }
+
+    write_test_file("test_include_a.oto", "\na = 1\n@include \"test_include_b.oto\"\n");
+    write_test_file("test_include_b.oto", "b = 2\n\nc = b + 1\n");
+
+    // 2回目はキャッシュから繋ぐ
+    for (int i = 0; i < 2; i++) {
+        VectorPTR *var_list = new_test_var_list();
+        VectorI64 *tokens = lex_test_src(var_list, status);
+
+        // (a.oto) \n a = 1 \n (b.oto) b = 2 \n \n c = b + 1 \n (a.oto) \n (main) \n x = a + c \n
+        int64_t lines[] = {
+            1, 2, 2, 2, 2,
+            1, 1, 1, 1, 2, 3, 3, 3, 3, 3, 3,
+            3,
+            1, 2, 2, 2, 2, 2, 2
+        };
+        TEST_EQ_NOT_PRINT(tokens->length, (int64_t)(sizeof(lines) / sizeof(lines[0])) + 1);
+        for (int64_t j = 0; j < tokens->length - 1; j++) {
+            const SrcPos *pos = get_src_pos(j);
+            TEST_NE_NOT_PRINT(pos, NULL);
+            TEST_EQ_NOT_PRINT(pos->line, lines[j]);
+        }
+
+        // "c"は2つ目のファイルの3行目の先頭
+        const SrcPos *pos = get_src_pos(10);
+        TEST_EQ_NOT_PRINT(pos->offset, 7);
+
+        free_vector_i64(tokens);
+    }
+
+    remove("test_include_a.oto");
+    remove("test_include_b.oto");
+    free_include_cache();
+}
+
 int main(void) {
     test_new_string_literal();
+    test_include_cache();
+    test_src_pos();
 }
@@ -0,0 +1,640 @@
+#include <oto/oto.h>
+#include <oto/oto_sound.h>
+
+#define TEST_SAMPLING_RATE 44100
+
+static Var *new_test_float(double f) {
+    Var *var = MYMALLOC1(Var);
+    var->type = TY_FLOAT;
+    var->value.f = f;
+    return var;
+}
+
+static Playdata new_test_playdata(double depth, double speed) {
+    Filter *filter = new_filter(VIBRATO);
+    filter->args[0] = new_test_float(depth);
+    filter->args[1] = new_test_float(speed);
+
+    Sound *sound = new_sound(new_oscil(SINE_WAVE, NO_WAVE, 0));
+    sound->filters = filter;
+    sound->last_filter = filter;
+
+    Playdata info;
+    info.sound = sound;
+    info.sound_num = 1;
+    info.length = TEST_SAMPLING_RATE;
+    info.freq[0] = 440;
+    info.volume = 100;
+    info.sampling_rate = TEST_SAMPLING_RATE;
+    init_vibrato(&info);
+
+    return info;
+}
+
+/* [begin, end)の区間で負から正に変わった回数 */
+static int64_t count_zero_cross(Playdata *info, uint64_t begin, uint64_t end) {
+    int64_t count = 0;
+    float before = 0;
+    for (uint64_t t = begin; t < end; t++) {
+        if (t % VIBRATO_CONTROL_PERIOD == 0) {
+            update_vibrato(info, t);
+        }
+        float d = sound_generate(info, t, 0);
+        if (before < 0 && d >= 0) {
+            count++;
+        }
+        before = d;
+    }
+    return count;
+}
+
+void test_vibrato() {
+    // 揺れ幅0なら普通の正弦波と同じ
+    Playdata info = new_test_playdata(0, 5);
+    TEST_NE_NOT_PRINT(info.vibrato, NULL);
+    for (uint64_t t = 0; t < 1000; t++) {
+        update_vibrato(&info, t);
+        float d = sound_generate(&info, t, 0);
+        float expected = sin(2 * PI * 440 * t / TEST_SAMPLING_RATE);
+        TEST_EQ_NOT_PRINT(fabs(d - expected) < 1e-3, true);
+    }
+
+    // LFOが正の間は高く, 負の間は低くなり, 1周期では元の高さに戻る
+    info = new_test_playdata(0.1, 5);
+    int64_t up   = count_zero_cross(&info, 0, TEST_SAMPLING_RATE / 10);
+    int64_t down = count_zero_cross(&info, TEST_SAMPLING_RATE / 10, TEST_SAMPLING_RATE / 5);
+    TEST_EQ_NOT_PRINT(up > 44, true);
+    TEST_EQ_NOT_PRINT(down < 44, true);
+    TEST_EQ_NOT_PRINT(llabs(up + down - 88) <= 1, true);
+
+    // VIBRATOがなければ位相は使わない
+    info.sound->filters = NULL;
+    init_vibrato(&info);
+    TEST_EQ_NOT_PRINT(info.vibrato, NULL);
+}
+
+static float through_shape(float d, Filter *filter) {
+    return d;
+}
+
+/* 何もしないshapeなら, 帯域内の信号は遅れるだけでそのまま戻る */
+void test_oversample() {
+    Oversampler *os = new_oversampler(2);
+    // 2倍は片道2 * HALFBAND_HALF_TAPS - 1半サンプル遅れる
+    int64_t delay = 2 * HALFBAND_HALF_TAPS - 1;
+    float in[1000];
+    for (int64_t t = 0; t < 1000; t++) {
+        in[t] = sin(2 * PI * 1000 * t / TEST_SAMPLING_RATE);
+        float d = oversample(os, in[t], through_shape, NULL);
+        if (t >= 100) {
+            TEST_EQ_NOT_PRINT(fabs(d - in[t - delay]) < 1e-3, true);
+        }
+    }
+
+    // 4倍でも振幅は変わらない
+    os = new_oversampler(4);
+    float peak = 0;
+    for (int64_t t = 0; t < 1000; t++) {
+        float d = oversample(os, in[t], through_shape, NULL);
+        if (t >= 100 && fabs(d) > peak) {
+            peak = fabs(d);
+        }
+    }
+    TEST_EQ_NOT_PRINT(fabs(peak - 1) < 1e-2, true);
+
+    reset_oversampler(os);
+    TEST_EQ_NOT_PRINT(oversample(os, 0, through_shape, NULL), 0);
+}
+
+static Filter *connect_test_filter(filtercode_t fc, Var *arg) {
+    Filter *filter = new_filter(fc);
+    filter->args[0] = arg;
+    init_filter_state(filter, TEST_SAMPLING_RATE);
+    return filter;
+}
+
+/* 非線形フィルタは接続時にオーバーサンプリングの状態を持つ */
+void test_nonlinear_filter() {
+    TEST_NE_NOT_PRINT(connect_test_filter(CLIP, NULL)->state, NULL);
+    TEST_NE_NOT_PRINT(connect_test_filter(SOFTCLIP, NULL)->state, NULL);
+    TEST_NE_NOT_PRINT(connect_test_filter(WAVESHAPE, NULL)->state, NULL);
+    TEST_EQ_NOT_PRINT(connect_test_filter(LPF, NULL)->state, NULL);
+
+    // 大きな入力でもSOFTCLIPの出力は1を大きく超えない
+    Filter *filter = connect_test_filter(SOFTCLIP, new_test_float(10));
+    Sound *sound = new_sound(new_oscil(SINE_WAVE, NO_WAVE, 0));
+    sound->filters = filter;
+    sound->last_filter = filter;
+
+    Playdata info;
+    info.sound = sound;
+    info.length = TEST_SAMPLING_RATE;
+    info.sampling_rate = TEST_SAMPLING_RATE;
+    reset_filters(sound);
+    for (uint64_t t = 0; t < 2000; t++) {
+        float d = filtering(3 * sin(2 * PI * 440 * t / TEST_SAMPLING_RATE), &info, t);
+        TEST_EQ_NOT_PRINT(fabs(d) < 1.1, true);
+    }
+}
+
+/* 素朴なDFTと比べる */
+void test_fft() {
+    for (int64_t n = 4; n <= 512; n *= 2) {
+        FFTPlan *plan = new_fft_plan(n);
+        float in[512], spec[514], out[512];
+        for (int64_t i = 0; i < n; i++) {
+            in[i] = sin(0.3 * i) + 0.5 * cos(1.7 * i + 0.2) + (i % 3) * 0.1;
+        }
+        rfft(plan, in, spec);
+
+        for (int64_t k = 0; k <= n / 2; k++) {
+            double re = 0, im = 0;
+            for (int64_t i = 0; i < n; i++) {
+                re += in[i] * cos(2 * PI * k * i / n);
+                im -= in[i] * sin(2 * PI * k * i / n);
+            }
+            TEST_EQ_NOT_PRINT(fabs(spec[2 * k] - re) < 1e-3 * n, true);
+            TEST_EQ_NOT_PRINT(fabs(spec[2 * k + 1] - im) < 1e-3 * n, true);
+        }
+
+        irfft(plan, spec, out);
+        for (int64_t i = 0; i < n; i++) {
+            TEST_EQ_NOT_PRINT(fabs(out[i] - in[i]) < 1e-4, true);
+        }
+        free_fft_plan(plan);
+    }
+    TEST_EQ_NOT_PRINT(new_fft_plan(100), NULL);
+}
+
+/* 直接の畳み込みを1ブロック遅らせたものと同じになる */
+void test_reverb() {
+    int64_t len = 3 * REVERB_BLOCK_SIZE + 17;
+    Array *ir = (Array *)region_alloc(REGION_ARRAY, sizeof(Array) + len * sizeof(double));
+    ir->len  = len;
+    ir->data = (double *)(ir + 1);
+    for (int64_t i = 0; i < len; i++) {
+        ir->data[i] = exp(-0.01 * i) * ((i % 7) - 3) / 3.0;
+    }
+
+    Var *impulse = MYMALLOC1(Var);
+    impulse->type = TY_ARRAY;
+    impulse->value.p = (void *)ir;
+    Filter *filter = connect_test_filter(REVERB, impulse);
+    Convolver *cv = (Convolver *)filter->state;
+    TEST_EQ_NOT_PRINT(cv->parts, 4);
+
+    int64_t total = 8 * REVERB_BLOCK_SIZE;
+    float *in = MYMALLOC(total, float);
+    for (int64_t t = 0; t < total; t++) {
+        in[t] = sin(0.05 * t) + ((t * 7919) % 13) / 13.0 - 0.5;
+    }
+    for (int64_t t = 0; t < total; t++) {
+        float d = convolve(cv, in[t]);
+        int64_t t0 = t - REVERB_BLOCK_SIZE;
+        double expected = 0;
+        for (int64_t i = 0; i < len && i <= t0; i++) {
+            expected += ir->data[i] * in[t0 - i];
+        }
+        TEST_EQ_NOT_PRINT(fabs(d - expected) < 1e-3, true);
+    }
+
+    // リセットすると残響は消える
+    reset_convolver(cv);
+    for (int64_t t = 0; t < 2 * REVERB_BLOCK_SIZE; t++) {
+        TEST_EQ_NOT_PRINT(convolve(cv, 0), 0);
+    }
+    free(in);
+}
+
+/* 遅延線は2の冪の長さで, 間の位置は線形補間で読む */
+void test_delay() {
+    DelayLine line;
+    init_delay_line(&line, 100);
+    TEST_EQ_NOT_PRINT(line.mask + 1, 128);
+    for (int64_t i = 0; i < 300; i++) {
+        delay_line_write(&line, i);
+    }
+    TEST_EQ_NOT_PRINT(delay_line_read(&line, 1), 299);
+    TEST_EQ_NOT_PRINT(delay_line_read(&line, 100), 200);
+    TEST_EQ_NOT_PRINT(delay_line_read(&line, 2.5), 297.5);
+
+    // DELAY[10サンプル, 0.5, 1]: 10サンプルごとに半分になるやまびこ
+    Filter *filter = new_filter(DELAY);
+    filter->args[0] = new_test_float(10.0 / TEST_SAMPLING_RATE);
+    filter->args[1] = new_test_float(0.5);
+    filter->args[2] = new_test_float(1);
+    init_filter_state(filter, TEST_SAMPLING_RATE);
+    DelayEffect *de = (DelayEffect *)filter->state;
+    for (int64_t t = 0; t < 40; t++) {
+        float d = delay_effect(de, (t == 0) ? 1 : 0, filter->args[0]->value.f, 0, 0, 0.5, 1);
+        float expected = (t > 0 && t % 10 == 0) ? pow(0.5, t / 10 - 1) : 0;
+        TEST_EQ_NOT_PRINT(fabs(d - expected) < 1e-6, true);
+    }
+
+    // リセットするとやまびこは消える
+    reset_delay_effect(de);
+    for (int64_t t = 0; t < 40; t++) {
+        TEST_EQ_NOT_PRINT(delay_effect(de, 0, filter->args[0]->value.f, 0, 0, 0.5, 1), 0);
+    }
+
+    // CHORUSは揺れ幅いっぱいまで読める長さを接続時に確保する
+    filter = new_filter(CHORUS);
+    init_filter_state(filter, TEST_SAMPLING_RATE);
+    de = (DelayEffect *)filter->state;
+    TEST_EQ_NOT_PRINT(de->line.mask - 1 >= (CHORUS_BASE_TIME + CHORUS_SWEEP_TIME) * TEST_SAMPLING_RATE, true);
+
+    // mix = 0なら元の音のまま
+    for (int64_t t = 0; t < 1000; t++) {
+        float d = sin(0.01 * t);
+        TEST_EQ_NOT_PRINT(delay_effect(de, d, CHORUS_BASE_TIME, CHORUS_SWEEP_TIME, 1, 0, 0), d);
+    }
+}
+
+/* 閾値を超える音は超えないように, 小さい音は遅らせるだけで通す */
+void test_limiter() {
+    static Limiter lm;
+    init_limiter(&lm, TEST_SAMPLING_RATE);
+    int64_t n = lm.lookahead;
+    TEST_EQ_NOT_PRINT(n, (int64_t)(LIMITER_LOOKAHEAD_TIME * TEST_SAMPLING_RATE + 0.5));
+
+    float in[4000];
+    for (int64_t t = 0; t < 4000; t++) {
+        in[t] = 0.5 * sin(2 * PI * 440 * t / TEST_SAMPLING_RATE);
+    }
+    for (int64_t t = 0; t < 4000; t++) {
+        float d = limit(&lm, in[t]);
+        float expected = (t < n) ? 0 : in[t - n];
+        TEST_EQ_NOT_PRINT(d, expected);
+    }
+
+    // 4音の和音と突然の大きな音
+    init_limiter(&lm, TEST_SAMPLING_RATE);
+    float peak = 0;
+    for (int64_t t = 0; t < 20000; t++) {
+        float d = 0;
+        for (int64_t ch = 1; ch <= 4; ch++) {
+            d += sin(2 * PI * 110 * ch * t / TEST_SAMPLING_RATE);
+        }
+        if (t == 10000) {
+            d = 8;
+        }
+        d = limit(&lm, d);
+        if (fabs(d) > peak) {
+            peak = fabs(d);
+        }
+    }
+    TEST_EQ_NOT_PRINT(peak <= LIMITER_THRESHOLD + 1e-4, true);
+    TEST_EQ_NOT_PRINT(peak > LIMITER_THRESHOLD - 0.05, true);
+}
+
+typedef struct {
+    int64_t rows;
+    int64_t peak_bin;
+    float peak_db;
+} SpecResult;
+
+static void record_spec_row(const float *db, void *arg) {
+    SpecResult *res = (SpecResult *)arg;
+    res->rows++;
+    for (int64_t k = 0; k < SPEC_BINS; k++) {
+        if (db[k] > res->peak_db) {
+            res->peak_db  = db[k];
+            res->peak_bin = k;
+        }
+    }
+}
+
+/* 少しずつ渡しても, 振幅1の正弦波はその周波数で0dB付近になる */
+void test_spectrogram() {
+    SpecResult res = {0, -1, SPEC_MIN_DB};
+    Spectrogram *spec = new_spectrogram(record_spec_row, &res);
+
+    int64_t total = 100000;
+    int64_t bin = 40;
+    float chunk[333];
+    for (int64_t t = 0; t < total;) {
+        int64_t n = 0;
+        for (; n < 333 && t < total; n++, t++) {
+            chunk[n] = sin(2 * PI * bin * t / SPEC_FFT_SIZE);
+        }
+        spectrogram_push(spec, chunk, n);
+    }
+    finish_spectrogram(spec);
+
+    TEST_EQ_NOT_PRINT(res.rows, (total + SPEC_HOP - 1) / SPEC_HOP);
+    TEST_EQ_NOT_PRINT(res.peak_bin, bin);
+    TEST_EQ_NOT_PRINT(fabs(res.peak_db) < 0.5, true);
+}
+
+/* 出力の周波数が低くても, 音の終わりに余分な無音を足さない */
+void test_spectrogram_output_rate() {
+    Status *status = get_oto_status();
+    status->sampling_rate    = TEST_SAMPLING_RATE;
+    status->output_rate      = TEST_SAMPLING_RATE / 2;
+    status->safety_flag      = false;
+    status->spectrogram_path = "test_spec.ppm";
+    init_sound_stream(status);
+
+    SpecResult res = {0, -1, SPEC_MIN_DB};
+    Spectrogram *spec = new_spectrogram(record_spec_row, &res);
+
+    // 最後の出力のバッファが半分ほど余る長さの音を続けて流す
+    Playdata data = new_test_playdata(0, 1);
+    data.length = 20 * SPEC_HOP + FRAMES_PER_BUFFER - 1;
+    int64_t notes = 6;
+    for (int64_t i = 0; i < notes; i++) {
+        render_spectrogram(data, spec);
+    }
+    finish_spectrogram(spec);
+
+    uint64_t samples = notes * output_length(data.length + 1);
+    TEST_EQ_NOT_PRINT(res.rows, (samples + SPEC_HOP - 1) / SPEC_HOP);
+
+    terminate_sound_stream();
+    status->spectrogram_path = NULL;
+    status->output_rate      = 0;
+    remove("test_spec.ppm");
+}
+
+/* in_rateの正弦波をout_rateに変換し, 立ち上がりの後の最大振幅とゼロ交差の数を返す */
+static float resample_test_sine(int64_t in_rate, int64_t out_rate, double freq, int64_t *cross) {
+    Resampler rs;
+    init_resampler(&rs, in_rate, out_rate);
+
+    int64_t t = 0;
+    float peak = 0, before = 0;
+    *cross = 0;
+    for (int64_t i = 0; i < out_rate; i++) {
+        while (rs.frac >= 1.0) {
+            resampler_push(&rs, sin(2 * PI * freq * t / in_rate));
+            rs.frac -= 1.0;
+            t++;
+        }
+        float d = resampler_output(&rs);
+        rs.frac += rs.step;
+
+        if (i >= RESAMPLE_TAPS * 4) {
+            if (fabs(d) > peak) {
+                peak = fabs(d);
+            }
+            if (before < 0 && d >= 0) {
+                (*cross)++;
+            }
+        }
+        before = d;
+    }
+
+    free_resampler(&rs);
+    return peak;
+}
+
+void test_resampler() {
+    int64_t cross = 0;
+    int64_t expected = 1000 * (48000 - RESAMPLE_TAPS * 4) / 48000;
+
+    // 下げても上げても帯域内の音はそのまま
+    float peak = resample_test_sine(88200, 48000, 1000, &cross);
+    TEST_EQ_NOT_PRINT(fabs(peak - 1) < 0.01, true);
+    TEST_EQ_NOT_PRINT(llabs(cross - expected) <= 1, true);
+
+    peak = resample_test_sine(22050, 48000, 1000, &cross);
+    TEST_EQ_NOT_PRINT(fabs(peak - 1) < 0.01, true);
+    TEST_EQ_NOT_PRINT(llabs(cross - expected) <= 1, true);
+
+    // 出力のナイキスト周波数を超える音は折り返さずに消える
+    peak = resample_test_sine(88200, 48000, 35000, &cross);
+    TEST_EQ_NOT_PRINT(peak < 0.01, true);
+}
+
+/* 16bitステレオのWAVファイルを書く. LISTチャンクを挟んでおく */
+static void write_test_wav(const char *path, const int16_t *left, const int16_t *right, int64_t frames) {
+    FILE *fp = fopen(path, "wb");
+    uint32_t data_len = frames * 4;
+    uint32_t u32;
+    uint16_t u16;
+
+    fwrite("RIFF", 1, 4, fp);
+    u32 = 4 + (8 + 16) + (8 + 4) + (8 + data_len);
+    fwrite(&u32, 4, 1, fp);
+    fwrite("WAVE", 1, 4, fp);
+
+    fwrite("fmt ", 1, 4, fp);
+    u32 = 16;   fwrite(&u32, 4, 1, fp);
+    u16 = 1;    fwrite(&u16, 2, 1, fp);  // PCM
+    u16 = 2;    fwrite(&u16, 2, 1, fp);
+    u32 = 8000; fwrite(&u32, 4, 1, fp);
+    u32 = 8000 * 4; fwrite(&u32, 4, 1, fp);
+    u16 = 4;    fwrite(&u16, 2, 1, fp);
+    u16 = 16;   fwrite(&u16, 2, 1, fp);
+
+    fwrite("LIST", 1, 4, fp);
+    u32 = 4;    fwrite(&u32, 4, 1, fp);
+    fwrite("INFO", 1, 4, fp);
+
+    fwrite("data", 1, 4, fp);
+    fwrite(&data_len, 4, 1, fp);
+    for (int64_t i = 0; i < frames; i++) {
+        fwrite(&left[i], 2, 1, fp);
+        fwrite(&right[i], 2, 1, fp);
+    }
+    fclose(fp);
+}
+
+void test_sample() {
+    const char *path = "test_sample.wav";
+    int16_t left[1000], right[1000];
+    for (int64_t i = 0; i < 1000; i++) {
+        left[i]  = i * 32;
+        right[i] = i * 16;
+    }
+    write_test_wav(path, left, right, 1000);
+
+    Sample *s = load_sample(path, 440);
+    TEST_NE_NOT_PRINT(s, NULL);
+    TEST_EQ_NOT_PRINT(s->frames, 1000);
+    TEST_EQ_NOT_PRINT(s->channels, 2);
+    TEST_EQ_NOT_PRINT(s->rate, 8000);
+
+    // 左右の平均と, フレームの間の線形補間
+    TEST_EQ_NOT_PRINT(fabs(sample_read(s, 10) - 10 * 24 / 32768.0) < 1e-6, true);
+    TEST_EQ_NOT_PRINT(fabs(sample_read(s, 10.5) - 10.5 * 24 / 32768.0) < 1e-6, true);
+    TEST_EQ_NOT_PRINT(sample_read(s, 1000), 0);
+    TEST_EQ_NOT_PRINT(sample_read(s, -1), 0);
+
+    // base_freqの2倍で鳴らすと2倍の速さで読む
+    Playdata info;
+    info.sound = new_sound(new_sample_oscil(s));
+    info.freq[0] = 880;
+    info.sampling_rate = 16000;
+    TEST_EQ_NOT_PRINT(fabs(sound_generate(&info, 20, 0) - sample_read(s, 20)) < 1e-6, true);
+
+    // VIBRATOで位相増分が1.5倍になれば, 読む位置も1.5倍の速さで進む
+    Filter *vibrato = new_filter(VIBRATO);
+    vibrato->args[0] = new_test_float(0.5);
+    vibrato->args[1] = new_test_float(5);
+    info.sound->filters = vibrato;
+    info.sound->last_filter = vibrato;
+    init_vibrato(&info);
+    info.vibrato_mod = 1.5;
+    float d = 0;
+    for (uint64_t t = 0; t <= 20; t++) {
+        d = sound_generate(&info, t, 0);
+    }
+    TEST_EQ_NOT_PRINT(fabs(d - sample_read(s, 30)) < 1e-6, true);
+
+    // REVERBのインパルス応答は合成のサンプリング周波数に変換する
+    Var *impulse = MYMALLOC1(Var);
+    impulse->type = TY_OSCIL;
+    impulse->value.p = (void *)new_sample_oscil(s);
+    Filter *filter = connect_test_filter(REVERB, impulse);
+    Convolver *cv = (Convolver *)filter->state;
+    int64_t ir_len = (1000 * TEST_SAMPLING_RATE + 7999) / 8000;
+    TEST_EQ_NOT_PRINT(cv->parts, (ir_len + REVERB_BLOCK_SIZE - 1) / REVERB_BLOCK_SIZE);
+    double step = 8000.0 / TEST_SAMPLING_RATE;
+    for (int64_t t = 0; t <= REVERB_BLOCK_SIZE + 441; t++) {
+        float d = convolve(cv, (t == 0) ? 1 : 0);
+        if (t == REVERB_BLOCK_SIZE + 441) {
+            // 441 * 8000 / 44100 = 80フレーム目
+            TEST_EQ_NOT_PRINT(fabs(d - sample_read(s, 80) * step) < 1e-4, true);
+        }
+    }
+
+    // マップを外した後は鳴らない
+    free_samples();
+    TEST_EQ_NOT_PRINT(sample_read(s, 10), 0);
+
+    // WAVでないファイルは読み込めない
+    FILE *fp = fopen(path, "wb");
+    fputs("PLAY 440, 1, 100\n", fp);
+    fclose(fp);
+    TEST_EQ_NOT_PRINT(load_sample(path, 440), NULL);
+    TEST_EQ_NOT_PRINT(load_sample("not_exist.wav", 440), NULL);
+    remove(path);
+}
+
+/**
+ * テンポ120で始まり, 960tickからテンポ60になるフォーマット1のファイル
+ * トラック1はランニングステータスを使った四分音符3つ, トラック2は付点二分音符1つ
+ */
+static const uint8_t test_midi_data[] = {
+    'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, 0, 3, 0x01, 0xe0,
+    'M', 'T', 'r', 'k', 0, 0, 0, 19,
+    0x00, 0xff, 0x51, 0x03, 0x07, 0xa1, 0x20,
+    0x87, 0x40, 0xff, 0x51, 0x03, 0x0f, 0x42, 0x40,
+    0x00, 0xff, 0x2f, 0x00,
+    'M', 'T', 'r', 'k', 0, 0, 0, 28,
+    0x00, 0x90, 0x45, 0x64, 0x83, 0x60, 0x45, 0x00, 0x00, 0x45, 0x64,
+    0x83, 0x60, 0x80, 0x45, 0x00, 0x00, 0x90, 0x45, 0x7f, 0x83, 0x60, 0x45, 0x00,
+    0x00, 0xff, 0x2f, 0x00,
+    'M', 'T', 'r', 'k', 0, 0, 0, 13,
+    0x00, 0x91, 0x4c, 0x50, 0x8b, 0x20, 0x81, 0x4c, 0x00,
+    0x00, 0xff, 0x2f, 0x00,
+};
+
+void test_midi() {
+    const char *path = "test_midi.mid";
+    FILE *fp = fopen(path, "wb");
+    fwrite(test_midi_data, 1, sizeof(test_midi_data), fp);
+    fclose(fp);
+
+    Song *song = load_midi(path, TEST_SAMPLING_RATE);
+    TEST_NE_NOT_PRINT(song, NULL);
+    TEST_EQ_NOT_PRINT(song->len, 4);
+    TEST_EQ_NOT_PRINT(song->buses, 2);
+    TEST_EQ_NOT_PRINT(song->length, 2 * TEST_SAMPLING_RATE);
+
+    // 鳴り始める順に並ぶ. テンポが変わった後の音は倍の長さになる
+    uint64_t starts[]  = {0, 0, TEST_SAMPLING_RATE / 2, TEST_SAMPLING_RATE};
+    uint64_t lengths[] = {TEST_SAMPLING_RATE / 2, 2 * TEST_SAMPLING_RATE, TEST_SAMPLING_RATE / 2, TEST_SAMPLING_RATE};
+    for (int64_t i = 0; i < 4; i++) {
+        TEST_EQ_NOT_PRINT(song->notes[i].start, starts[i]);
+        TEST_EQ_NOT_PRINT(song->notes[i].length, lengths[i]);
+    }
+    TEST_EQ_NOT_PRINT(song->notes[0].bus, 0);
+    TEST_EQ_NOT_PRINT(song->notes[1].bus, 1);
+    TEST_EQ_NOT_PRINT(fabs(song->notes[0].freq - 440) < 1e-3, true);
+    TEST_EQ_NOT_PRINT(fabs(song->notes[1].freq - 659.255) < 1e-2, true);
+    TEST_EQ_NOT_PRINT(song->notes[3].volume, 100);
+
+    // 2つの音が鳴っている間だけ音が出る
+    SongPlayer *sp = MYMALLOC1(SongPlayer);
+    init_song_player(sp, song, NULL, 0, TEST_SAMPLING_RATE, 0.05);
+    TEST_EQ_NOT_PRINT(sp->buses, 1);
+    float peak = 0;
+    for (uint64_t t = 0; t <= song->length; t++) {
+        float d = song_render(sp, t);
+        if (t == TEST_SAMPLING_RATE / 4) {
+            TEST_EQ_NOT_PRINT(sp->active, 2);
+        }
+        if (fabs(d) > peak) {
+            peak = fabs(d);
+        }
+    }
+    TEST_EQ_NOT_PRINT(peak > 0.1 && peak <= 2 * SONG_MIX_GAIN, true);
+    TEST_EQ_NOT_PRINT(song_render(sp, song->length + 1), 0);
+    TEST_EQ_NOT_PRINT(sp->active, 0);
+    free(sp);
+    free_song(song);
+
+    // フォーマット2とMIDIでないファイルは読み込めない
+    fp = fopen(path, "wb");
+    fwrite(test_midi_data, 1, sizeof(test_midi_data), fp);
+    fclose(fp);
+    fp = fopen(path, "r+b");
+    fseek(fp, 9, SEEK_SET);
+    fputc(2, fp);
+    fclose(fp);
+    TEST_EQ_NOT_PRINT(load_midi(path, TEST_SAMPLING_RATE), NULL);
+
+    fp = fopen(path, "wb");
+    fputs("PLAY 440, 1, 100\n", fp);
+    fclose(fp);
+    TEST_EQ_NOT_PRINT(load_midi(path, TEST_SAMPLING_RATE), NULL);
+    remove(path);
+}
+
+/* DETUNEは1音ずつかかり, 休符の間(MML "t60 o4 c16 r1")には音が出ない */
+void test_song_detune() {
+    Song *song = new_song();
+    song_add_note(song, 0, TEST_SAMPLING_RATE / 4, 261.626, 80, 0);
+    song->length = TEST_SAMPLING_RATE / 4 + TEST_SAMPLING_RATE;
+    finish_song(song);
+
+    Filter *filter = connect_test_filter(DETUNE, new_test_float(3));
+    Sound *sound = new_sound(new_oscil(SINE_WAVE, NO_WAVE, 0));
+    sound->filters = filter;
+    sound->last_filter = filter;
+
+    SongPlayer *sp = MYMALLOC1(SongPlayer);
+    init_song_player(sp, song, &sound, 1, TEST_SAMPLING_RATE, 0.05);
+    float note_peak = 0;
+    float rest_peak = 0;
+    for (uint64_t t = 0; t <= song->length; t++) {
+        float d = fabs(song_render(sp, t));
+        if (t <= TEST_SAMPLING_RATE / 4) {
+            note_peak = (d > note_peak) ? d : note_peak;
+        } else {
+            rest_peak = (d > rest_peak) ? d : rest_peak;
+        }
+    }
+    TEST_EQ_NOT_PRINT(note_peak > 0.1, true);
+    TEST_EQ_NOT_PRINT(rest_peak, 0);
+    free(sp);
+    free_song(song);
+}
+
+int main(void) {
+    test_vibrato();
+    test_oversample();
+    test_nonlinear_filter();
+    test_fft();
+    test_reverb();
+    test_delay();
+    test_limiter();
+    test_spectrogram();
+    test_spectrogram_output_rate();
+    test_resampler();
+    test_sample();
+    test_midi();
+    test_song_detune();
+}
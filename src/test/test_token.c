@@ -1,16 +1,153 @@
-#include <oto.h>
+#include <oto/oto.h>
 
 void test_is_rsvword() {
-    TEST_EQ_NOT_PRINT(is_rsvword("begin", 5), true);
-    TEST_EQ_NOT_PRINT(is_rsvword("exit", 4), true);
-    TEST_EQ_NOT_PRINT(is_rsvword("papapa", 6), false);
-    TEST_EQ_NOT_PRINT(is_rsvword("BEGIN", 5), true);
-    TEST_EQ_NOT_PRINT(is_rsvword("EXIT", 5), true);
-    TEST_EQ_NOT_PRINT(is_rsvword("Begin", 5), true);
-    TEST_EQ_NOT_PRINT(is_rsvword("Began", 5), false);
-    TEST_EQ_NOT_PRINT(is_rsvword("export", 6), false);
+    // 予約語の表はinit_var_listで作られる
+    VectorPTR *var_list = new_vector_ptr(DEFAULT_MAX_TC);
+    init_var_list(var_list);
+
+    TEST_EQ_NOT_PRINT(get_rsvword_tc("begin", 5), TC_BEGIN);
+    TEST_EQ_NOT_PRINT(get_rsvword_tc("exit", 4), TC_EXIT);
+    TEST_EQ_NOT_PRINT(get_rsvword_tc("papapa", 6), 0);
+    TEST_EQ_NOT_PRINT(get_rsvword_tc("BEGIN", 5), TC_BEGIN);
+    TEST_EQ_NOT_PRINT(get_rsvword_tc("EXIT", 4), TC_EXIT);
+    TEST_EQ_NOT_PRINT(get_rsvword_tc("Begin", 5), TC_BEGIN);
+    TEST_EQ_NOT_PRINT(get_rsvword_tc("Began", 5), 0);
+    TEST_EQ_NOT_PRINT(get_rsvword_tc("export", 6), 0);
+
+    free_var_list(var_list);
+}
+
+/* 同じ文字列には同じトークンコードを割り当てるか */
+void test_allocate_tc() {
+    VectorPTR *var_list = new_vector_ptr(DEFAULT_MAX_TC);
+    init_var_list(var_list);
+
+    tokencode_t a = allocate_tc("abc", 3, TK_TY_VARIABLE, var_list);
+    tokencode_t b = allocate_tc("abd", 3, TK_TY_VARIABLE, var_list);
+    TEST_NE_NOT_PRINT(a, b);
+    TEST_EQ_NOT_PRINT(allocate_tc("abc", 3, TK_TY_VARIABLE, var_list), a);
+    TEST_EQ_NOT_PRINT(allocate_tc("abcd", 3, TK_TY_VARIABLE, var_list), a);
+    TEST_EQ_NOT_PRINT(allocate_tc("LOOP", 4, TK_TY_RSVWORD, var_list), TC_LOOP);
+    TEST_EQ_NOT_PRINT(allocate_tc("PrintVar", 8, TK_TY_RSVWORD, var_list), TC_PRINTVAR);
+    TEST_EQ_NOT_PRINT(allocate_tc("exit", 4, TK_TY_RSVWORD, var_list), TC_EXIT);
+    TEST_NE_NOT_PRINT(allocate_tc("exits", 5, TK_TY_VARIABLE, var_list), TC_EXIT);
+    TEST_NE_NOT_PRINT(allocate_tc("en", 2, TK_TY_VARIABLE, var_list), TC_END);
+
+    // 索引が大きくなっても引けるか
+    char str[16];
+    tokencode_t first = 0;
+    for (int i = 0; i < 5000; i++) {
+        sprintf(str, "v%d", i);
+        tokencode_t tc = allocate_tc(str, strlen(str), TK_TY_VARIABLE, var_list);
+        if (i == 0) {
+            first = tc;
+        }
+        TEST_EQ_NOT_PRINT(tc, first + i);
+    }
+    TEST_EQ_NOT_PRINT(allocate_tc("v0", 2, TK_TY_VARIABLE, var_list), first);
+    TEST_EQ_NOT_PRINT(allocate_tc("v4999", 5, TK_TY_VARIABLE, var_list), first + 4999);
+    TEST_EQ_NOT_PRINT(allocate_tc("abd", 3, TK_TY_VARIABLE, var_list), b);
+
+    free_var_list(var_list);
+}
+
+static void write_test_src(const char *path, const char *s) {
+    FILE *fp = fopen(path, "wb");
+    fputs(s, fp);
+    fclose(fp);
+}
+
+/* マップしたソースの中の変数名はコピーせずに指すか */
+void test_src_view() {
+    const char *path = "test_src_view.oto";
+    write_test_src(path, "foo = bar\n");
+    Status *status = get_oto_status();
+    char *src = open_src_view(path, status);
+    TEST_NE_NOT_PRINT(src, NULL);
+
+    VectorPTR *var_list = new_vector_ptr(DEFAULT_MAX_TC);
+    init_var_list(var_list);
+
+    tokencode_t foo = allocate_tc(&src[0], 3, TK_TY_VARIABLE, var_list);
+    tokencode_t bar = allocate_tc(&src[6], 3, TK_TY_VARIABLE, var_list);
+    TEST_EQ_NOT_PRINT(((Var *)var_list->data[foo])->token->str, &src[0]);
+    TEST_EQ_NOT_PRINT(((Var *)var_list->data[bar])->token->str, &src[6]);
+    TEST_EQ_NOT_PRINT(((Var *)var_list->data[bar])->token->len, 3);
+
+    // ソースの外の文字列はコピーする
+    char str[] = "baz";
+    tokencode_t baz = allocate_tc(str, 3, TK_TY_VARIABLE, var_list);
+    TEST_NE_NOT_PRINT(((Var *)var_list->data[baz])->token->str, str);
+
+    free_var_list(var_list);
+    free_src_views();
+    remove(path);
+}
+
+/* ソースの中を指す数値は, 後ろに続く文字を読まずにトークンの長さだけで値にする */
+void test_literal_in_src_view() {
+    const char *path = "test_src_view.oto";
+    write_test_src(path, "a = 0x1f\n");
+    Status *status = get_oto_status();
+    char *src = open_src_view(path, status);
+    TEST_NE_NOT_PRINT(src, NULL);
+
+    VectorPTR *var_list = new_vector_ptr(DEFAULT_MAX_TC);
+    init_var_list(var_list);
+
+    tokencode_t zero = allocate_tc(&src[4], 1, TK_TY_LITERAL, var_list);
+    TEST_EQ_NOT_PRINT(((Var *)var_list->data[zero])->token->str, &src[4]);
+    TEST_EQ_NOT_PRINT(((Var *)var_list->data[zero])->value.f, 0.0);
+
+    free_var_list(var_list);
+    free_src_views();
+    remove(path);
+}
+
+/**
+ * --watch中はヒープにコピーするので, 読み込んだ後にファイルを書き換えても変数名は変わらない.
+ * 変数名はソースの外に移すので, 読み直した後に前のソースを捨てても残る
+ */
+void test_src_view_watch() {
+    const char *path = "test_src_view.oto";
+    write_test_src(path, "foo = bar\n");
+    Status *status = get_oto_status();
+    status->watch_flag = true;
+    char *src = open_src_view(path, status);
+    status->watch_flag = false;
+    TEST_NE_NOT_PRINT(src, NULL);
+
+    VectorPTR *var_list = new_vector_ptr(DEFAULT_MAX_TC);
+    init_var_list(var_list);
+
+    tokencode_t foo = allocate_tc(&src[0], 3, TK_TY_VARIABLE, var_list);
+    TEST_NE_NOT_PRINT(((Var *)var_list->data[foo])->token->str, &src[0]);
+
+    write_test_src(path, "qux = bar\n");
+    TEST_EQ_NOT_PRINT(strncmp(((Var *)var_list->data[foo])->token->str, "foo", 3), 0);
+
+    // 読み直して同じ名前を引けば同じ文字列を指す
+    status->watch_flag = true;
+    char *new_src = open_src_view(path, status);
+    status->watch_flag = false;
+    close_src_view(src);
+    tokencode_t bar = allocate_tc(&new_src[6], 3, TK_TY_VARIABLE, var_list);
+    tokencode_t qux = allocate_tc(&new_src[0], 3, TK_TY_VARIABLE, var_list);
+    close_src_view(new_src);
+    TEST_NE_NOT_PRINT(qux, foo);
+    TEST_EQ_NOT_PRINT(strncmp(((Var *)var_list->data[foo])->token->str, "foo", 3), 0);
+    TEST_EQ_NOT_PRINT(strncmp(((Var *)var_list->data[bar])->token->str, "bar", 3), 0);
+    TEST_EQ_NOT_PRINT(strncmp(((Var *)var_list->data[qux])->token->str, "qux", 3), 0);
+
+    free_var_list(var_list);
+    free_src_views();
+    remove(path);
 }
 
 int main(void) {
     test_is_rsvword();
+    test_allocate_tc();
+    test_src_view();
+    test_src_view_watch();
+    test_literal_in_src_view();
 }
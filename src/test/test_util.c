@@ -78,6 +78,53 @@ void test_map() {
     free_map(map);
 }
 
+void test_map_get_or_insert() {
+    Map *map = new_map();
+
+    // キーは長さで区切られ, Mapの中にコピーされる
+    char key[16] = "abcdef";
+    bool found = true;
+    void **slot = map_get_or_insert(map, key, 3, &found);
+    TEST_EQ_NOT_PRINT(found, false);
+    TEST_EQ_NOT_PRINT(*slot, NULL);
+    *slot = (void *)42;
+    strcpy(key, "xyz");
+    TEST_EQ_NOT_PRINT(map_geti(map, "abc"), 42);
+    TEST_EQ_NOT_PRINT(map_exist_key(map, "xyz"), false);
+
+    slot = map_get_or_insert(map, "abcdef", 3, &found);
+    TEST_EQ_NOT_PRINT(found, true);
+    TEST_EQ_NOT_PRINT((int64_t)*slot, 42);
+    TEST_EQ_NOT_PRINT(map_lookup(map, "ab", 2), NULL);
+
+    // 同じ内容のキーは同じ文字列になる
+    const char *s1 = map_intern(map, "hello", 5);
+    const char *s2 = map_intern(map, "hello world", 5);
+    TEST_EQ_NOT_PRINT(s1, s2);
+    TEST_EQ_NOT_PRINT(strcmp(s1, "hello"), 0);
+
+    // 表が大きくなっても全部引けるか
+    char str[16];
+    for (int64_t i = 0; i < 1000; i++) {
+        sprintf(str, "key%d", (int)i);
+        map_puti(map, str, i);
+    }
+    for (int64_t i = 0; i < 1000; i++) {
+        sprintf(str, "key%d", (int)i);
+        TEST_EQ_NOT_PRINT(map_geti(map, str), i);
+    }
+    TEST_EQ_NOT_PRINT(map->length, 1002);
+
+    int64_t count = 0;
+    int64_t iter = 0;
+    while (IS_NOT_NULL(map_next(map, &iter))) {
+        count++;
+    }
+    TEST_EQ_NOT_PRINT(count, map->length);
+
+    free_map(map);
+}
+
 void test_slice() {
     VectorI64 *veci64 = new_vector_i64(10);
 
@@ -148,11 +195,52 @@ void test_stack() {
     TEST_EQ_NOT_PRINT(val, 0);
 }
 
+void test_arena() {
+    Arena *arena = new_arena(64);
+
+    // 0で埋まっていて, 16バイト境界に揃っているか
+    int64_t *a = ARENA_ALLOC(arena, 4, int64_t);
+    char *b = ARENA_ALLOC(arena, 3, char);
+    int64_t *c = ARENA_ALLOC(arena, 2, int64_t);
+    TEST_EQ_NOT_PRINT(a[3], 0);
+    TEST_EQ_NOT_PRINT((uintptr_t)b % 16, 0);
+    TEST_EQ_NOT_PRINT((uintptr_t)c % 16, 0);
+    a[3] = 5;
+    c[1] = 7;
+
+    // 塊より大きい領域
+    int64_t *d = ARENA_ALLOC(arena, 100, int64_t);
+    d[99] = 9;
+    TEST_EQ_NOT_PRINT(a[3], 5);
+    TEST_EQ_NOT_PRINT(c[1], 7);
+
+    // 捨てた後は同じ領域を使い回す
+    arena_reset(arena);
+    int64_t *e = ARENA_ALLOC(arena, 4, int64_t);
+    TEST_EQ_NOT_PRINT(e, a);
+    TEST_EQ_NOT_PRINT(e[3], 0);
+
+    VectorI64 *vec = new_vector_i64(10);
+    for (int64_t i = 0; i < 10; i++) {
+        vector_i64_append(vec, i);
+    }
+    SliceI64 *slice = arena_slice_i64(arena, vec, 2, 8);
+    SliceI64 *slice2 = arena_slice_i64_from_slice(arena, slice, 1, 3);
+    TEST_EQ_NOT_PRINT(slice->length, 6);
+    TEST_EQ_NOT_PRINT(slice2->abs_idx, 3);
+    TEST_EQ_NOT_PRINT(slice_i64_get(slice2, 1), 4);
+
+    free_vector_i64(vec);
+    free_arena(arena);
+}
+
 int main(void) {
     test_vector_i64();
     test_fileio();
     test_map();
+    test_map_get_or_insert();
     test_string();
     test_slice();
     test_stack();
+    test_arena();
 }
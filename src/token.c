@@ -28,14 +28,138 @@ Token rsvwords[] = {
     {TC_NOT,       "not",       3, 1}, {TC_FUNC,      "func",      4, 1},
     {TC_TRACK,     "track",     5, 1}, {TC_FILTER,    "filter",    6, 1},
     {TC_OSCIL,     "oscil",     5, 1}, {TC_SOUND,     "sound",     5, 1},
+    {TC_SAMPLE,    "sample",    6, 1},
     {TC_PRINT,     "print",     5, 1}, {TC_BEEP,      "beep",      4, 1},
-    {TC_PLAY,      "play",      4, 1}, {TC_PRINTWAV,  "printwav",  8, 1}, 
-    {TC_PRINTVAR,  "printvar",  8, 1}, {TC_SLEEP,     "sleep",     5, 1},
-    {TC_SETSYNTH,  "setsynth",  8, 1}, {TC_SETLOOP,   "setloop",   7, 1},
-    {TC_STOP,      "stop",      4, 1}, {TC_EXIT,      "exit",      4, 1},
+    {TC_PLAY,      "play",      4, 1}, {TC_PLAYMIDI,  "playmidi",  8, 1},
+    {TC_MML,       "mml",       3, 1}, {TC_PRINTWAV,  "printwav",  8, 1},
+    {TC_PRINTSPEC, "printspec", 9, 1}, {TC_PRINTVAR,  "printvar",  8, 1},
+    {TC_SLEEP,     "sleep",     5, 1}, {TC_SETSYNTH,  "setsynth",  8, 1},
+    {TC_SETLOOP,   "setloop",   7, 1}, {TC_STOP,      "stop",      4, 1},
+    {TC_EXIT,      "exit",      4, 1},
     {0,            NULL,        0, 1},
 };
 
+/**
+ * トークンの文字列としてそのまま参照するソース
+ *
+ * マップしたソースの中の変数名などはコピーせずにソースの中を指す.
+ * 変数表から参照され続けるので, 終了するときにまとめて解放する.
+ * --watch中にヒープにコピーしたソースは名前をsrc_namesに移すので,
+ * 読み直したときにclose_src_view()で捨てられる.
+ */
+typedef struct {
+    char *src;
+    size_t size;
+    bool mapped;  // falseならヒープにコピーしたもの
+} SrcView;
+
+static VectorPTR *src_views = NULL;
+static Map *src_names = NULL;  // ヒープにコピーしたソースの中の名前
+
+static void add_src_view(char *src, size_t size, bool mapped) {
+    if (IS_NULL(src_views)) {
+        src_views = new_vector_ptr(DEFAULT_MAX_TC);
+        if (IS_NULL(src_views)) {
+            oto_error(OTO_INTERNAL_ERROR);
+        }
+    }
+
+    SrcView *view = MYMALLOC1(SrcView);
+    if (IS_NULL(view)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+    view->src    = src;
+    view->size   = size;
+    view->mapped = mapped;
+    vector_ptr_append(src_views, view);
+}
+
+/**
+ * ソースを読み込んでビューとして登録する (失敗したらNULL)
+ * --watch中は読み込み直すたびに新しいビューができるので, マップしたままにすると
+ * エディタの保存を妨げたり, 前のビューの変数名が書き換わったりする.
+ * そのときはヒープにコピーして, 変数名はsrc_namesに残す.
+ */
+char *open_src_view(const char *path, Status *status) {
+    size_t size = 0;
+    bool mapped = !status->watch_flag;
+    char *src = mapped ? src_map(path, &size) : src_read(path, &size);
+    if (IS_NULL(src)) {
+        return NULL;
+    }
+
+    add_src_view(src, size, mapped);
+    return src;
+}
+
+/* ヒープにコピーしたビューを捨てる. マップしたビューは変数名が指しているので残す */
+void close_src_view(char *src) {
+    if (IS_NULL(src_views) || IS_NULL(src)) {
+        return;
+    }
+
+    for (int64_t i = 0; i < src_views->length; i++) {
+        SrcView *view = (SrcView *)src_views->data[i];
+        if (view->src == src && !view->mapped) {
+            free(view->src);
+            free(view);
+            src_views->data[i] = src_views->data[--src_views->length];
+            return;
+        }
+    }
+}
+
+void free_src_views() {
+    free_map(src_names);
+    src_names = NULL;
+
+    if (IS_NULL(src_views)) {
+        return;
+    }
+
+    for (int64_t i = 0; i < src_views->length; i++) {
+        SrcView *view = (SrcView *)src_views->data[i];
+        if (view->mapped) {
+            src_unmap(view->src, view->size);
+        } else {
+            free(view->src);
+        }
+        free(view);
+    }
+    free_vector_ptr(src_views);
+    src_views = NULL;
+}
+
+static SrcView *find_src_view(char *str, size_t len) {
+    if (IS_NULL(src_views)) {
+        return NULL;
+    }
+
+    for (int64_t i = 0; i < src_views->length; i++) {
+        SrcView *view = (SrcView *)src_views->data[i];
+        if (view->src <= str && str + len <= view->src + view->size) {
+            return view;
+        }
+    }
+    return NULL;
+}
+
+/* 同じ名前は同じ場所にまとめるので, 何度読み直しても名前の種類の分しか増えない */
+static char *intern_src_name(char *str, size_t len) {
+    if (IS_NULL(src_names)) {
+        src_names = new_map();
+        if (IS_NULL(src_names)) {
+            oto_error(OTO_INTERNAL_ERROR);
+        }
+    }
+
+    char *s = (char *)map_intern(src_names, str, len);
+    if (IS_NULL(s)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+    return s;
+}
+
 static Token *new_token(tokencode_t tc,
                         char *str, size_t len, tokentype_t type) {
     Token *token = MYMALLOC1(Token);
@@ -47,6 +171,17 @@ static Token *new_token(tokencode_t tc,
     token->len  = len;
     token->type = type;
 
+    // ソースの中を指すので'\0'で終わらない. 長さはtoken->lenを使う
+    SrcView *view = find_src_view(str, len);
+    if (IS_NOT_NULL(view) && view->mapped) {
+        token->str = str;
+        return token;
+    }
+    if (IS_NOT_NULL(view)) {
+        token->str = intern_src_name(str, len);
+        return token;
+    }
+
     // '\0"の分1足す
     char *s = MYMALLOC(len + 1, char);
     if (IS_NULL(s)) {
@@ -59,19 +194,120 @@ static Token *new_token(tokencode_t tc,
     return token;
 }
 
-/* もし予約語でない場合は0を返す */
-static tokencode_t get_rsvword_tc(char *str, size_t len) {
-    int64_t i = 0;
-    while (rsvwords[i].str != NULL) {
-        // 予約語については大文字小文字を区別しない
-        if (is_str_equal_cs(str, len, rsvwords[i].str, rsvwords[i].len)) {
-            return rsvwords[i].tc;
+/**
+ * 予約語の完全ハッシュ表
+ *
+ * 予約語どうしが衝突しないシードを初期化時に探しておくので,
+ * 予約語がいくつあっても1回のハッシュ計算と1回の比較で引ける.
+ */
+#define RSVWORD_TABLE_SIZE 64  // 2の冪, 予約語の数の2倍以上
+#define RSVWORD_MAX_LEN    16
+
+static Token *rsvword_table[RSVWORD_TABLE_SIZE];
+static uint32_t rsvword_seed = 0;
+static bool rsvword_table_ready = false;
+
+/* 分岐なしでASCIIの大文字を小文字にする */
+static inline char fold_ascii(char ch) {
+    return ch | ((uint8_t)(ch - 'A') < 26) << 5;
+}
+
+static size_t hash_rsvword(const char *str, size_t len, uint32_t seed) {
+    uint32_t hash = seed ^ (uint32_t)len;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)str[i]) * 16777619u;
+    }
+    return (hash ^ (hash >> 16)) & (RSVWORD_TABLE_SIZE - 1);
+}
+
+static void init_rsvword_table() {
+    if (rsvword_table_ready) {
+        return;
+    }
+
+    for (uint32_t seed = 0; ; seed++) {
+        memset(rsvword_table, 0, sizeof(rsvword_table));
+
+        int64_t i = 0;
+        while (rsvwords[i].str != NULL) {
+            size_t h = hash_rsvword(rsvwords[i].str, rsvwords[i].len, seed);
+            if (IS_NOT_NULL(rsvword_table[h])) {
+                break;
+            }
+            rsvword_table[h] = &rsvwords[i];
+            i++;
         }
-        i++;
+
+        if (rsvwords[i].str == NULL) {
+            rsvword_seed = seed;
+            break;
+        }
+    }
+    rsvword_table_ready = true;
+}
+
+/* もし予約語でない場合は0を返す. init_var_listで表を作った後に使う */
+tokencode_t get_rsvword_tc(char *str, size_t len) {
+    if (len > RSVWORD_MAX_LEN) {
+        return 0;
+    }
+
+    // 予約語については大文字小文字を区別しない
+    char lower[RSVWORD_MAX_LEN];
+    for (size_t i = 0; i < len; i++) {
+        lower[i] = fold_ascii(str[i]);
+    }
+
+    Token *rsvword = rsvword_table[hash_rsvword(lower, len, rsvword_seed)];
+    if (IS_NOT_NULL(rsvword) && rsvword->len == len
+        && memcmp(rsvword->str, lower, len) == 0) {
+        return rsvword->tc;
     }
     return 0;
 }
 
+/**
+ * トークン文字列からトークンコードを引くための索引
+ *
+ * var_listに後から追加された変数は引くときにまとめて登録する.
+ * 同じ文字列が複数あるときは一番小さいトークンコードを返す.
+ */
+static struct {
+    Map *map;             // トークン文字列 -> トークンコード + 1
+    VectorPTR *var_list;  // 索引を作ったvar_list
+    int64_t synced;       // var_list->data[0, synced)を登録済み
+} symbol_index = {NULL, NULL, 0};
+
+static void free_symbol_index() {
+    free_map(symbol_index.map);
+    symbol_index.map      = NULL;
+    symbol_index.var_list = NULL;
+    symbol_index.synced   = 0;
+}
+
+/* var_listに追加された変数を索引に登録する */
+static void sync_symbol_index(VectorPTR *var_list) {
+    if (symbol_index.var_list != var_list || symbol_index.synced > var_list->length) {
+        free_symbol_index();
+        symbol_index.map = new_map();
+        if (IS_NULL(symbol_index.map)) {
+            oto_error(OTO_INTERNAL_ERROR);
+        }
+        symbol_index.var_list = var_list;
+    }
+
+    for (; symbol_index.synced < var_list->length; symbol_index.synced++) {
+        Token *token = ((Var *)var_list->data[symbol_index.synced])->token;
+        void **slot = map_get_or_insert(symbol_index.map, token->str, token->len, NULL);
+        if (IS_NULL(slot)) {
+            oto_error(OTO_INTERNAL_ERROR);
+        }
+        if (IS_NULL(*slot)) {
+            *slot = (void *)(symbol_index.synced + 1);
+        }
+    }
+}
+
 tokencode_t allocate_tc(char *str, size_t len, tokentype_t type, VectorPTR *var_list) {
     tokencode_t tc = get_rsvword_tc(str, len);
     if (tc != 0) {
@@ -79,29 +315,55 @@ tokencode_t allocate_tc(char *str, size_t len, tokentype_t type, VectorPTR *var_
         return tc;
     }
 
-    size_t tcs = var_list->length;
+    sync_symbol_index(var_list);
 
-    for (tc = 0; tc < tcs; tc++) {
-        size_t tl = ((Var *)var_list->data[tc])->token->len;
-        char *ts  = ((Var *)var_list->data[tc])->token->str;
-        if (len == tl && (strncmp(str, ts, len) == 0)) {
-            break;
-        }
+    void **slot = map_get_or_insert(symbol_index.map, str, len, NULL);
+    if (IS_NULL(slot)) {
+        oto_error(OTO_INTERNAL_ERROR);
     }
 
-    if (tc == tcs) {
+    if (IS_NOT_NULL(*slot)) {
+
+        tc = (tokencode_t)*slot - 1;
+    } else {
         // 新規作成時の処理
+        tc = var_list->length;
         Token *token = new_token(tc, str, len, type);
         if (IS_NULL(token)) {
             // Error
             oto_error(OTO_INTERNAL_ERROR);
         }
         add_new_variable(var_list, token);
+
+        *slot = (void *)(tc + 1);
+        symbol_index.synced++;
     }
 
     return tc;
 }
 
+#define LITERAL_BUF_SIZE 64
+
+/* token->strは'\0'で終わらないので, 長さの分だけコピーしてから数値にする */
+static double literal_value(const Token *token) {
+    char buf[LITERAL_BUF_SIZE];
+    char *s = buf;
+    if (token->len >= LITERAL_BUF_SIZE) {
+        s = MYMALLOC(token->len + 1, char);
+        if (IS_NULL(s)) {
+            oto_error(OTO_INTERNAL_ERROR);
+        }
+    }
+    memcpy(s, token->str, token->len);
+    s[token->len] = '\0';
+
+    double value = strtod(s, NULL);
+    if (s != buf) {
+        free(s);
+    }
+    return value;
+}
+
 static Var *new_variable(Token *token, vartype_t type) {
     Var *var = MYMALLOC1(Var);
     if (IS_NULL(var)) {
@@ -146,7 +408,7 @@ void add_new_variable(VectorPTR *var_list, Token *new_token) {
     }
 
     if (new_token->type == TK_TY_LITERAL) {
-        new_var->value.f = strtod(new_token->str, 0);
+        new_var->value.f = literal_value(new_token);
     
     } else if (new_token->type == TK_TY_STRING) {
         String *s = MYMALLOC1(String);
@@ -181,35 +443,46 @@ void init_var_list(VectorPTR *var_list) {
         add_new_variable(var_list, &rsvwords[i]);
         i++;
     }
+
+    init_rsvword_table();
 }
 
 #define IS_HEAP_TYPE(type) \
     (type == TY_ARRAY || type == TY_STRING || type == TY_OSCIL || \
      type == TY_SOUND || type == TY_FILTER)
 
+/**
+ * begin以降の変数を未定義に戻す. トークンコードはそのまま使い続ける
+ *
+ * Sound, Oscillator, Filter, Arrayは呼び出し側でreset_region()する.
+ */
+void reset_var_values(VectorPTR *var_list, int64_t begin) {
+    for (int64_t i = begin; i < var_list->length; i++) {
+        Var *var = (Var *)var_list->data[i];
+        if (var->token->type == TK_TY_VARIABLE) {
+            var->type    = TY_VOID;
+            var->value.i = 0;
+        }
+    }
+}
+
 void free_var_list(VectorPTR *var_list) {
     if (IS_NULL(var_list)) {
         return;
     }
 
+    if (symbol_index.var_list == var_list) {
+        free_symbol_index();
+    }
+
     int64_t i = 0;
     while (i < var_list->length) {
         Var *var = ((Var *)var_list->data[i]);
 
-        if (var->type == TY_SOUND) {
-            free_items_vector_ptr(((Sound *)(var->value.p))->filters);
-            free(((Sound *)(var->value.p))->filters);
-            free(var->value.p);
-        } else if (var->type == TY_OSCIL) {
-            free(var->value.p);
-        } else if (var->type == TY_FILTER) {
-            free(var->value.p);
-        } else if (var->type == TY_STRING) {
+        // Sound, Oscillator, Filter, Arrayはfree_region()でまとめて解放する
+        if (var->type == TY_STRING) {
             free(((String *)(var->value.p))->str);
             free(var->value.p);
-        } else if (var->type == TY_ARRAY) {
-            free(((Array *)(var->value.p))->data);
-            free(var->value.p);
         }
         
         free(var);
@@ -0,0 +1,90 @@
+#include <oto/oto_util.h>
+
+#define ARENA_ALIGN 16
+
+/* 領域の一塊. 足りなくなったら次の塊を繋げる */
+struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t used;
+    size_t size;
+    _Alignas(ARENA_ALIGN) uint8_t data[];
+};
+
+static struct ArenaBlock *new_arena_block(size_t size) {
+    struct ArenaBlock *block = (struct ArenaBlock *)malloc(sizeof(struct ArenaBlock) + size);
+    if (IS_NULL(block)) {
+        return NULL;
+    }
+    block->next = NULL;
+    block->used = 0;
+    block->size = size;
+
+    return block;
+}
+
+Arena *new_arena(size_t block_size) {
+    Arena *arena = MYMALLOC1(Arena);
+    if (IS_NULL(arena)) {
+        return NULL;
+    }
+
+    arena->block_size = block_size;
+    arena->head = new_arena_block(block_size);
+    if (IS_NULL(arena->head)) {
+        free(arena);
+        return NULL;
+    }
+    arena->cur = arena->head;
+
+    return arena;
+}
+
+void free_arena(Arena *arena) {
+    if (IS_NULL(arena)) {
+        return;
+    }
+
+    struct ArenaBlock *block = arena->head;
+    while (IS_NOT_NULL(block)) {
+        struct ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    // 今の塊に入らなければ, 後ろの塊から入るものを探す
+    struct ArenaBlock *block = arena->cur;
+    while (block->used + size > block->size) {
+        if (IS_NULL(block->next)) {
+            size_t block_size = arena->block_size;
+            if (size > block_size) {
+                block_size = size;
+            }
+            block->next = new_arena_block(block_size);
+            if (IS_NULL(block->next)) {
+                return NULL;
+            }
+        }
+        block = block->next;
+    }
+    arena->cur = block;
+
+    void *p = &block->data[block->used];
+    block->used += size;
+
+    // MYMALLOC(calloc)と同じく0で埋めておく
+    memset(p, 0, size);
+    return p;
+}
+
+void arena_reset(Arena *arena) {
+    // 塊は解放せずに使い回す
+    for (struct ArenaBlock *block = arena->head; IS_NOT_NULL(block); block = block->next) {
+        block->used = 0;
+    }
+    arena->cur = arena->head;
+}
@@ -1,6 +1,15 @@
 #include <oto/oto_util.h>
 
-#define DEFAULT_MAX_MAP_CAPACITY 100
+#define DEFAULT_MAX_MAP_CAPACITY 128     // 2の冪
+#define MAP_POOL_CHUNK_SIZE      4096
+
+/* キーの文字列をまとめて置いておく領域 */
+struct MapPool {
+    struct MapPool *next;
+    size_t used;
+    size_t size;
+    char data[];
+};
 
 Map *new_map() {
     Map *map = MYMALLOC1(Map);
@@ -8,96 +17,228 @@ Map *new_map() {
         return NULL;
     }
 
-    map->keys = new_vector_ptr(DEFAULT_MAX_MAP_CAPACITY);
-    map->vals = new_vector_ptr(DEFAULT_MAX_MAP_CAPACITY);
-    if (IS_NULL(map->keys) || IS_NULL(map->vals)) {
-        free_map(map);
+    map->entries = MYMALLOC(DEFAULT_MAX_MAP_CAPACITY, MapEntry);
+    if (IS_NULL(map->entries)) {
+        free(map);
         return NULL;
     }
+    map->capacity = DEFAULT_MAX_MAP_CAPACITY;
+    map->length   = 0;
+    map->pool     = NULL;
 
     return map;
 }
 
 void free_map(Map *map) {
-    free_vector_ptr(map->keys);
-    map->keys = NULL;
-    
-    free_vector_ptr(map->vals);
-    map->vals = NULL;
+    if (IS_NULL(map)) {
+        return;
+    }
+
+    struct MapPool *pool = map->pool;
+    while (IS_NOT_NULL(pool)) {
+        struct MapPool *next = pool->next;
+        free(pool);
+        pool = next;
+    }
+    map->pool = NULL;
+
+    free(map->entries);
+    map->entries = NULL;
 
     free(map);
 }
 
-void map_put(Map *map, char *key, void *val) {
-    vector_ptr_append(map->keys, key);
-    vector_ptr_append(map->vals, val);
+/* キーの文字列をプールにコピーする */
+static char *intern_key(Map *map, const char *key, size_t keylen) {
+    struct MapPool *pool = map->pool;
+    if (IS_NULL(pool) || pool->used + keylen + 1 > pool->size) {
+        // 長いキーは専用の領域に置き, 先頭の領域はそのまま使い続ける
+        bool large = keylen + 1 > MAP_POOL_CHUNK_SIZE / 4;
+        size_t size = large ? keylen + 1 : MAP_POOL_CHUNK_SIZE;
+
+        pool = (struct MapPool *)malloc(sizeof(struct MapPool) + size);
+        if (IS_NULL(pool)) {
+            return NULL;
+        }
+        pool->used = 0;
+        pool->size = size;
+
+        if (large && IS_NOT_NULL(map->pool)) {
+            pool->next = map->pool->next;
+            map->pool->next = pool;
+        } else {
+            pool->next = map->pool;
+            map->pool = pool;
+        }
+    }
+
+    char *s = &pool->data[pool->used];
+    memcpy(s, key, keylen);
+    s[keylen] = '\0';
+    pool->used += keylen + 1;
+
+    return s;
 }
 
-void map_puti(Map *map, char *key, int64_t val) {
-    vector_ptr_append(map->keys, key);
-    vector_ptr_append(map->vals, (void *)val);
+/* キーのある位置を返す. なければ空いている位置 */
+static int64_t find_entry(Map *map, const char *key, size_t keylen, uint64_t hash) {
+    int64_t mask = map->capacity - 1;
+    int64_t i = (int64_t)(hash & mask);
+
+    while (IS_NOT_NULL(map->entries[i].key)) {
+        MapEntry *entry = &map->entries[i];
+        if (entry->hash == hash && entry->keylen == keylen
+            && memcmp(entry->key, key, keylen) == 0) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return i;
 }
 
-void *map_get(Map *map, char *key) {
-    for (int64_t i = 0; i < map->keys->length; i++) {
-        if (strcmp(map->keys->data[i], key) == 0) {
-            return map->vals->data[i];
+static bool map_grow(Map *map) {
+    MapEntry *old_entries = map->entries;
+    int64_t old_capacity = map->capacity;
+
+    MapEntry *entries = MYMALLOC(old_capacity * 2, MapEntry);
+    if (IS_NULL(entries)) {
+        return false;
+    }
+    map->entries  = entries;
+    map->capacity = old_capacity * 2;
+
+    for (int64_t i = 0; i < old_capacity; i++) {
+        if (IS_NOT_NULL(old_entries[i].key)) {
+            int64_t idx = find_entry(map, old_entries[i].key, old_entries[i].keylen, old_entries[i].hash);
+            map->entries[idx] = old_entries[i];
         }
     }
-    return NULL;
+    free(old_entries);
+
+    return true;
 }
 
-int64_t map_geti(Map *map, char *key) {
-    for (int64_t i = 0; i < map->keys->length; i++) {
-        if (strcmp(map->keys->data[i], key) == 0) {
-            return (int64_t)map->vals->data[i];
+static MapEntry *get_or_insert_entry(Map *map, const char *key, size_t keylen, bool *found) {
+    uint64_t hash = hash_fnv1a(key, keylen, FNV1A_OFFSET_BASIS);
+    int64_t idx = find_entry(map, key, keylen, hash);
+
+    if (IS_NOT_NULL(map->entries[idx].key)) {
+        if (IS_NOT_NULL(found)) {
+            *found = true;
+        }
+        return &map->entries[idx];
+    }
+
+    // 使用率を1/2以下に保つ
+    if ((map->length + 1) * 2 > map->capacity) {
+        if (!map_grow(map)) {
+            return NULL;
         }
+        idx = find_entry(map, key, keylen, hash);
+    }
+
+    char *s = intern_key(map, key, keylen);
+    if (IS_NULL(s)) {
+        return NULL;
     }
-    return 0;
+
+    MapEntry *entry = &map->entries[idx];
+    entry->key    = s;
+    entry->keylen = keylen;
+    entry->hash   = hash;
+    entry->val    = NULL;
+    map->length++;
+
+    if (IS_NOT_NULL(found)) {
+        *found = false;
+    }
+    return entry;
+}
+
+void **map_get_or_insert(Map *map, const char *key, size_t keylen, bool *found) {
+    MapEntry *entry = get_or_insert_entry(map, key, keylen, found);
+    if (IS_NULL(entry)) {
+        return NULL;
+    }
+    return &entry->val;
+}
+
+void **map_lookup(Map *map, const char *key, size_t keylen) {
+    uint64_t hash = hash_fnv1a(key, keylen, FNV1A_OFFSET_BASIS);
+    int64_t idx = find_entry(map, key, keylen, hash);
+
+    if (IS_NULL(map->entries[idx].key)) {
+        return NULL;
+    }
+    return &map->entries[idx].val;
 }
 
-static int64_t map_get_idx(Map *map, char *key) {
-    for (int64_t i = 0; i < map->keys->length; i++) {
-        if (strcmp(map->keys->data[i], key) == 0) {
-            return i;
+const char *map_intern(Map *map, const char *key, size_t keylen) {
+    MapEntry *entry = get_or_insert_entry(map, key, keylen, NULL);
+    if (IS_NULL(entry)) {
+        return NULL;
+    }
+    return entry->key;
+}
+
+MapEntry *map_next(Map *map, int64_t *iter) {
+    while (*iter < map->capacity) {
+        MapEntry *entry = &map->entries[*iter];
+        (*iter)++;
+        if (IS_NOT_NULL(entry->key)) {
+            return entry;
         }
     }
-    return -1;
+    return NULL;
 }
 
-bool map_exist_key(Map *map, char *key) {
-    int64_t idx = map_get_idx(map, key);
-    if (idx == -1) {
-        return false;
+void map_put(Map *map, char *key, void *val) {
+    void **slot = map_get_or_insert(map, key, strlen(key), NULL);
+    if (IS_NOT_NULL(slot)) {
+        *slot = val;
     }
-    return true;
+}
+
+void map_puti(Map *map, char *key, int64_t val) {
+    map_put(map, key, (void *)val);
+}
+
+void *map_get(Map *map, char *key) {
+    void **slot = map_lookup(map, key, strlen(key));
+    if (IS_NULL(slot)) {
+        return NULL;
+    }
+    return *slot;
+}
+
+int64_t map_geti(Map *map, char *key) {
+    return (int64_t)map_get(map, key);
+}
+
+bool map_exist_key(Map *map, char *key) {
+    return IS_NOT_NULL(map_lookup(map, key, strlen(key)));
 }
 
 void map_inc_val(Map *map, char *key) {
-    int64_t idx = map_get_idx(map, key);
-    if (idx < 0) {
+    void **slot = map_lookup(map, key, strlen(key));
+    if (IS_NULL(slot)) {
         return;
     }
-    
-    int64_t new_data = (int64_t)map->vals->data[idx] + 1;
-    map->vals->data[idx] = (void *)new_data;
+    *slot = (void *)((int64_t)*slot + 1);
 }
 
 void map_dec_val(Map *map, char *key) {
-    int64_t idx = map_get_idx(map, key);
-    if (idx < 0) {
+    void **slot = map_lookup(map, key, strlen(key));
+    if (IS_NULL(slot)) {
         return;
     }
-    
-    int64_t new_data = (int64_t)map->vals->data[idx] - 1;
-    map->vals->data[idx] = (void *)new_data;
+    *slot = (void *)((int64_t)*slot - 1);
 }
 
 void map_printi(Map *map) {
-    for (int64_t i = 0; i < map->keys->length; i++) {
-        printf("%s : %I64d\n",
-            (char *)map->keys->data[i],
-            (int64_t)map->vals->data[i]
-        );
+    int64_t iter = 0;
+    MapEntry *entry = NULL;
+    while (IS_NOT_NULL(entry = map_next(map, &iter))) {
+        printf("%s : %I64d\n", entry->key, (int64_t)entry->val);
     }
 }
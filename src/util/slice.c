@@ -1,5 +1,27 @@
 #include <oto/oto_util.h>
 
+static void set_slice_i64(SliceI64 *slice, VectorI64 *vec, int64_t start, int64_t end) {
+    slice->data = &(vec->data[start]);
+    slice->abs_idx = start;
+
+    if (end > vec->length) {
+        slice->length = vec->length;
+    } else {
+        slice->length = end - start;
+    }
+}
+
+static void set_slice_i64_from_slice(SliceI64 *slice, SliceI64 *org_slice, int64_t start, int64_t end) {
+    slice->data = &(org_slice->data[start]);
+    slice->abs_idx = org_slice->abs_idx + start;
+
+    if (end > org_slice->length) {
+        slice->length = org_slice->length;
+    } else {
+        slice->length = end - start;
+    }
+}
+
 SliceI64 *new_slice_i64(VectorI64 *vec, int64_t start, int64_t end) {
     if (IS_NULL(vec)) {
         return NULL;
@@ -11,14 +33,7 @@ SliceI64 *new_slice_i64(VectorI64 *vec, int64_t start, int64_t end) {
     if (IS_NULL(slice)) {
         return NULL;
     }
-    slice->data = &(vec->data[start]);
-    slice->abs_idx = start;
-
-    if (end > vec->length) {
-        slice->length = vec->length;
-    } else {
-        slice->length = end - start;
-    }
+    set_slice_i64(slice, vec, start, end);
 
     return slice;
 }
@@ -32,14 +47,37 @@ SliceI64 *new_slice_i64_from_slice(SliceI64 *org_slice, int64_t start, int64_t e
     if (IS_NULL(slice)) {
         return NULL;
     }
-    slice->data = &(org_slice->data[start]);
-    slice->abs_idx = org_slice->abs_idx + start;
+    set_slice_i64_from_slice(slice, org_slice, start, end);
 
-    if (end > org_slice->length) {
-        slice->length = org_slice->length;
-    } else {
-        slice->length = end - start;
+    return slice;
+}
+
+SliceI64 *arena_slice_i64(Arena *arena, VectorI64 *vec, int64_t start, int64_t end) {
+    if (IS_NULL(vec)) {
+        return NULL;
+    } else if (start > end) {
+        return NULL;
+    }
+
+    SliceI64 *slice = ARENA_ALLOC(arena, 1, SliceI64);
+    if (IS_NULL(slice)) {
+        return NULL;
+    }
+    set_slice_i64(slice, vec, start, end);
+
+    return slice;
+}
+
+SliceI64 *arena_slice_i64_from_slice(Arena *arena, SliceI64 *org_slice, int64_t start, int64_t end) {
+    if (IS_NULL(org_slice)) {
+        return NULL;
+    }
+
+    SliceI64 *slice = ARENA_ALLOC(arena, 1, SliceI64);
+    if (IS_NULL(slice)) {
+        return NULL;
     }
+    set_slice_i64_from_slice(slice, org_slice, start, end);
 
     return slice;
 }
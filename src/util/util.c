@@ -1,4 +1,5 @@
 #include <oto/oto_util.h>
+#include <windows.h>
 
 static FILE *open_file(const char *path) {
     FILE *fp = fopen(path, "r");
@@ -62,6 +63,129 @@ char *src_open(const char *path) {
     return src;
 }
 
+/**
+ * ビューはページ単位でマップされ, ファイルの後ろの余りは0で埋まっている.
+ * サイズがちょうどページの倍数のときだけ'\0'を置く場所がないのでコピーする
+ */
+#define SRC_PAGE_SIZE 4096
+
+char *src_map(const char *path, size_t *size) {
+    size_t fsize = 0;
+    char *map = (char *)mmap_file(path, &fsize);
+    if (IS_NULL(map)) {
+        return NULL;
+    }
+
+    char *src = map;
+    if (fsize % SRC_PAGE_SIZE == 0) {
+        src = MYMALLOC(fsize + 1, char);
+        if (IS_NOT_NULL(src)) {
+            memcpy(src, map, fsize);
+        }
+        munmap_file(map);
+        if (IS_NULL(src)) {
+            return NULL;
+        }
+    }
+
+#ifdef DEBUG
+    printf("Source file info\n");
+    printf("name : %s, size : %I64d bytes (mapped)\n\n", path, fsize);
+#endif
+
+    *size = fsize;
+    return src;
+}
+
+/**
+ * ソースをヒープにコピーして読み込む. 終端には'\0'がある (失敗したらNULL)
+ * マップしたままにしないので, 読み込んだ後にファイルを書き換えても内容は変わらない
+ */
+char *src_read(const char *path, size_t *size) {
+    size_t fsize = 0;
+    char *map = (char *)mmap_file(path, &fsize);
+    if (IS_NULL(map)) {
+        return NULL;
+    }
+
+    char *src = MYMALLOC(fsize + 1, char);
+    if (IS_NOT_NULL(src)) {
+        memcpy(src, map, fsize);
+    }
+    munmap_file(map);
+    if (IS_NULL(src)) {
+        return NULL;
+    }
+
+    *size = fsize;
+    return src;
+}
+
+void src_unmap(char *src, size_t size) {
+    if (size % SRC_PAGE_SIZE == 0) {
+        free(src);
+    } else {
+        munmap_file(src);
+    }
+}
+
+void *mmap_file(const char *path, size_t *size) {
+    if (IS_NULL(path)) {
+        return NULL;
+    }
+
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+
+    LARGE_INTEGER fsize;
+    if (!GetFileSizeEx(file, &fsize) || fsize.QuadPart == 0) {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    // ビューがマッピングを保持するのでハンドルはすぐに閉じてよい
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (IS_NULL(mapping)) {
+        return NULL;
+    }
+
+    void *addr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (IS_NULL(addr)) {
+        return NULL;
+    }
+
+    *size = (size_t)fsize.QuadPart;
+    return addr;
+}
+
+void munmap_file(void *addr) {
+    if (IS_NOT_NULL(addr)) {
+        UnmapViewOfFile(addr);
+    }
+}
+
+bool get_file_stamp(const char *path, FileStamp *stamp) {
+    if (IS_NULL(path)) {
+        return false;
+    }
+
+    WIN32_FILE_ATTRIBUTE_DATA attr;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &attr)) {
+        return false;
+    }
+
+    stamp->mtime = ((int64_t)attr.ftLastWriteTime.dwHighDateTime << 32)
+                   | attr.ftLastWriteTime.dwLowDateTime;
+    stamp->size  = ((int64_t)attr.nFileSizeHigh << 32) | attr.nFileSizeLow;
+
+    return true;
+}
+
 bool is_otofile(const char *path) {
     const char *ext = strrchr(path, '.');
 
@@ -181,4 +305,14 @@ char *new_string_literal(char *src, int64_t idx) {
     strncpy(str, &src[idx], len);
 
     return str;
-}
\ No newline at end of file
+}
+
+/* FNV-1a (64bit) */
+uint64_t hash_fnv1a(const void *data, size_t len, uint64_t hash) {
+    const uint8_t *p = (const uint8_t *)data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= FNV1A_PRIME;
+    }
+    return hash;
+}
@@ -3,248 +3,478 @@
 #define VAR(tc)  ((Var *)(ic_list->data[tc]))
 #define IS_JUST_ZERO(val) (val & 0xffffffff) == 0
 
-void exec(VectorPTR *ic_list, VectorPTR *var_list, Status *status) {
-    int64_t i = 0;
-    int64_t end = ic_list->length;
+/* 内部コード中のLOOP命令の数だけループカウンタとJIT用の領域を用意する */
+static void init_frame(Frame *frame, const VectorPTR *ic_list,
+                       VectorPTR *var_list, Status *status) {
+    frame->ic_list  = ic_list;
+    frame->var_list = var_list;
+    frame->status   = status;
+
+    frame->loop_num = 0;
+    bool has_call = false;
+    for (int64_t i = 0; i < ic_list->length; i += 5) {
+        if ((opcode_t)ic_list->data[i] == OP_LOOP
+            && (int64_t)VAR(i + 3) >= frame->loop_num) {
+            frame->loop_num = (int64_t)VAR(i + 3) + 1;
+        } else if ((opcode_t)ic_list->data[i] == OP_CALL) {
+            has_call = true;
+        }
+    }
 
-    double  tmpf  = 0;
-    int64_t tmpi1 = 0;
-    int64_t tmpi2 = 0;
+    // 再帰した関数の中のLOOPが呼び出し元のカウンタを壊さないように,
+    // CALLがあるときは呼び出しの深さごとに別のカウンタを使う
+    // (loop_numが0でもNULLにならないように+1)
+    int64_t depth_num = has_call ? FUNC_CALL_DEPTH + 1 : 1;
+    frame->loop_cnts_buf = MYMALLOC(frame->loop_num * depth_num + 1, int64_t);
+    frame->loop_cnts = frame->loop_cnts_buf;
+    frame->loop_hits = MYMALLOC(frame->loop_num + 1, int64_t);
+    frame->jit_codes = MYMALLOC(frame->loop_num + 1, JitCode *);
+    if (IS_NULL(frame->loop_cnts) || IS_NULL(frame->loop_hits)
+        || IS_NULL(frame->jit_codes)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
 
-    init_synth();
+    // 呼び出しごとにmallocしないように最大の深さの分を確保しておく
+    frame->ret_addrs  = NULL;
+    frame->saved_vars = NULL;
+    frame->args       = NULL;
+    frame->call_depth = 0;
+    frame->saved_num  = 0;
+    if (has_call) {
+        frame->ret_addrs  = MYMALLOC(FUNC_CALL_DEPTH, int64_t);
+        frame->saved_vars = MYMALLOC(FUNC_CALL_DEPTH * FUNC_MAX_PARAMS, SavedVar);
+        frame->args       = MYMALLOC(FUNC_MAX_PARAMS, VarValue);
+        if (IS_NULL(frame->ret_addrs) || IS_NULL(frame->saved_vars)
+            || IS_NULL(frame->args)) {
+            oto_error(OTO_INTERNAL_ERROR);
+        }
+    }
+}
 
-    while (i < end) {
-        #ifdef DEBUG
-            printf("PC : %I64d\n", i);
-        #endif
-        
-        switch ((opcode_t)ic_list->data[i]) {
-        case OP_CPYD:
-            if (VAR(i + 2)->type == TY_FLOAT || VAR(i + 2)->type == TY_CONST) {
-                VAR(i + 1)->type = TY_FLOAT;
-                VAR(i + 1)->value.f = VAR(i + 2)->value.f;
-            } else if (VAR(i + 2)->type == TY_STRING) {
-                VAR(i + 1)->type = TY_STRING;
-                VAR(i + 1)->value.p = VAR(i + 2)->value.p;
-            }
+/* 中身はexec()のたびにinit_frame()で用意する. 確保できなければNULLを返す */
+Frame *new_frame() {
+    return MYMALLOC1(Frame);
+}
 
-            break;
+/**
+ * exec()が確保した領域を解放する
+ * エラーでexec()の外へ抜けたときは呼び出し側がこれで解放する.
+ */
+void release_frame(Frame *frame) {
+    // init_frame()の途中でエラーになったときは確保できていない領域がある
+    for (int64_t i = 0; IS_NOT_NULL(frame->jit_codes) && i < frame->loop_num; i++) {
+        jit_free(frame->jit_codes[i]);
+    }
+    free(frame->jit_codes);
+    free(frame->loop_hits);
+    free(frame->loop_cnts_buf);
+    free(frame->ret_addrs);
+    free(frame->saved_vars);
+    free(frame->args);
+    frame->jit_codes = NULL;
+    frame->loop_hits = NULL;
+    frame->loop_cnts = NULL;
+    frame->loop_cnts_buf = NULL;
+    frame->ret_addrs  = NULL;
+    frame->saved_vars = NULL;
+    frame->args       = NULL;
+}
 
-        case OP_CPYP:
-            if (vmstack_typecheck() == VM_TY_VARPTR) {
-                tmpf = vmstack_popv()->value.f;
-            } else if (vmstack_typecheck() == VM_TY_IMMEDIATE) {
-                tmpf = vmstack_popf();
-            }
-            VAR(i + 1)->type    = TY_FLOAT;
-            VAR(i + 1)->value.f = tmpf;
-            break;
-
-        case OP_PUSH:
-            vmstack_pushv(VAR(i + 1));
-            break;
-
-        case OP_PUSH_INITVAL:
-            vmstack_push_initval();
-            break;
-
-        case OP_ADD:
-        case OP_SUB:
-        case OP_MUL:
-        case OP_DIV:
-        case OP_MOD:
-        case OP_AND:
-        case OP_OR:
-        case OP_EQ:
-        case OP_NEQ:
-        case OP_LTCMP:
-        case OP_LTEQCMP:
-        case OP_RICMP:
-        case OP_RIEQCMP:
-            alu((opcode_t)ic_list->data[i]);
-            break;
-
-        case OP_ADD2:
-            VAR(i + 1)->type    = TY_FLOAT;
-            VAR(i + 1)->value.f = VAR(i + 2)->value.f + VAR(i + 3)->value.f;
-            break;
-
-        case OP_SUB2:
-            VAR(i + 1)->type    = TY_FLOAT;
-            VAR(i + 1)->value.f = VAR(i + 2)->value.f - VAR(i + 3)->value.f;
-            break;
-
-        case OP_MUL2:
-            VAR(i + 1)->type    = TY_FLOAT;
-            VAR(i + 1)->value.f = VAR(i + 2)->value.f * VAR(i + 3)->value.f;
-            break;
-
-        case OP_DIV2:
-            if (is_just_zero(VAR(i + 3)->value.f)) {
-                oto_error(OTO_ZERO_DIVISION_ERROR);
-            }
-            VAR(i + 1)->type    = TY_FLOAT;
-            VAR(i + 1)->value.f = VAR(i + 2)->value.f / VAR(i + 3)->value.f;
-            break;
+void free_frame(Frame *frame) {
+    if (IS_NULL(frame)) {
+        return;
+    }
+    release_frame(frame);
+    free(frame);
+}
 
-        case OP_MOD2:
-            if ((int64_t)VAR(i + 3)->value.f == 0) {
-                oto_error(OTO_ZERO_DIVISION_ERROR);
-            }
-            VAR(i + 1)->type    = TY_FLOAT;
-            VAR(i + 1)->value.f = 
-                (int64_t)VAR(i + 2)->value.f % (int64_t)VAR(i + 3)->value.f;
-            break;
+/* 引数を取り出して関数の先頭へのジャンプ先を返す */
+static int64_t call_func(Frame *frame, int64_t addr, int64_t argc, int64_t ret_addr) {
+    if (frame->call_depth >= FUNC_CALL_DEPTH) {
+        oto_error(OTO_STACK_OVERFLOW_ERROR);
+    }
 
-        case OP_LOOP:
-            tmpi1 = (int64_t)ic_list->data[i + 3];
-            tmpi1++;
-            ic_list->data[i + 3] = (void *)tmpi1;
+    // f[b, a]のように引数同士を入れ替えても壊れないように先に値にしておく
+    for (int64_t i = argc - 1; i >= 0; i--) {
+        if (vmstack_typecheck() == VM_TY_VARPTR) {
+            Var *var = vmstack_popv();
+            frame->args[i].value = var->value;
+            frame->args[i].type  = var->type;
+        } else if (vmstack_typecheck() == VM_TY_IMMEDIATE) {
+            frame->args[i].value.f = vmstack_popf();
+            frame->args[i].type    = TY_FLOAT;
+        } else {
+            oto_error(OTO_MISSING_ARGUMENTS_ERROR);
+        }
+    }
 
-            tmpi2 = (int64_t)VAR(i + 2)->value.f;
+    frame->ret_addrs[frame->call_depth++] = ret_addr;
+    // 関数の中のLOOPは抜けるときにカウンタを0に戻すので, 次の深さの分は0になっている
+    frame->loop_cnts += frame->loop_num;
+    return addr;
+}
 
-            if (tmpi1 > tmpi2) {
-                // ループカウンタを初期化する
-                ic_list->data[i + 3] = 0;
+static void bind_param(Frame *frame, Var *param, int64_t n) {
+    if (frame->saved_num >= FUNC_CALL_DEPTH * FUNC_MAX_PARAMS) {
+        oto_error(OTO_STACK_OVERFLOW_ERROR);
+    }
 
-                i = (int64_t)VAR(i + 1);
-                continue;
-            }
-            break;
+    SavedVar *saved = &frame->saved_vars[frame->saved_num++];
+    saved->var = param;
+    saved->saved.value = param->value;
+    saved->saved.type  = param->type;
 
-        case OP_JMP:
-            i = (int64_t)VAR(i + 1);
-            continue;
+    param->value = frame->args[n].value;
+    param->type  = frame->args[n].type;
+}
 
-        case OP_JZ:
-            tmpi1 = vmstack_popi();
-            if (tmpi1 == 0) {
-                i = (int64_t)VAR(i + 1);
-                continue;
-            }
-            break;
+/* 引数の変数を元に戻して戻り先を返す */
+static int64_t return_func(Frame *frame, int64_t argc) {
+    for (int64_t i = 0; i < argc; i++) {
+        SavedVar *saved = &frame->saved_vars[--frame->saved_num];
+        saved->var->value = saved->saved.value;
+        saved->var->type  = saved->saved.type;
+    }
 
-        case OP_JNZ:
-            tmpi1 = vmstack_popi();
-            if (tmpi1 != 0) {
-                i = (int64_t)VAR(i + 1);
-                continue;
-            }
-            break;
+    frame->loop_cnts -= frame->loop_num;
+    return frame->ret_addrs[--frame->call_depth];
+}
+
+/**
+ * 命令を1つ実行して次に実行する命令の位置を返す
+ * EXIT命令ならEXEC_EXITを返す
+ */
+int64_t exec_instr(Frame *frame, int64_t i) {
+    const VectorPTR *ic_list = frame->ic_list;
+    VectorPTR *var_list = frame->var_list;
+    Status *status = frame->status;
+
+    double  tmpf  = 0;
+    int64_t tmpi1 = 0;
+    int64_t tmpi2 = 0;
+
+    switch ((opcode_t)ic_list->data[i]) {
+    case OP_CPYD:
+        if (VAR(i + 2)->type == TY_FLOAT || VAR(i + 2)->type == TY_CONST) {
+            VAR(i + 1)->type = TY_FLOAT;
+            VAR(i + 1)->value.f = VAR(i + 2)->value.f;
+        } else if (VAR(i + 2)->type == TY_STRING) {
+            VAR(i + 1)->type = TY_STRING;
+            VAR(i + 1)->value.p = VAR(i + 2)->value.p;
+        }
+
+        break;
+
+    case OP_CPYP:
+        if (vmstack_typecheck() == VM_TY_VARPTR) {
+            tmpf = vmstack_popv()->value.f;
+        } else if (vmstack_typecheck() == VM_TY_IMMEDIATE) {
+            tmpf = vmstack_popf();
+        }
+        VAR(i + 1)->type    = TY_FLOAT;
+        VAR(i + 1)->value.f = tmpf;
+        break;
+
+    case OP_PUSH:
+        vmstack_pushv(VAR(i + 1));
+        break;
+
+    case OP_PUSH_INITVAL:
+        vmstack_push_initval();
+        break;
+
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_MOD:
+    case OP_AND:
+    case OP_OR:
+    case OP_EQ:
+    case OP_NEQ:
+    case OP_LTCMP:
+    case OP_LTEQCMP:
+    case OP_RICMP:
+    case OP_RIEQCMP:
+        alu((opcode_t)ic_list->data[i]);
+        break;
+
+    case OP_ADD2:
+        VAR(i + 1)->type    = TY_FLOAT;
+        VAR(i + 1)->value.f = VAR(i + 2)->value.f + VAR(i + 3)->value.f;
+        break;
+
+    case OP_SUB2:
+        VAR(i + 1)->type    = TY_FLOAT;
+        VAR(i + 1)->value.f = VAR(i + 2)->value.f - VAR(i + 3)->value.f;
+        break;
+
+    case OP_MUL2:
+        VAR(i + 1)->type    = TY_FLOAT;
+        VAR(i + 1)->value.f = VAR(i + 2)->value.f * VAR(i + 3)->value.f;
+        break;
+
+    case OP_DIV2:
+        if (is_just_zero(VAR(i + 3)->value.f)) {
+            oto_error(OTO_ZERO_DIVISION_ERROR);
+        }
+        VAR(i + 1)->type    = TY_FLOAT;
+        VAR(i + 1)->value.f = VAR(i + 2)->value.f / VAR(i + 3)->value.f;
+        break;
+
+    case OP_MOD2:
+        if ((int64_t)VAR(i + 3)->value.f == 0) {
+            oto_error(OTO_ZERO_DIVISION_ERROR);
+        }
+        VAR(i + 1)->type    = TY_FLOAT;
+        VAR(i + 1)->value.f = 
+            (int64_t)VAR(i + 2)->value.f % (int64_t)VAR(i + 3)->value.f;
+        break;
+
+    case OP_LOOP:
+        tmpi1 = ++frame->loop_cnts[(int64_t)VAR(i + 3)];
+        tmpi2 = (int64_t)VAR(i + 2)->value.f;
+
+        if (tmpi1 > tmpi2) {
+            // ループカウンタを初期化する
+            frame->loop_cnts[(int64_t)VAR(i + 3)] = 0;
+
+            return (int64_t)VAR(i + 1);
+        }
+        break;
 
-        case OP_OSCILDEF:
-            VAR(i + 1)->type = TY_OSCIL;
-            if (VAR(i + 3) == NULL) {
+    case OP_JMP:
+        return (int64_t)VAR(i + 1);
+
+    case OP_JZ:
+        tmpi1 = vmstack_popi();
+        if (tmpi1 == 0) {
+            return (int64_t)VAR(i + 1);
+        }
+        break;
+
+    case OP_JNZ:
+        tmpi1 = vmstack_popi();
+        if (tmpi1 != 0) {
+            return (int64_t)VAR(i + 1);
+        }
+        break;
+
+    case OP_OSCILDEF:
+        VAR(i + 1)->type = TY_OSCIL;
+        if (VAR(i + 3) == NULL) {
+            VAR(i + 1)->value.p = (void *)new_oscil(
+                (int64_t)VAR(i + 2)->value.f, 0, 0
+            );
+        } else {
+            if ((VAR(i + 2)->type == TY_FLOAT || VAR(i + 2)->type == TY_CONST)
+             || (VAR(i + 3)->type == TY_FLOAT || VAR(i + 3)->type == TY_CONST)
+             || (VAR(i + 4)->type == TY_FLOAT || VAR(i + 4)->type == TY_CONST)) {
                 VAR(i + 1)->value.p = (void *)new_oscil(
-                    (int64_t)VAR(i + 2)->value.f, 0, 0
+                    (int64_t)VAR(i + 2)->value.f,
+                    (int64_t)VAR(i + 3)->value.f,
+                    (int64_t)VAR(i + 4)->value.f
                 );
             } else {
-                if ((VAR(i + 2)->type == TY_FLOAT || VAR(i + 2)->type == TY_CONST)
-                 || (VAR(i + 3)->type == TY_FLOAT || VAR(i + 3)->type == TY_CONST)
-                 || (VAR(i + 4)->type == TY_FLOAT || VAR(i + 4)->type == TY_CONST)) {
-                    VAR(i + 1)->value.p = (void *)new_oscil(
-                        (int64_t)VAR(i + 2)->value.f,
-                        (int64_t)VAR(i + 3)->value.f,
-                        (int64_t)VAR(i + 4)->value.f
-                    );
-                } else {
-                    oto_error(OTO_UNKNOWN_ERROR);
-                }
+                oto_error(OTO_UNKNOWN_ERROR);
             }
-            break;
+        }
+        break;
+
+    case OP_SOUNDDEF:
+        VAR(i + 1)->type = TY_SOUND;
+        if (VAR(i + 2)->type == TY_OSCIL) {
+            VAR(i + 1)->value.p = (void *)new_sound((Oscillator *)(VAR(i + 2)->value.p));
+        } else {
+            oto_error(OTO_ARGUMENTS_TYPE_ERROR);
+        }
+        break;
 
-        case OP_SOUNDDEF:
-            VAR(i + 1)->type = TY_SOUND;
-            if (VAR(i + 2)->type == TY_OSCIL) {
-                VAR(i + 1)->value.p = (void *)new_sound((Oscillator *)(VAR(i + 2)->value.p));
-            } else {
+    case OP_SAMPLEDEF: {
+        if (VAR(i + 2)->type != TY_STRING) {
+            oto_error(OTO_ARGUMENTS_TYPE_ERROR);
+        }
+        double base_freq = SAMPLE_BASE_FREQ;
+        if (VAR(i + 3) != NULL) {
+            if (VAR(i + 3)->type != TY_FLOAT && VAR(i + 3)->type != TY_CONST) {
                 oto_error(OTO_ARGUMENTS_TYPE_ERROR);
             }
-            break;
+            base_freq = VAR(i + 3)->value.f;
+        }
+        Sample *sample = load_sample(((String *)VAR(i + 2)->value.p)->str, base_freq);
+        if (IS_NULL(sample)) {
+            oto_error(OTO_FILE_NOT_FOUND_ERROR);
+        }
+        VAR(i + 1)->type = TY_OSCIL;
+        VAR(i + 1)->value.p = (void *)new_sample_oscil(sample);
+        break;
+    }
 
-        case OP_ARRAYDEF:
-            oto_define_array(var_list, VAR(i + 1), (int64_t)VAR(i + 2));
-            break;
+    case OP_ARRAYDEF:
+        oto_define_array(var_list, VAR(i + 1), (int64_t)VAR(i + 2));
+        break;
 
-        case OP_CPYS:
-            if (VAR(i + 2)->type != TY_SOUND) {
-                oto_error(OTO_UNKNOWN_ERROR);
-            
-            } else if (VAR(i + 1)->type == TY_SOUND) {
-                // ((Sound *)VAR(i + 1)->value.p)->oscillator = ((Sound *)VAR(i + 2)->value.p)->oscillator;
-                // free_items_vector_ptr(((Sound *)VAR(i + 1)->value.p)->filters);
-                // free_vector_ptr(((Sound *)VAR(i + 1)->value.p)->filters);
-                // new_vector_ptr()
-                oto_error(OTO_EXIST_SOUND_OBJECT_ERROR);
-
-            } else if (VAR(i + 1)->type != TY_SOUND) {
-                if (VAR(i + 1)->type == TY_FILTER) {
-                    oto_error(OTO_NAME_ERROR);
-                } else if (VAR(i + 1)->type == TY_OSCIL) {
-                    oto_error(OTO_NAME_ERROR);
-                } else if (VAR(i + 1)->type == TY_STRING) {
-                    oto_error(OTO_NAME_ERROR);
-                } else if (VAR(i + 1)->type == TY_ARRAY) {
-                    oto_error(OTO_NAME_ERROR);
-                }
-
-                VAR(i + 1)->type = TY_SOUND;
-                VAR(i + 1)->value.p = (void *)new_sound(((Sound *)VAR(i + 2)->value.p)->oscillator);
+    case OP_CPYS:
+        if (VAR(i + 2)->type != TY_SOUND) {
+            oto_error(OTO_UNKNOWN_ERROR);
+        
+        } else if (VAR(i + 1)->type == TY_SOUND) {
+            // ((Sound *)VAR(i + 1)->value.p)->oscillator = ((Sound *)VAR(i + 2)->value.p)->oscillator;
+            // free_items_vector_ptr(((Sound *)VAR(i + 1)->value.p)->filters);
+            // free_vector_ptr(((Sound *)VAR(i + 1)->value.p)->filters);
+            // new_vector_ptr()
+            oto_error(OTO_EXIST_SOUND_OBJECT_ERROR);
+
+        } else if (VAR(i + 1)->type != TY_SOUND) {
+            if (VAR(i + 1)->type == TY_FILTER) {
+                oto_error(OTO_NAME_ERROR);
+            } else if (VAR(i + 1)->type == TY_OSCIL) {
+                oto_error(OTO_NAME_ERROR);
+            } else if (VAR(i + 1)->type == TY_STRING) {
+                oto_error(OTO_NAME_ERROR);
+            } else if (VAR(i + 1)->type == TY_ARRAY) {
+                oto_error(OTO_NAME_ERROR);
             }
-            break;
 
-        case OP_CONNFILTER:
-            oto_connect_filter(((Sound *)(VAR(i + 1)->value.p)), (filtercode_t)VAR(i + 2), status);
-            break;
+            VAR(i + 1)->type = TY_SOUND;
+            VAR(i + 1)->value.p = (void *)new_sound(((Sound *)VAR(i + 2)->value.p)->oscillator);
+        }
+        break;
 
-        case OP_PRINT:
-            oto_instr_print();
-            break;
+    case OP_CONNFILTER:
+        oto_connect_filter(((Sound *)(VAR(i + 1)->value.p)), (filtercode_t)VAR(i + 2), status);
+        break;
 
-        case OP_BEEP:
-            oto_instr_beep();
-            break;
+    case OP_PRINT:
+        oto_instr_print();
+        break;
 
-        case OP_PLAY:
-            oto_instr_play(status);
-            break;
+    case OP_BEEP:
+        oto_instr_beep();
+        break;
 
-        case OP_PRINTWAV:
-            oto_instr_printwav(status);
-            break;
+    case OP_PLAY:
+        oto_instr_play(status);
+        break;
 
-        case OP_PRINTVAR:
-            oto_instr_printvar(var_list, status);
-            break;
-        
-        case OP_SLEEP:
-            oto_instr_sleep();
-            break;
+    case OP_PLAYMIDI:
+        oto_instr_playmidi(status);
+        break;
 
-        case OP_SETSYNTH:
-            oto_instr_setsynth(status);
-            break;
+    case OP_PLAYMML:
+        // 後ろに続くMMLNOTEは読み飛ばす
+        return oto_instr_playmml(status, ic_list, i);
 
-        case OP_SETLOOP:
-            oto_instr_setloop();
-            break;
+    case OP_PRINTWAV:
+        oto_instr_printwav(status);
+        break;
 
-        case OP_STOP:
-            fgetc(stdin);
-            break;
+    case OP_PRINTSPEC:
+        oto_instr_printspec(status);
+        break;
 
-        case OP_EXIT:
-            return;
+    case OP_PRINTVAR:
+        oto_instr_printvar(var_list, status);
+        break;
+    
+    case OP_SLEEP:
+        oto_instr_sleep();
+        break;
 
-        case OP_NOP:
-            break;
+    case OP_SETSYNTH:
+        oto_instr_setsynth(status);
+        break;
 
-        default:
-            oto_error(OTO_UNKNOWN_ERROR);
+    case OP_SETLOOP:
+        oto_instr_setloop();
+        break;
+
+    case OP_STOP:
+        fgetc(stdin);
+        break;
+
+    case OP_CALL:
+        return call_func(frame, (int64_t)VAR(i + 1), (int64_t)VAR(i + 2), i + 5);
+
+    case OP_PARAM:
+        bind_param(frame, VAR(i + 1), (int64_t)VAR(i + 2));
+        break;
+
+    case OP_RET:
+        return return_func(frame, (int64_t)VAR(i + 1));
+
+    case OP_EXIT:
+        return EXEC_EXIT;
+
+    case OP_NOP:
+    case OP_MMLNOTE:
+        break;
+
+    default:
+        oto_error(OTO_UNKNOWN_ERROR);
+    }
+
+    return i + 5;
+}
+
+void exec(const VectorPTR *ic_list, VectorPTR *var_list, Status *status, Frame *frame) {
+    int64_t i = 0;
+    int64_t end = ic_list->length;
+
+    // 前の実行がエラーで抜けたままでも領域を使い回さないように解放しておく
+    release_frame(frame);
+    init_frame(frame, ic_list, var_list, status);
+    if (status->profile_flag) {
+        init_profile(ic_list);
+    }
+
+    init_synth();
+
+    while (i < end) {
+        #ifdef DEBUG
+            printf("PC : %I64d\n", i);
+        #endif
+
+        // 何度も回るLOOPはネイティブコードに変換して実行する
+        // (プロファイル中は命令ごとに計測するので使わない)
+        if (status->jit_flag && !status->profile_flag
+            && (opcode_t)ic_list->data[i] == OP_LOOP) {
+            int64_t slot = (int64_t)VAR(i + 3);
+            if (IS_NULL(frame->jit_codes[slot])
+                && ++frame->loop_hits[slot] == JIT_HOT_LOOP_COUNT) {
+                frame->jit_codes[slot] = jit_compile(ic_list, i, status->watch_flag);
+            }
+            if (IS_NOT_NULL(frame->jit_codes[slot])) {
+                i = jit_run(frame->jit_codes[slot], frame);
+                if (i == EXEC_EXIT) {
+                    release_frame(frame);
+                    return;
+                }
+                continue;
+            }
+        }
+
+        // --watch中にソースが変わったら, 音を出していないLOOPとPLAYの手前で抜ける
+        if (status->watch_flag) {
+            opcode_t op = (opcode_t)ic_list->data[i];
+            if ((op == OP_LOOP || op == OP_PLAY || op == OP_PLAYMIDI || op == OP_PLAYMML)
+                && is_watch_changed()) {
+                release_frame(frame);
+                return;
+            }
         }
 
-        i += 5;
+        if (status->profile_flag) {
+            i = profile_exec_instr(frame, i);
+        } else {
+            i = exec_instr(frame, i);
+        }
+        if (i == EXEC_EXIT) {
+            release_frame(frame);
+            return;
+        }
     }
 
+    release_frame(frame);
     start_synth(status);
 }
@@ -183,6 +183,10 @@ void oto_instr_play(Status *status) {
     Playdata data;
 
     play_sub(status, &data);
+    if (IS_NOT_NULL(status->spectrogram_path)) {
+        render_offline(data);
+        return;
+    }
     write_out_data(data, false, true);
 
     set_stream_active_flag(true);
@@ -191,6 +195,140 @@ void oto_instr_play(Status *status) {
     }
 }
 
+/* Songをインタプリタを通さずに最後まで鳴らして解放する */
+static void play_song(Status *status, Song *song, Sound **sounds, int64_t sounds_num) {
+    SongPlayer *sp = MYMALLOC1(SongPlayer);
+    if (IS_NULL(sp)) {
+        free_song(song);
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+    init_song_player(sp, song, sounds, sounds_num, status->sampling_rate, status->fade_range);
+
+    if (IS_NOT_NULL(status->spectrogram_path)) {
+        render_song_offline(sp);
+    } else {
+        write_out_song(sp);
+
+        set_stream_active_flag(true);
+        while (is_stream_active()) {
+            usleep(1);
+        }
+        clear_out_song();
+    }
+
+    free(sp);
+    free_song(song);
+}
+
+/* MIDIファイルを読み込んで, インタプリタを通さずに最後まで鳴らす */
+void play_midi_file(Status *status, const char *path, Sound **sounds, int64_t sounds_num) {
+    Song *song = load_midi(path, status->sampling_rate);
+    if (IS_NULL(song)) {
+        print_error(OTO_FILE_NOT_FOUND_ERROR, status);
+        printf("filename : %s\n", path);
+        oto_error_throw(OTO_FILE_NOT_FOUND_ERROR);
+    }
+
+    printf("[PlayMIDI] file : %s, notes : %I64d, duration : %2.2f\n",
+           path, song->len, (double)song->length / status->sampling_rate);
+
+    play_song(status, song, sounds, sounds_num);
+}
+
+/* PLAYMIDI "song.mid", S1, S2, ... (n番目のトラックをSnで鳴らす) */
+void oto_instr_playmidi(Status *status) {
+    Sound *sounds[PLAYMIDI_MAX_SOUNDS] = {NULL};
+    int64_t sounds_num = 0;
+    for (int64_t i = PLAYMIDI_MAX_SOUNDS - 1; i >= 0; i--) {
+        if (vmstack_typecheck() == VM_TY_INITVAL) {
+            vmstack_popf();
+            continue;
+        }
+        if (vmstack_typecheck() != VM_TY_VARPTR) {
+            oto_error(OTO_ARGUMENTS_TYPE_ERROR);
+        }
+        Var *var = vmstack_popp();
+        if (var->type != TY_SOUND) {
+            oto_error(OTO_ARGUMENTS_TYPE_ERROR);
+        }
+        sounds[i] = (Sound *)var->value.p;
+        if (sounds_num == 0) {
+            sounds_num = i + 1;
+        }
+    }
+
+    if (vmstack_typecheck() == VM_TY_INITVAL) {
+        vmstack_popf();
+        oto_error(OTO_MISSING_ARGUMENTS_ERROR);
+    } else if (vmstack_typecheck() != VM_TY_VARPTR) {
+        oto_error(OTO_ARGUMENTS_TYPE_ERROR);
+    }
+    Var *var = vmstack_popp();
+    if (var->type != TY_STRING) {
+        oto_error(OTO_ARGUMENTS_TYPE_ERROR);
+    }
+
+    play_midi_file(status, ((String *)var->value.p)->str, sounds, sounds_num);
+}
+
+/* doubleのビット列をそのまま入れたオペランドを取り出す */
+static double operand_double(const void *operand) {
+    union value_u v = {0};
+    v.p = (void *)operand;
+    return v.f;
+}
+
+/**
+ * PLAYMML Sound Count Total の後ろに続くCount個のMMLNOTEを鳴らして,
+ * 最後のMMLNOTEの次の位置を返す
+ */
+int64_t oto_instr_playmml(Status *status, const VectorPTR *ic_list, int64_t i) {
+    Var *var = (Var *)ic_list->data[i + 1];
+    int64_t count = (int64_t)ic_list->data[i + 2];
+    double total = operand_double(ic_list->data[i + 3]);
+    int64_t next = i + 5 * (count + 1);
+
+    Sound *sound = NULL;
+    if (IS_NOT_NULL(var)) {
+        if (var->type != TY_SOUND) {
+            oto_error(OTO_ARGUMENTS_TYPE_ERROR);
+        }
+        sound = (Sound *)var->value.p;
+    }
+
+    Song *song = new_song();
+    if (IS_NULL(song)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+
+    double sr = status->sampling_rate;
+    for (int64_t n = i + 5; n < next; n += 5) {
+        uint64_t start  = (uint64_t)(operand_double(ic_list->data[n + 1]) * sr);
+        uint64_t length = (uint64_t)(operand_double(ic_list->data[n + 2]) * sr);
+        float freq      = (float)operand_double(ic_list->data[n + 3]);
+        int8_t volume   = (int8_t)(int64_t)ic_list->data[n + 4];
+        if (length > 0) {
+            song_add_note(song, start, length, freq, volume, 0);
+        }
+    }
+    finish_song(song);
+
+    // 最後の休符の分も鳴らす
+    if ((uint64_t)(total * sr) > song->length) {
+        song->length = (uint64_t)(total * sr);
+    }
+
+    printf("[PlayMML] notes : %I64d, duration : %2.2f\n", song->len, total);
+
+    if (song->length == 0) {
+        free_song(song);
+        return next;
+    }
+    play_song(status, song, &sound, IS_NULL(sound) ? 0 : 1);
+
+    return next;
+}
+
 static AInt16a transform_tdata(float data) {
     if (data > 1) {
         data = 1;
@@ -241,6 +379,10 @@ static void print_wave_sub(Status *status, Playdata *data) {
 void oto_instr_printwav(Status *status) {
     Playdata data;
     play_sub(status, &data);
+    if (IS_NOT_NULL(status->spectrogram_path)) {
+        render_offline(data);
+        return;
+    }
     
     if (IS_NOT_NULL(databuf)) {
         free(databuf);
@@ -260,6 +402,72 @@ void oto_instr_printwav(Status *status) {
     print_wave_sub(status, &data);
 }
 
+typedef struct {
+    AWindow *w;
+    int64_t frames;  // 全体のフレーム数
+    int64_t frame;   // 次に描くフレーム
+} SpecWindow;
+
+/* 1フレームを縦1列に描く. 下が低い周波数 */
+static void draw_spec_column(const float *db, void *arg) {
+    SpecWindow *sw = (SpecWindow *)arg;
+    int32_t x0 = sw->frame * PRINTSPEC_WIN_WIDTH / sw->frames;
+    int32_t x1 = (sw->frame + 1) * PRINTSPEC_WIN_WIDTH / sw->frames;
+    sw->frame++;
+    if (x1 <= x0 || x0 >= PRINTSPEC_WIN_WIDTH) {
+        return;
+    }
+
+    for (int32_t y = 0; y < PRINTSPEC_WIN_HEIGHT; y++) {
+        // 1画素に入る周波数のうち一番大きいもの
+        int64_t k0 = y * SPEC_BINS / PRINTSPEC_WIN_HEIGHT;
+        int64_t k1 = (y + 1) * SPEC_BINS / PRINTSPEC_WIN_HEIGHT;
+        float max = db[k0];
+        for (int64_t k = k0 + 1; k < k1; k++) {
+            if (db[k] > max) {
+                max = db[k];
+            }
+        }
+
+        uint8_t rgb[3];
+        spec_color(max, rgb);
+        aFillRect(sw->w, x1 - x0, 1, x0, PRINTSPEC_WIN_HEIGHT - 1 - y, aRgb8(rgb[0], rgb[1], rgb[2]));
+    }
+}
+
+void oto_instr_printspec(Status *status) {
+    Playdata data;
+    play_sub(status, &data);
+    if (IS_NOT_NULL(status->spectrogram_path)) {
+        render_offline(data);
+        return;
+    }
+
+    write_out_data(data, false, true);
+
+    set_stream_active_flag(true);
+    while (is_stream_active()) {
+        usleep(1);
+    }
+
+    // 鳴らしたものと同じ音を改めて作りながら描く
+    AWindow *w = aOpenWin(PRINTSPEC_WIN_WIDTH, PRINTSPEC_WIN_HEIGHT, "spectrogram", 1);
+    aFillRect(w, PRINTSPEC_WIN_WIDTH, PRINTSPEC_WIN_HEIGHT, 0, 0, PRINTWAV_WIN_BACKGROUND_COLOR);
+
+    SpecWindow sw;
+    sw.w      = w;
+    // 変換した後の出力をフレームに分けるので, 出力の周波数で数える
+    sw.frames = (output_length(data.length) + SPEC_HOP) / SPEC_HOP;
+    sw.frame  = 0;
+
+    Spectrogram *spec = new_spectrogram(draw_spec_column, &sw);
+    render_spectrogram(data, spec);
+    finish_spectrogram(spec);
+
+    // 何等かのキーが押されるまで待機
+    aWait(-1);
+}
+
 void oto_instr_printvar(VectorPTR *var_list, Status *status) {
     if (var_list->length <= TC_EXIT + 1) {
         // 変数が1つも定義されていない
@@ -284,11 +492,11 @@ void oto_instr_printvar(VectorPTR *var_list, Status *status) {
         if (type == TY_CONST) {
             continue;
         } else if (type == TY_FLOAT) {
-            printf("%8s", var->token->str);
+            printf("%8.*s", (int)var->token->len, var->token->str);
             printf("(float) : ");
             printf("%f", var->value.f);
         } else if (type == TY_ARRAY) {
-            printf("%8s", var->token->str);
+            printf("%8.*s", (int)var->token->len, var->token->str);
             printf("(array) : ");
             Array *array = (Array *)var->value.p;
             print_array(array->data, array->len);
@@ -299,7 +507,7 @@ void oto_instr_printvar(VectorPTR *var_list, Status *status) {
                 // 文字列リテラルならスルー
                 continue;
             }
-            printf("%8s", var->token->str);
+            printf("%8.*s", (int)var->token->len, var->token->str);
             printf("(string) : ");
             printf("%s\n", ((String *)var->value.p)->str);
         } else if (type == TY_OSCIL) {
@@ -347,21 +555,22 @@ void oto_connect_filter(Sound *sound, filtercode_t fc, Status *status) {
             oto_error(OTO_ARGUMENTS_TYPE_ERROR);
         }
     }
+    init_filter_state(filter, status->sampling_rate);
 
-    vector_ptr_append(sound->filters, (void *)filter);
+    if (IS_NULL(sound->filters)) {
+        sound->filters = filter;
+    } else {
+        sound->last_filter->next = filter;
+    }
+    sound->last_filter = filter;
 }
 
 void oto_define_array(VectorPTR *var_list, Var *var, int64_t arraysize) {
-    Array *array = MYMALLOC1(Array);
-    if (IS_NULL(array)) {
-        oto_error(OTO_INTERNAL_ERROR);
-    }
+    // 要素はArrayのすぐ後ろに置く
+    Array *array = (Array *)region_alloc(REGION_ARRAY, sizeof(Array) + arraysize * sizeof(double));
 
     array->len = arraysize;
-    array->data = MYMALLOC(arraysize, double);
-    if (IS_NULL(array->data)) {
-        oto_error(OTO_INTERNAL_ERROR);
-    }
+    array->data = (double *)(array + 1);
 
     for (int64_t i = 0; i < arraysize; i++) {
         if (vmstack_typecheck() == VM_TY_VARPTR) {
@@ -0,0 +1,476 @@
+#include "vm.h"
+
+#include <stddef.h>
+
+/**
+ * LOOP命令のテンプレートJIT
+ *
+ * 何度も実行されたLOOPの本体(LOOP命令から対応するJMP命令まで)を
+ * x86-64の機械語に変換する.
+ * 二項演算・スタック演算・比較・ジャンプ・LOOPは機械語にして,
+ * それ以外の命令(PLAYなど)は命令ごとにexec_instr()を呼び出す.
+ *
+ * 生成するコードはWindows x64の呼び出し規約に従う.
+ *   rbx : Frame *
+ *   r12 : frame->loop_cnts
+ * 戻り値は続きをインタプリタで実行する命令の位置(EXITならEXEC_EXIT).
+ * --watch中はLOOPの先頭ごとにソースの変更を確かめ, 変わっていればEXITと同じく抜ける.
+ */
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define JIT_ENABLE
+#endif
+
+/* Windows以外のx86-64でも生成コードと同じ呼び出し規約で呼ぶ */
+#ifdef _WIN64
+#define JIT_ABI
+#else
+#define JIT_ABI __attribute__((ms_abi))
+#endif
+
+typedef int64_t (JIT_ABI *JitFunc)(Frame *frame);
+
+struct JitCode {
+    void *mem;
+    size_t size;
+    JitFunc entry;
+#ifdef _WIN64
+    RUNTIME_FUNCTION *func_table;
+#endif
+};
+
+#ifdef JIT_ENABLE
+
+#define VAR(tc)  ((Var *)(ic_list->data[tc]))
+
+#define JIT_STACK_SIZE 40  // シャドウ領域(32) + アライメント調整(8)
+
+/* x64の例外処理用に登録するUNWIND_INFO (push rbx; push r12; sub rsp, 40) */
+static const uint8_t jit_unwind_info[] = {
+    0x01, 0x07, 0x03, 0x00,  // Version 1, プロローグ7バイト, コード3個
+    0x07, 0x42,              // sub rsp, 40 (UWOP_ALLOC_SMALL)
+    0x03, 0xc0,              // push r12    (UWOP_PUSH_NONVOL)
+    0x01, 0x30,              // push rbx    (UWOP_PUSH_NONVOL)
+    0x00, 0x00
+};
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t cap;
+    bool error;
+} CodeBuf;
+
+/* ---------------------------------------------------------------- */
+/* 生成コードから呼ぶ関数 */
+
+static JIT_ABI void jit_pushv(Var *v) {
+    vmstack_pushv(v);
+}
+
+static JIT_ABI void jit_alu(int64_t op) {
+    alu((opcode_t)op);
+}
+
+static JIT_ABI int64_t jit_popi() {
+    return vmstack_popi();
+}
+
+static JIT_ABI int64_t jit_watch_changed() {
+    return is_watch_changed();
+}
+
+/* 機械語にしない命令はインタプリタで実行する */
+static JIT_ABI void jit_step(Frame *frame, int64_t pc) {
+    exec_instr(frame, pc);
+}
+
+/* ---------------------------------------------------------------- */
+/* 命令の書き出し */
+
+static void emit8(CodeBuf *code, uint8_t b) {
+    if (code->len >= code->cap) {
+        size_t cap = code->cap * 2;
+        uint8_t *buf = (uint8_t *)realloc(code->buf, cap);
+        if (IS_NULL(buf)) {
+            code->error = true;
+            return;
+        }
+        code->buf = buf;
+        code->cap = cap;
+    }
+    code->buf[code->len++] = b;
+}
+
+static void emit_bytes(CodeBuf *code, const uint8_t *bytes, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        emit8(code, bytes[i]);
+    }
+}
+
+static void emit32(CodeBuf *code, int32_t v) {
+    for (int64_t i = 0; i < 4; i++) {
+        emit8(code, (uint8_t)((uint32_t)v >> (i * 8)));
+    }
+}
+
+static void emit64(CodeBuf *code, uint64_t v) {
+    for (int64_t i = 0; i < 8; i++) {
+        emit8(code, (uint8_t)(v >> (i * 8)));
+    }
+}
+
+/* mov reg, imm64 (reg: 0=rax, 1=rcx, 2=rdx) */
+static void emit_mov_imm64(CodeBuf *code, uint8_t reg, uint64_t imm) {
+    emit8(code, 0x48);
+    emit8(code, 0xb8 + reg);
+    emit64(code, imm);
+}
+
+/* mov rax, func; call rax */
+static void emit_call(CodeBuf *code, void *func) {
+    emit_mov_imm64(code, 0, (uint64_t)func);
+    emit8(code, 0xff);
+    emit8(code, 0xd0);
+}
+
+/* 飛び先をあとで埋めるrel32を書き出す */
+static void emit_rel32(CodeBuf *code, VectorI64 *fixups, int64_t target) {
+    vector_i64_append(fixups, code->len);
+    vector_i64_append(fixups, target);
+    emit32(code, 0);
+}
+
+static void emit_jmp(CodeBuf *code, VectorI64 *fixups, int64_t target) {
+    emit8(code, 0xe9);
+    emit_rel32(code, fixups, target);
+}
+
+/* cc: 0x84=jz, 0x85=jnz, 0x8e=jle */
+static void emit_jcc(CodeBuf *code, VectorI64 *fixups, uint8_t cc, int64_t target) {
+    emit8(code, 0x0f);
+    emit8(code, cc);
+    emit_rel32(code, fixups, target);
+}
+
+/* [r12 + slot * 8] を指すModRM, SIB, disp32 */
+static void emit_loop_cnt_operand(CodeBuf *code, uint8_t reg, int64_t slot) {
+    emit8(code, 0x84 | (reg << 3));
+    emit8(code, 0x24);
+    emit32(code, (int32_t)(slot * sizeof(int64_t)));
+}
+
+/* Var1 = Var2 op Var3 (op: 0x58=addsd, 0x5c=subsd, 0x59=mulsd) */
+static void emit_arith2(CodeBuf *code, uint8_t op, Var *v1, Var *v2, Var *v3) {
+    const uint8_t disp_value = offsetof(Var, value);
+    const uint8_t disp_type  = offsetof(Var, type);
+
+    emit_mov_imm64(code, 0, (uint64_t)v2);
+    emit_bytes(code, (uint8_t []){0xf2, 0x0f, 0x10, 0x40, disp_value}, 5);
+    emit_mov_imm64(code, 0, (uint64_t)v3);
+    emit_bytes(code, (uint8_t []){0xf2, 0x0f, op, 0x40, disp_value}, 5);
+    emit_mov_imm64(code, 0, (uint64_t)v1);
+    emit_bytes(code, (uint8_t []){0xf2, 0x0f, 0x11, 0x40, disp_value}, 5);
+    emit_bytes(code, (uint8_t []){0x48, 0xc7, 0x40, disp_type}, 4);
+    emit32(code, TY_FLOAT);
+}
+
+static void emit_loop(CodeBuf *code, VectorI64 *fixups, int64_t pc,
+                      int64_t target, Var *cnt, int64_t slot) {
+    // rax = ++loop_cnts[slot]
+    emit_bytes(code, (uint8_t []){0x49, 0x8b}, 2);
+    emit_loop_cnt_operand(code, 0, slot);
+    emit_bytes(code, (uint8_t []){0x48, 0xff, 0xc0}, 3);
+    emit_bytes(code, (uint8_t []){0x49, 0x89}, 2);
+    emit_loop_cnt_operand(code, 0, slot);
+
+    // rdx = (int64_t)cnt->value.f
+    emit_mov_imm64(code, 1, (uint64_t)cnt);
+    emit_bytes(code, (uint8_t []){0xf2, 0x48, 0x0f, 0x2c, 0x51, offsetof(Var, value)}, 6);
+
+    // cmp rax, rdx; jle 本体
+    emit_bytes(code, (uint8_t []){0x48, 0x39, 0xd0}, 3);
+    emit_jcc(code, fixups, 0x8e, pc + 5);
+
+    // ループカウンタを初期化して抜ける
+    emit_bytes(code, (uint8_t []){0x49, 0xc7}, 2);
+    emit_loop_cnt_operand(code, 0, slot);
+    emit32(code, 0);
+    emit_jmp(code, fixups, target);
+}
+
+static void emit_prologue(CodeBuf *code) {
+    emit_bytes(code, (uint8_t []){
+        0x53,                          // push rbx
+        0x41, 0x54,                    // push r12
+        0x48, 0x83, 0xec, JIT_STACK_SIZE, // sub rsp, 40
+        0x48, 0x89, 0xcb,              // mov rbx, rcx
+        0x4c, 0x8b, 0x63, offsetof(Frame, loop_cnts)  // mov r12, [rbx + loop_cnts]
+    }, 14);
+}
+
+static void emit_epilogue(CodeBuf *code) {
+    emit_bytes(code, (uint8_t []){
+        0x48, 0x83, 0xc4, JIT_STACK_SIZE, // add rsp, 40
+        0x41, 0x5c,                    // pop r12
+        0x5b,                          // pop rbx
+        0xc3                           // ret
+    }, 8);
+}
+
+static bool is_valid_target(const VectorPTR *ic_list, int64_t target) {
+    return target == EXEC_EXIT
+        || (0 <= target && target <= ic_list->length && target % 5 == 0);
+}
+
+/* 命令を1つ機械語にする. 変換できなければfalse */
+static bool emit_instr(CodeBuf *code, VectorI64 *fixups,
+                       const VectorPTR *ic_list, int64_t pc, bool watch) {
+    opcode_t op = (opcode_t)ic_list->data[pc];
+    int64_t target = 0;
+
+    switch (op) {
+    case OP_ADD2:
+        emit_arith2(code, 0x58, VAR(pc + 1), VAR(pc + 2), VAR(pc + 3));
+        break;
+
+    case OP_SUB2:
+        emit_arith2(code, 0x5c, VAR(pc + 1), VAR(pc + 2), VAR(pc + 3));
+        break;
+
+    case OP_MUL2:
+        emit_arith2(code, 0x59, VAR(pc + 1), VAR(pc + 2), VAR(pc + 3));
+        break;
+
+    case OP_PUSH:
+        emit_mov_imm64(code, 1, (uint64_t)VAR(pc + 1));
+        emit_call(code, jit_pushv);
+        break;
+
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_MOD:
+    case OP_AND:
+    case OP_OR:
+    case OP_EQ:
+    case OP_NEQ:
+    case OP_LTCMP:
+    case OP_LTEQCMP:
+    case OP_RICMP:
+    case OP_RIEQCMP:
+        emit_mov_imm64(code, 1, op);
+        emit_call(code, jit_alu);
+        break;
+
+    case OP_LOOP:
+        target = (int64_t)VAR(pc + 1);
+        if (!is_valid_target(ic_list, target)) {
+            return false;
+        }
+        // インタプリタがLOOPの手前で抜けるのと同じ位置で確かめる
+        if (watch) {
+            emit_call(code, jit_watch_changed);
+            emit_bytes(code, (uint8_t []){0x48, 0x85, 0xc0}, 3);  // test rax, rax
+            emit_jcc(code, fixups, 0x85, EXEC_EXIT);
+        }
+        emit_loop(code, fixups, pc, target, VAR(pc + 2), (int64_t)VAR(pc + 3));
+        break;
+
+    case OP_JMP:
+        target = (int64_t)VAR(pc + 1);
+        if (!is_valid_target(ic_list, target)) {
+            return false;
+        }
+        emit_jmp(code, fixups, target);
+        break;
+
+    case OP_JZ:
+    case OP_JNZ:
+        target = (int64_t)VAR(pc + 1);
+        if (!is_valid_target(ic_list, target)) {
+            return false;
+        }
+        emit_call(code, jit_popi);
+        emit_bytes(code, (uint8_t []){0x48, 0x85, 0xc0}, 3);  // test rax, rax
+        emit_jcc(code, fixups, op == OP_JZ ? 0x84 : 0x85, target);
+        break;
+
+    case OP_EXIT:
+        emit_jmp(code, fixups, EXEC_EXIT);
+        break;
+
+    case OP_CALL:
+    case OP_RET:
+        // 戻り先が実行時に決まるので変換しない
+        return false;
+
+    case OP_NOP:
+    case OP_MMLNOTE:
+        break;
+
+    default:
+        // mov rcx, rbx; mov rdx, pc; call jit_step
+        emit_bytes(code, (uint8_t []){0x48, 0x89, 0xd9}, 3);
+        emit_mov_imm64(code, 2, pc);
+        emit_call(code, jit_step);
+        break;
+    }
+
+    return true;
+}
+
+/* 実行可能な領域にコードをコピーする */
+static JitCode *install_code(CodeBuf *code) {
+    size_t unwind_offset = (code->len + 3) & ~(size_t)3;
+    size_t table_offset  = unwind_offset + sizeof(jit_unwind_info);
+    size_t size = table_offset;
+#ifdef _WIN64
+    size += sizeof(RUNTIME_FUNCTION);
+#endif
+
+    JitCode *jit = MYMALLOC1(JitCode);
+    if (IS_NULL(jit)) {
+        return NULL;
+    }
+
+    uint8_t *mem = (uint8_t *)VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (IS_NULL(mem)) {
+        free(jit);
+        return NULL;
+    }
+    memcpy(mem, code->buf, code->len);
+    memcpy(mem + unwind_offset, jit_unwind_info, sizeof(jit_unwind_info));
+
+#ifdef _WIN64
+    // 生成コードの中でoto_error()のlongjmpが起きても巻き戻せるようにする
+    RUNTIME_FUNCTION *table = (RUNTIME_FUNCTION *)(mem + table_offset);
+    table->BeginAddress = 0;
+    table->EndAddress   = code->len;
+    table->UnwindData   = unwind_offset;
+    RtlAddFunctionTable(table, 1, (DWORD64)mem);
+    jit->func_table = table;
+#endif
+
+    DWORD old_protect;
+    if (!VirtualProtect(mem, size, PAGE_EXECUTE_READ, &old_protect)) {
+        VirtualFree(mem, 0, MEM_RELEASE);
+        free(jit);
+        return NULL;
+    }
+    FlushInstructionCache(GetCurrentProcess(), mem, size);
+
+    jit->mem   = mem;
+    jit->size  = size;
+    jit->entry = (JitFunc)mem;
+    return jit;
+}
+
+/* LOOP命令からループの終わりまでをコンパイルする. 失敗したらNULL */
+JitCode *jit_compile(const VectorPTR *ic_list, int64_t loop_pc, bool watch) {
+    int64_t start = loop_pc;
+    int64_t end   = (int64_t)VAR(loop_pc + 1);
+    if (end <= start || end > ic_list->length || (end - start) % 5 != 0) {
+        return NULL;
+    }
+    int64_t instr_num = (end - start) / 5;
+
+    CodeBuf code = {0};
+    code.cap = instr_num * 64 + 128;
+    code.buf = MYMALLOC(code.cap, uint8_t);
+    int64_t *labels = MYMALLOC(instr_num, int64_t);
+    VectorI64 *fixups = new_vector_i64(instr_num * 2);
+    VectorI64 *stubs  = new_vector_i64(16);
+    JitCode *jit = NULL;
+    if (IS_NULL(code.buf) || IS_NULL(labels) || IS_NULL(fixups) || IS_NULL(stubs)) {
+        goto end;
+    }
+
+    emit_prologue(&code);
+    for (int64_t pc = start; pc < end; pc += 5) {
+        labels[(pc - start) / 5] = code.len;
+        if (!emit_instr(&code, fixups, ic_list, pc, watch)) {
+            goto end;
+        }
+    }
+
+    // 最後まで進んだらループの後ろから再開する
+    emit_mov_imm64(&code, 0, end);
+    size_t epilogue = code.len;
+    emit_epilogue(&code);
+
+    // 領域の外に出るジャンプは飛び先を返して抜ける
+    for (int64_t i = 0; i < fixups->length; i += 2) {
+        int64_t pos    = fixups->data[i];
+        int64_t target = fixups->data[i + 1];
+        int64_t dest   = 0;
+
+        if (start <= target && target < end) {
+            dest = labels[(target - start) / 5];
+        } else {
+            int64_t j = 0;
+            for (j = 0; j < stubs->length; j += 2) {
+                if (stubs->data[j] == target) {
+                    break;
+                }
+            }
+            if (j >= stubs->length) {
+                vector_i64_append(stubs, target);
+                vector_i64_append(stubs, code.len);
+                emit_mov_imm64(&code, 0, target);
+                emit8(&code, 0xe9);
+                emit32(&code, (int32_t)(epilogue - (code.len + 4)));
+            }
+            dest = stubs->data[j + 1];
+        }
+
+        if (code.error) {
+            goto end;
+        }
+        int32_t rel = (int32_t)(dest - (pos + 4));
+        memcpy(&code.buf[pos], &rel, sizeof(int32_t));
+    }
+
+    if (!code.error) {
+        jit = install_code(&code);
+    }
+
+end:
+    free(code.buf);
+    free(labels);
+    free_vector_i64(fixups);
+    free_vector_i64(stubs);
+    return jit;
+}
+
+int64_t jit_run(JitCode *code, Frame *frame) {
+    return code->entry(frame);
+}
+
+void jit_free(JitCode *code) {
+    if (IS_NULL(code)) {
+        return;
+    }
+#ifdef _WIN64
+    RtlDeleteFunctionTable(code->func_table);
+#endif
+    VirtualFree(code->mem, 0, MEM_RELEASE);
+    free(code);
+}
+
+#else
+
+/* x86-64以外ではインタプリタだけで実行する */
+JitCode *jit_compile(const VectorPTR *ic_list, int64_t loop_pc, bool watch) {
+    return NULL;
+}
+
+int64_t jit_run(JitCode *code, Frame *frame) {
+    return EXEC_EXIT;
+}
+
+void jit_free(JitCode *code) {
+}
+
+#endif
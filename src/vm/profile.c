@@ -0,0 +1,146 @@
+#include "vm.h"
+
+/**
+ * VMプロファイラ (--profile)
+ *
+ * 命令の種類ごとと内部コードの位置ごとに実行回数と時間を数えて,
+ * 実行後に時間のかかった順に表示する.
+ * 時間はx86ならrdtscのクロック数, それ以外はQueryPerformanceCounterの値.
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILE_CLOCK()    __rdtsc()
+#define PROFILE_CLOCK_UNIT "cycles"
+#else
+static uint64_t query_performance_counter() {
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+}
+#define PROFILE_CLOCK()    query_performance_counter()
+#define PROFILE_CLOCK_UNIT "ticks"
+#endif
+
+/* ホットスポットとして表示する命令の数 */
+#define PROFILE_HOTSPOT_NUM 10
+
+typedef struct {
+    int64_t idx;     // 命令コードか内部コードの位置
+    uint64_t count;
+    uint64_t clocks;
+} ProfileEntry;
+
+static ProfileEntry op_entries[OP_EXIT + 1];
+static ProfileEntry *pc_entries = NULL;
+static int64_t pc_entry_num = 0;
+
+void init_profile(const VectorPTR *ic_list) {
+    for (int64_t op = 0; op <= OP_EXIT; op++) {
+        op_entries[op].idx    = op;
+        op_entries[op].count  = 0;
+        op_entries[op].clocks = 0;
+    }
+
+    free(pc_entries);
+    pc_entry_num = ic_list->length / 5;
+    pc_entries = MYMALLOC(pc_entry_num + 1, ProfileEntry);
+    if (IS_NULL(pc_entries)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+    for (int64_t i = 0; i < pc_entry_num; i++) {
+        pc_entries[i].idx = i * 5;
+    }
+}
+
+/* exec_instr()の実行回数と時間を記録する */
+int64_t profile_exec_instr(Frame *frame, int64_t i) {
+    opcode_t op = (opcode_t)frame->ic_list->data[i];
+
+    uint64_t start = PROFILE_CLOCK();
+    int64_t next = exec_instr(frame, i);
+    uint64_t clocks = PROFILE_CLOCK() - start;
+
+    op_entries[op].count++;
+    op_entries[op].clocks += clocks;
+    pc_entries[i / 5].count++;
+    pc_entries[i / 5].clocks += clocks;
+
+    return next;
+}
+
+static int cmp_entry(const void *a, const void *b) {
+    const ProfileEntry *e1 = (const ProfileEntry *)a;
+    const ProfileEntry *e2 = (const ProfileEntry *)b;
+
+    if (e1->clocks != e2->clocks) {
+        return e1->clocks < e2->clocks ? 1 : -1;
+    }
+    return e1->idx < e2->idx ? -1 : (e1->idx > e2->idx);
+}
+
+static double percent(uint64_t clocks, uint64_t total) {
+    return total == 0 ? 0 : 100.0 * clocks / total;
+}
+
+void print_profile(const VectorPTR *ic_list, Status *status) {
+    if (IS_NULL(pc_entries)) {
+        return;
+    }
+
+    uint64_t total = 0;
+    for (int64_t op = 0; op <= OP_EXIT; op++) {
+        total += op_entries[op].clocks;
+    }
+
+    qsort(op_entries, OP_EXIT + 1, sizeof(ProfileEntry), cmp_entry);
+    qsort(pc_entries, pc_entry_num, sizeof(ProfileEntry), cmp_entry);
+
+    if (status->language == LANG_JPN_KANJI) {
+        printf("- プロファイル (命令ごと) -\n");
+    } else if (status->language == LANG_JPN_HIRAGANA) {
+        printf("- プロファイル (めいれいごと) -\n");
+    } else if (status->language == LANG_ENG) {
+        printf("- Profile (by opcode) -\n");
+    }
+    printf("%15s %12s %16s %7s\n", "opcode", "count", PROFILE_CLOCK_UNIT, "%");
+    for (int64_t i = 0; i <= OP_EXIT; i++) {
+        ProfileEntry *e = &op_entries[i];
+        if (e->count == 0) {
+            break;
+        }
+        printf("%15s %12I64u %16I64u %6.2f%%\n", opcode_name(e->idx),
+               e->count, e->clocks, percent(e->clocks, total));
+    }
+    printf("\n");
+
+    if (status->language == LANG_JPN_KANJI) {
+        printf("- プロファイル (ホットスポット) -\n");
+    } else if (status->language == LANG_JPN_HIRAGANA) {
+        printf("- プロファイル (じかんのかかったところ) -\n");
+    } else if (status->language == LANG_ENG) {
+        printf("- Profile (hotspots) -\n");
+    }
+    printf("%5s %15s %12s %16s %7s %6s\n", "pc", "opcode", "count", PROFILE_CLOCK_UNIT, "%", "line");
+    for (int64_t i = 0; i < pc_entry_num && i < PROFILE_HOTSPOT_NUM; i++) {
+        ProfileEntry *e = &pc_entries[i];
+        if (e->count == 0) {
+            break;
+        }
+
+        const SrcPos *pos = get_ic_pos(e->idx);
+        int64_t line = IS_NOT_NULL(pos) ? pos->line : 0;
+        printf("%5I64d %15s %12I64u %16I64u %6.2f%% %6I64d : ", e->idx,
+               opcode_name((opcode_t)ic_list->data[e->idx]),
+               e->count, e->clocks, percent(e->clocks, total), line);
+        if (IS_NOT_NULL(pos)) {
+            print_src_line(pos);
+        } else {
+            printf("\n");
+        }
+    }
+    printf("\n");
+
+    free(pc_entries);
+    pc_entries = NULL;
+}
@@ -0,0 +1,49 @@
+#include <oto/oto.h>
+
+/**
+ * 実行時に作るSound, Oscillator, Filter, Array, FUNCで定義した関数を置く領域
+ *
+ * 種類ごとに別のArenaに詰めて置き, 個別には解放しない.
+ * プログラムの終了時かREPLのRESETでまとめて捨てる.
+ */
+
+/* 種類ごとの塊の大きさ */
+static const size_t region_block_size[REGION_NUM] = {
+    [REGION_SOUND]  = 4 * 1024,
+    [REGION_OSCIL]  = 4 * 1024,
+    [REGION_FILTER] = 16 * 1024,
+    [REGION_ARRAY]  = 64 * 1024,
+    [REGION_FUNC]   = 4 * 1024,
+};
+
+static Arena *regions[REGION_NUM] = {NULL};
+
+void *region_alloc(region_t region, size_t size) {
+    if (IS_NULL(regions[region])) {
+        regions[region] = new_arena(region_block_size[region]);
+        if (IS_NULL(regions[region])) {
+            oto_error(OTO_INTERNAL_ERROR);
+        }
+    }
+
+    void *p = arena_alloc(regions[region], size);
+    if (IS_NULL(p)) {
+        oto_error(OTO_INTERNAL_ERROR);
+    }
+    return p;
+}
+
+void reset_region() {
+    for (int64_t i = 0; i < REGION_NUM; i++) {
+        if (IS_NOT_NULL(regions[i])) {
+            arena_reset(regions[i]);
+        }
+    }
+}
+
+void free_region() {
+    for (int64_t i = 0; i < REGION_NUM; i++) {
+        free_arena(regions[i]);
+        regions[i] = NULL;
+    }
+}
@@ -89,7 +89,7 @@ void start_synth(Status *status) {
         for (int64_t i = 0; i < SYNTH_NUM; i++) {
             if (synths[i].use_flag) {
                 char str[64];
-                sprintf(str, "VARNAME : %20s  VALUE : %.3f", synths[i].var->token->str, aGetValueSlider(&synths[i].slider));
+                sprintf(str, "VARNAME : %20.*s  VALUE : %.3f", (int)synths[i].var->token->len, synths[i].var->token->str, aGetValueSlider(&synths[i].slider));
                 aDrawStr0(w, synths[i].slider.x, synths[i].slider.y + 20, 0, SYNTH_WIN_BACKGROUND_COLOR, str);
                 aFillSlider(w, &synths[i].slider);
                 synths[i].var->value.f = aGetValueSlider(&synths[i].slider);
@@ -10,6 +10,68 @@ enum {
 };
 typedef int64_t vmvaltype_t;
 
+/* exec_instr()がEXIT命令を実行したときに返す値 */
+#define EXEC_EXIT -1
+
+/* この回数だけ実行されたLOOPをJITコンパイルする */
+#define JIT_HOT_LOOP_COUNT 16
+
+/* 関数呼び出しの最大の深さ */
+#define FUNC_CALL_DEPTH 256
+
+typedef struct JitCode JitCode;
+
+/* 関数の引数の値 */
+typedef struct {
+    union value_u value;
+    vartype_t type;
+} VarValue;
+
+/* 関数呼び出し中に退避した引数の変数 */
+typedef struct {
+    Var *var;
+    VarValue saved;
+} SavedVar;
+
+/**
+ * 実行フレーム
+ * 
+ * exec()の実行中の状態で, 呼び出し側がnew_frame()で作って渡す.
+ * 内部コード(ic_list)はコンパイル後に書き換えないので,
+ * 同じ内部コードを別々のフレームで何度でも実行できる.
+ * (ただしVMスタックとシンセの状態はまだ1つしかないので, 今は同時には実行できない)
+ */
+struct Frame {
+    const VectorPTR *ic_list;
+    VectorPTR *var_list;
+    Status *status;
+
+    int64_t *loop_cnts;  // LOOP命令ごとのループカウンタ(今の呼び出しの深さの分)
+    int64_t loop_num;
+    int64_t *loop_cnts_buf; // 呼び出しの深さごとにloop_num個ずつ並べたカウンタ
+
+    int64_t *loop_hits;  // LOOP命令ごとの実行回数(JIT用)
+    JitCode **jit_codes; // LOOP命令ごとのネイティブコード
+
+    /* 関数呼び出し用の領域(CALL命令があるときだけ最初にまとめて確保する) */
+    int64_t *ret_addrs;     // 戻り先
+    int64_t call_depth;
+    SavedVar *saved_vars;   // 退避した変数
+    int64_t saved_num;
+    VarValue *args;         // CALLで取り出した引数
+};
+
+int64_t exec_instr(Frame *frame, int64_t i);
+
+/* profile */
+void init_profile(const VectorPTR *ic_list);
+int64_t profile_exec_instr(Frame *frame, int64_t i);
+
+/* jit */
+JitCode *jit_compile(const VectorPTR *ic_list, int64_t loop_pc, bool watch);
+int64_t jit_run(JitCode *code, Frame *frame);
+void jit_free(JitCode *code);
+
 vmvaltype_t vmstack_typecheck();
 
 void vmstack_pushi(int64_t i);
@@ -29,7 +91,10 @@ void alu(opcode_t op);
 void oto_instr_print();
 void oto_instr_beep();
 void oto_instr_play(Status *status);
+void oto_instr_playmidi(Status *status);
+int64_t oto_instr_playmml(Status *status, const VectorPTR *ic_list, int64_t i);
 void oto_instr_printwav(Status *status);
+void oto_instr_printspec(Status *status);
 void oto_instr_printvar(VectorPTR *var_list, Status *status);
 void oto_instr_sleep();
 void oto_instr_setsynth(Status *status);
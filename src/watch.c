@@ -0,0 +1,79 @@
+#include <oto/oto.h>
+
+/**
+ * --watch用のファイル監視
+ *
+ * ソースとインクルードしたファイルの更新時刻とサイズを一定間隔で調べる.
+ * インクルードしたファイルはインクルードキャッシュが覚えているものを使う.
+ */
+
+#define WATCH_POLL_MS 50
+
+static char *watch_path = NULL;
+static FileStamp watch_stamp = {0};
+static int64_t last_poll = 0;
+
+/* 今の時刻[ms]. clock()はCPU時間のこともあるのでSleep()中も進む時計を使う */
+static int64_t now_ms() {
+    LARGE_INTEGER counter, freq;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&freq);
+    return counter.QuadPart * 1000 / freq.QuadPart;
+}
+
+/* 今のソースの状態を覚えておく. 変わったかどうかはこれと比べる */
+void update_watch(char *path) {
+    watch_path = path;
+    if (!get_file_stamp(path, &watch_stamp)) {
+        watch_stamp.mtime = 0;
+        watch_stamp.size  = 0;
+    }
+    last_poll = now_ms();
+}
+
+static bool check_watch() {
+    last_poll = now_ms();
+
+    FileStamp stamp = {0};
+    get_file_stamp(watch_path, &stamp);
+    if (stamp.mtime != watch_stamp.mtime || stamp.size != watch_stamp.size) {
+        return true;
+    }
+    return is_include_cache_changed();
+}
+
+/* ソースとインクルードしたファイルの今の状態. 空のファイルは書き込み途中とみなして毎回変える */
+static uint64_t watch_signature() {
+    FileStamp stamp = {0};
+    get_file_stamp(watch_path, &stamp);
+    if (stamp.size == 0) {
+        stamp.mtime = now_ms();
+    }
+
+    uint64_t hash = hash_fnv1a(&stamp, sizeof(stamp), include_cache_signature());
+    return hash;
+}
+
+/* 前に調べてからWATCH_POLL_MS経っていなければfalse */
+bool is_watch_changed() {
+    if (IS_NULL(watch_path)
+        || now_ms() - last_poll < WATCH_POLL_MS) {
+        return false;
+    }
+    return check_watch();
+}
+
+void wait_watch_changed() {
+    while (!check_watch()) {
+        Sleep(WATCH_POLL_MS);
+    }
+
+    // 保存の途中(空のファイルなど)を読まないように, 変化が止まるまで待つ
+    uint64_t prev = 0;
+    uint64_t sig = watch_signature();
+    do {
+        prev = sig;
+        Sleep(WATCH_POLL_MS);
+        sig = watch_signature();
+    } while (sig != prev);
+}